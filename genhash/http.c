@@ -23,6 +23,7 @@
  */
 
 #include <errno.h>
+#include <ctype.h>
 #include <openssl/err.h>
 #include "memory.h"
 #include "http.h"
@@ -88,20 +89,23 @@ int
 finalize(thread * thread_obj)
 {
 	SOCK *sock_obj = THREAD_ARG(thread_obj);
-	unsigned char digest[16];
-	int i;
+	unsigned char digest[DIGEST_MAX_LEN];
+	char *name = digest_name(req->digest_algo);
+	int i, len;
 
-	/* Compute final MD5 digest */
-	MD5_Final(digest, &sock_obj->context);
+	/* Compute final digest */
+	len = digest_final(&sock_obj->context, digest);
 	if (req->verbose) {
 		printf("\n");
-		printf(HTML_MD5);
-		dump_buffer((char *) digest, 16);
+		printf(HTML_DIGEST);
+		dump_buffer((char *) digest, len);
 
-		printf(HTML_MD5_FINAL);
+		printf(HTML_DIGEST_FINAL);
 	}
-	printf("MD5SUM = ");
-	for (i = 0; i < 16; i++)
+	for (i = 0; name[i]; i++)
+		putchar(toupper(name[i]));
+	printf("SUM = ");
+	for (i = 0; i < len; i++)
 		printf("%02x", digest[i]);
 	printf("\n\n");
 
@@ -123,50 +127,44 @@ http_dump_header(char *buffer, int size)
 	printf("\n");
 }
 
-/* Process incoming stream */
+/*
+ * Process incoming stream. Returns 1 once the response is complete,
+ * -1 if it is malformed.
+ */
 int
 http_process_stream(SOCK * sock_obj, int r)
 {
-	sock_obj->size += r;
+	http_parser *p = &sock_obj->parser;
+	char *cur = sock_obj->buffer;
+	char *end = sock_obj->buffer + r;
+	char *start;
+	int header, ret;
+
 	sock_obj->total_size += r;
 
-	if (!sock_obj->extracted) {
-		if (req->verbose)
+	do {
+		header = !p->headers;
+		start = cur;
+		ret = http_parse(p, &cur, end);
+
+		/* Header bytes consumed by this round */
+		if (req->verbose && header && cur > start) {
 			printf(HTTP_HEADER_HEXA);
-		if ((sock_obj->extracted = extract_html(sock_obj->buffer, sock_obj->size))) {
-			if (req->verbose)
-				http_dump_header(sock_obj->buffer,
-						 sock_obj->extracted - sock_obj->buffer);
-			r = sock_obj->size - (sock_obj->extracted - sock_obj->buffer);
-			if (r) {
-				if (req->verbose) {
-					printf(HTML_HEADER_HEXA);
-					dump_buffer(sock_obj->extracted, r);
-				}
-				memmove(sock_obj->buffer, sock_obj->extracted, r);
-				MD5_Update(&sock_obj->context, sock_obj->buffer, r);
-				r = 0;
-			}
-			sock_obj->size = r;
-		} else {
+			http_dump_header(start, cur - start);
+			if (p->headers)
+				printf(HTML_HEADER_HEXA);
+		}
+
+		if (ret == HTTP_PARSE_DATA) {
 			if (req->verbose)
-				http_dump_header(sock_obj->buffer, sock_obj->size);
-
-			/* minimize buffer using no 2*CR/LF found yet */
-			if (sock_obj->size > 4) {
-				memmove(sock_obj->buffer,
-					sock_obj->buffer + sock_obj->size - 4, 4);
-				sock_obj->size = 4;
-			}
+				dump_buffer(p->data, p->data_len);
+			digest_update(&sock_obj->context, p->data, p->data_len);
 		}
-	} else if (sock_obj->size) {
-		if (req->verbose)
-			dump_buffer(sock_obj->buffer, r);
-		MD5_Update(&sock_obj->context, sock_obj->buffer, sock_obj->size);
-		sock_obj->size = 0;
-	}
+	} while (ret == HTTP_PARSE_DATA || ret == HTTP_PARSE_HEADERS);
 
-	return 0;
+	if (ret == HTTP_PARSE_ERROR)
+		return -1;
+	return ret == HTTP_PARSE_DONE;
 }
 
 /* Asynchronous HTTP stream reader */
@@ -181,9 +179,7 @@ http_read_thread(thread * thread_obj)
 		return epilog(thread_obj);
 
 	/* read the HTTP stream */
-	memset(sock_obj->buffer, 0, MAX_BUFFER_LENGTH);
-	r = read(thread_obj->u.fd, sock_obj->buffer + sock_obj->size,
-		 MAX_BUFFER_LENGTH - sock_obj->size);
+	r = read(thread_obj->u.fd, sock_obj->buffer, MAX_BUFFER_LENGTH);
 
 	DBG(" [l:%d,fd:%d]\n", r, sock_obj->fd);
 
@@ -200,7 +196,14 @@ http_read_thread(thread * thread_obj)
 		finalize(thread_obj);
 	} else {
 		/* Handle the response stream */
-		http_process_stream(sock_obj, r);
+		switch (http_process_stream(sock_obj, r)) {
+		case 1:
+			return finalize(thread_obj);
+		case -1:
+			fprintf(stderr, "Malformed HTTP response from [%s:%d].\n",
+				inet_ntop2(req->addr_ip), ntohs(req->addr_port));
+			return epilog(thread_obj);
+		}
 
 		/*
 		 * Register next http stream reader.
@@ -229,8 +232,9 @@ http_response_thread(thread * thread_obj)
 	/* Allocate & clean the get buffer */
 	sock_obj->buffer = (char *) MALLOC(MAX_BUFFER_LENGTH);
 
-	/* Initalize the MD5 context */
-	MD5_Init(&sock_obj->context);
+	/* Initalize the digest context and the response parser */
+	digest_init(&sock_obj->context, req->digest_algo);
+	http_parser_init(&sock_obj->parser, 0);
 
 	/* Register asynchronous http/ssl read thread */
 	if (req->ssl)
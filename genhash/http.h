@@ -51,8 +51,8 @@
 #define HTTP_HEADER_HEXA  DELIM_BEGIN"    HTTP Header Buffer    "DELIM_END
 #define HTTP_HEADER_ASCII DELIM_BEGIN" HTTP Header Ascii Buffer "DELIM_END
 #define HTML_HEADER_HEXA  DELIM_BEGIN"       HTML Buffer        "DELIM_END
-#define HTML_MD5          DELIM_BEGIN"    HTML MD5 resulting    "DELIM_END
-#define HTML_MD5_FINAL    DELIM_BEGIN" HTML MD5 final resulting "DELIM_END
+#define HTML_DIGEST       DELIM_BEGIN"  HTML digest resulting   "DELIM_END
+#define HTML_DIGEST_FINAL DELIM_BEGIN" HTML digest final result "DELIM_END
 
 /* Define prototypes */
 extern int epilog(thread * thread_obj);
@@ -69,10 +69,11 @@ usage(const char *prog)
 		"  %s --port            -p       Use the specified remote server port.\n"
 		"  %s --url             -u       Use the specified remote server url.\n"
 		"  %s --use-virtualhost -V       Use the specified virtualhost in GET query.\n"
+		"  %s --digest-algo     -a       Use md5 (default), sha1, sha256 or crc32c.\n"
 		"  %s --verbose         -v       Use verbose mode output.\n"
 		"  %s --help            -h       Display this short inlined help screen.\n"
 		"  %s --release         -r       Display the release number\n",
-		prog, prog, prog, prog, prog, prog, prog, prog);
+		prog, prog, prog, prog, prog, prog, prog, prog, prog);
 }
 
 /* Command line parser */
@@ -92,6 +93,7 @@ parse_cmdline(int argc, char **argv, REQ * req_obj)
 		{"port", 'p', POPT_ARG_STRING, &optarg, 'p'},
 		{"url", 'u', POPT_ARG_STRING, &optarg, 'u'},
 		{"use-virtualhost", 'V', POPT_ARG_STRING, &optarg, 'V'},
+		{"digest-algo", 'a', POPT_ARG_STRING, &optarg, 'a'},
 		{NULL, 0, 0, NULL, 0}
 	};
 
@@ -155,6 +157,12 @@ parse_cmdline(int argc, char **argv, REQ * req_obj)
 		case 'u':
 			req_obj->url = optarg;
 			break;
+		case 'a':
+			if ((req_obj->digest_algo = digest_algo(optarg)) < 0) {
+				fprintf(stderr, "unknown digest algorithm %s\n", optarg);
+				return CMD_LINE_ERROR;
+			}
+			break;
 		default:
 			usage(argv[0]);
 			return CMD_LINE_ERROR;
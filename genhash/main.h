@@ -40,6 +40,7 @@
 #include "http.h"
 #include "ssl.h"
 #include "list.h"
+#include "digest.h"
 
 /* Build version */
 #define PROG    "genhash"
@@ -64,6 +65,7 @@ typedef struct {
 	char *vhost;
 	int verbose;
 	int ssl;
+	int digest_algo;
 	SSL_CTX *ctx;
 	SSL_METHOD *meth;
 	unsigned long ref_time;
@@ -52,6 +52,7 @@ free_sock(SOCK * sock_obj)
 	DBG("Freeing fd:%d\n", sock_obj->fd);
 
 	close_sock(sock_obj);
+	digest_free(&sock_obj->context);
 	FREE(sock_obj);
 }
 
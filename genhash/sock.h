@@ -27,19 +27,21 @@
 
 /* system includes */
 #include <openssl/ssl.h>
-#include <openssl/md5.h>
+
+/* local includes */
+#include "html.h"
+#include "digest.h"
 
 /* Engine socket pool element structure */
 typedef struct {
 	int fd;
 	SSL *ssl;
 	BIO *bio;
-	MD5_CTX context;
+	digest_ctx context;
 	int status;
 	int lock;
 	char *buffer;
-	char *extracted;
-	int size;
+	http_parser parser;
 	int total_size;
 } SOCK;
 
@@ -163,7 +163,6 @@ ssl_read_thread(thread * thread_obj)
       read_stream:
 
 	/* read the SSL stream */
-	memset(sock_obj->buffer, 0, MAX_BUFFER_LENGTH);
 	r = SSL_read(sock_obj->ssl, sock_obj->buffer, MAX_BUFFER_LENGTH);
 	error = SSL_get_error(sock_obj->ssl, r);
 
@@ -177,7 +176,14 @@ ssl_read_thread(thread * thread_obj)
 	} else if (r > 0 && error == 0) {
 
 		/* Handle the response stream */
-		http_process_stream(sock_obj, r);
+		switch (http_process_stream(sock_obj, r)) {
+		case 1:
+			return finalize(thread_obj);
+		case -1:
+			fprintf(stderr, "Malformed HTTP response from [%s:%d].\n",
+				inet_ntop2(req->addr_ip), ntohs(req->addr_port));
+			return epilog(thread_obj);
+		}
 
 		/*
 		 * Register next ssl stream reader.
@@ -0,0 +1,494 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        VRRP capture & replay benchmark tool. Records VRRP and
+ *              IPSEC-AH adverts into a pcap file, and replays a pcap
+ *              file through a TAP device at a given rate so that the
+ *              VRRP receive path can be loaded reproducibly.
+ *
+ *              Build : gcc -O2 -Wall -o vrrpreplay vrrpreplay.c
+ *
+ *              Typical run :
+ *                ip tuntap add dev vrrp0 mode tap
+ *                ip link set vrrp0 up
+ *                sysctl -w net.ipv4.conf.vrrp0.rp_filter=0
+ *                keepalived -n -l -D -P -f bench.conf   (instances on vrrp0)
+ *                vrrpreplay -r adverts.pcap -t vrrp0 -R 50000 -n 100
+ *
+ *              Receive path counters and latency percentiles are logged
+ *              by the VRRP child on exit when running with -D.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <arpa/inet.h>
+#include <linux/if_tun.h>
+
+#ifndef IPPROTO_VRRP
+#define IPPROTO_VRRP		112
+#endif
+#define INADDR_VRRP_GROUP	0xe0000012	/* 224.0.0.18 */
+
+/* pcap file format */
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_MAGIC_NSEC		0xa1b23c4d
+#define LINKTYPE_ETHERNET	1
+#define LINKTYPE_RAW		101
+#define LINKTYPE_LINUX_SLL	113
+#define PKT_MAX			2048
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t network;
+} pcap_hdr;
+
+typedef struct {
+	uint32_t ts_sec;
+	uint32_t ts_usec;
+	uint32_t incl_len;
+	uint32_t orig_len;
+} pcap_rec;
+
+/* An IPv4 VRRP or AH advert loaded from a capture */
+typedef struct {
+	unsigned char *ip;
+	int len;
+} advert;
+
+static advert *adverts;
+static int nr_adverts;
+
+/* AH header length in front of the VRRP header, see vrrp_ipsecah.h */
+#define IPSEC_AH_LEN		24
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s -i <ifname> -w <file> [-c <seconds>]\n"
+		"       %s -r <file> -t <tap> [options]\n\n"
+		"  -i, --interface   capture adverts received on interface\n"
+		"  -w, --write       pcap file to record into\n"
+		"  -c, --count       capture duration in seconds (default 10)\n"
+		"  -r, --read        pcap file to replay (ethernet, raw or sll)\n"
+		"  -t, --tap         TAP device to replay into\n"
+		"  -R, --rate        adverts per second, 0 for flat out (default 1000)\n"
+		"  -n, --loops       number of passes over the capture (default 1)\n"
+		"  -v, --vrid        first[-last] : rewrite VRIDs over this range\n"
+		"  -x, --foreign     first[-last] : VRIDs not served locally\n"
+		"  -f, --foreign-pct share of adverts sent to foreign VRIDs\n"
+		"  -h, --help        this help\n", prog, prog);
+	exit(1);
+}
+
+static int
+parse_range(const char *str, int *first, int *last)
+{
+	char *end;
+
+	*first = strtol(str, &end, 10);
+	*last = (*end == '-') ? strtol(end + 1, NULL, 10) : *first;
+	if (*first < 1 || *last > 255 || *first > *last) {
+		fprintf(stderr, "invalid VRID range %s\n", str);
+		return 0;
+	}
+	return 1;
+}
+
+/* rfc1071 checksum */
+static uint16_t
+in_csum(const uint16_t *addr, int len)
+{
+	uint32_t sum = 0;
+
+	while (len > 1) {
+		sum += *addr++;
+		len -= 2;
+	}
+	if (len == 1)
+		sum += *(const uint8_t *) addr;
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum += (sum >> 16);
+	return ~sum;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Keep VRRP and AH adverts only */
+static void
+load_advert(const unsigned char *ip, int len)
+{
+	const struct iphdr *iph = (const struct iphdr *) ip;
+
+	if (len < (int) sizeof (struct iphdr) || iph->version != 4)
+		return;
+	if (iph->protocol != IPPROTO_VRRP && iph->protocol != IPPROTO_AH)
+		return;
+	if (ntohs(iph->tot_len) > len)
+		return;
+
+	adverts = realloc(adverts, (nr_adverts + 1) * sizeof (advert));
+	adverts[nr_adverts].len = ntohs(iph->tot_len);
+	adverts[nr_adverts].ip = malloc(adverts[nr_adverts].len);
+	memcpy(adverts[nr_adverts].ip, ip, adverts[nr_adverts].len);
+	nr_adverts++;
+}
+
+static int
+read_pcap(const char *file)
+{
+	unsigned char buf[65536];
+	pcap_hdr hdr;
+	pcap_rec rec;
+	int swap, skip;
+	FILE *fp;
+
+	if (!(fp = fopen(file, "r"))) {
+		fprintf(stderr, "cannot open %s (%s)\n", file, strerror(errno));
+		return 0;
+	}
+	if (fread(&hdr, sizeof (hdr), 1, fp) != 1) {
+		fprintf(stderr, "%s: truncated pcap header\n", file);
+		fclose(fp);
+		return 0;
+	}
+
+	swap = (hdr.magic == __builtin_bswap32(PCAP_MAGIC) ||
+		hdr.magic == __builtin_bswap32(PCAP_MAGIC_NSEC));
+	if (!swap && hdr.magic != PCAP_MAGIC && hdr.magic != PCAP_MAGIC_NSEC) {
+		fprintf(stderr, "%s: not a pcap file\n", file);
+		fclose(fp);
+		return 0;
+	}
+	if (swap)
+		hdr.network = __builtin_bswap32(hdr.network);
+
+	switch (hdr.network) {
+	case LINKTYPE_ETHERNET:
+		skip = 14;
+		break;
+	case LINKTYPE_RAW:
+		skip = 0;
+		break;
+	case LINKTYPE_LINUX_SLL:
+		skip = 16;
+		break;
+	default:
+		fprintf(stderr, "%s: unsupported link type %u\n", file,
+			hdr.network);
+		fclose(fp);
+		return 0;
+	}
+
+	while (fread(&rec, sizeof (rec), 1, fp) == 1) {
+		if (swap)
+			rec.incl_len = __builtin_bswap32(rec.incl_len);
+		if (rec.incl_len > sizeof (buf) ||
+		    fread(buf, rec.incl_len, 1, fp) != 1)
+			break;
+		if ((int) rec.incl_len > skip)
+			load_advert(buf + skip, rec.incl_len - skip);
+	}
+	fclose(fp);
+
+	printf("%s: %d VRRP/AH adverts loaded\n", file, nr_adverts);
+	return nr_adverts;
+}
+
+/* Capture adverts with raw sockets into a raw IP pcap file */
+static int
+capture(const char *ifname, const char *file, int seconds)
+{
+	int protos[2] = { IPPROTO_VRRP, IPPROTO_AH };
+	unsigned char buf[PKT_MAX];
+	struct ip_mreqn req;
+	struct timeval tv;
+	pcap_hdr hdr;
+	pcap_rec rec;
+	fd_set fds;
+	double end;
+	int fd[2], i, len, count = 0, maxfd = 0;
+	FILE *fp;
+
+	memset(&req, 0, sizeof (req));
+	req.imr_multiaddr.s_addr = htonl(INADDR_VRRP_GROUP);
+	req.imr_ifindex = if_nametoindex(ifname);
+	if (!req.imr_ifindex) {
+		fprintf(stderr, "unknown interface %s\n", ifname);
+		return 1;
+	}
+
+	for (i = 0; i < 2; i++) {
+		fd[i] = socket(AF_INET, SOCK_RAW, protos[i]);
+		if (fd[i] < 0) {
+			fprintf(stderr, "cannot open raw socket (%s)\n",
+				strerror(errno));
+			return 1;
+		}
+		setsockopt(fd[i], IPPROTO_IP, IP_ADD_MEMBERSHIP, &req,
+			   sizeof (req));
+		setsockopt(fd[i], SOL_SOCKET, SO_BINDTODEVICE, ifname,
+			   strlen(ifname) + 1);
+		if (fd[i] > maxfd)
+			maxfd = fd[i];
+	}
+
+	if (!(fp = fopen(file, "w"))) {
+		fprintf(stderr, "cannot open %s (%s)\n", file, strerror(errno));
+		return 1;
+	}
+	memset(&hdr, 0, sizeof (hdr));
+	hdr.magic = PCAP_MAGIC;
+	hdr.version_major = 2;
+	hdr.version_minor = 4;
+	hdr.snaplen = PKT_MAX;
+	hdr.network = LINKTYPE_RAW;
+	fwrite(&hdr, sizeof (hdr), 1, fp);
+
+	end = now() + seconds;
+	while (now() < end) {
+		FD_ZERO(&fds);
+		FD_SET(fd[0], &fds);
+		FD_SET(fd[1], &fds);
+		tv.tv_sec = 0;
+		tv.tv_usec = 100000;
+		if (select(maxfd + 1, &fds, NULL, NULL, &tv) <= 0)
+			continue;
+
+		for (i = 0; i < 2; i++) {
+			if (!FD_ISSET(fd[i], &fds))
+				continue;
+			len = read(fd[i], buf, sizeof (buf));
+			if (len <= 0)
+				continue;
+			gettimeofday(&tv, NULL);
+			rec.ts_sec = tv.tv_sec;
+			rec.ts_usec = tv.tv_usec;
+			rec.incl_len = rec.orig_len = len;
+			fwrite(&rec, sizeof (rec), 1, fp);
+			fwrite(buf, len, 1, fp);
+			count++;
+		}
+	}
+	fclose(fp);
+	close(fd[0]);
+	close(fd[1]);
+
+	printf("%s: %d adverts captured on %s in %ds\n", file, count, ifname,
+	       seconds);
+	return 0;
+}
+
+static int
+open_tap(const char *name)
+{
+	struct ifreq ifr;
+	int fd;
+
+	if ((fd = open("/dev/net/tun", O_RDWR)) < 0) {
+		fprintf(stderr, "cannot open /dev/net/tun (%s)\n",
+			strerror(errno));
+		return -1;
+	}
+	memset(&ifr, 0, sizeof (ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+		fprintf(stderr, "cannot attach TAP %s (%s)\n", name,
+			strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Build the ethernet frame for an advert, optionally moving it to
+ * another VRID. AH protected adverts are replayed as captured since
+ * any rewrite would break their HMAC.
+ */
+static int
+build_frame(unsigned char *frame, const advert *adv, int vrid)
+{
+	static const unsigned char mcast[6] = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0x12 };
+	struct iphdr *iph;
+	unsigned char *vrrp;
+	int ihl, vlen;
+
+	memcpy(frame, mcast, 6);
+	frame[6] = 0x00;
+	frame[7] = 0x00;
+	frame[8] = 0x5e;
+	frame[9] = 0x00;
+	frame[10] = 0x01;
+	frame[12] = 0x08;
+	frame[13] = 0x00;
+	memcpy(frame + 14, adv->ip, adv->len);
+
+	iph = (struct iphdr *) (frame + 14);
+	ihl = iph->ihl << 2;
+	vrrp = frame + 14 + ihl;
+	vlen = adv->len - ihl;
+	if (iph->protocol == IPPROTO_VRRP && vrid && vlen >= 8) {
+		vrrp[1] = vrid;
+		vrrp[6] = vrrp[7] = 0;
+		*(uint16_t *) (vrrp + 6) = in_csum((uint16_t *) vrrp, vlen);
+	}
+	if (iph->protocol == IPPROTO_AH && vlen >= IPSEC_AH_LEN + 2)
+		vrrp += IPSEC_AH_LEN;
+	frame[11] = vrrp[1];
+
+	return adv->len + 14;
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct option long_options[] = {
+		{"interface",	required_argument,	NULL, 'i'},
+		{"write",	required_argument,	NULL, 'w'},
+		{"count",	required_argument,	NULL, 'c'},
+		{"read",	required_argument,	NULL, 'r'},
+		{"tap",		required_argument,	NULL, 't'},
+		{"rate",	required_argument,	NULL, 'R'},
+		{"loops",	required_argument,	NULL, 'n'},
+		{"vrid",	required_argument,	NULL, 'v'},
+		{"foreign",	required_argument,	NULL, 'x'},
+		{"foreign-pct",	required_argument,	NULL, 'f'},
+		{"help",	no_argument,		NULL, 'h'},
+		{NULL,		0,			NULL, 0}
+	};
+	char *ifname = NULL, *wfile = NULL, *rfile = NULL, *tap = NULL;
+	int seconds = 10, rate = 1000, loops = 1, pct = 0;
+	int vfirst = 0, vlast = 0, xfirst = 0, xlast = 0;
+	unsigned char frame[PKT_MAX + 14];
+	unsigned long sent = 0, foreign = 0, errors = 0;
+	double start, elapsed, next, ahead;
+	int c, fd, i, loop, len, vrid;
+
+	while ((c = getopt_long(argc, argv, "i:w:c:r:t:R:n:v:x:f:h",
+				long_options, NULL)) != -1) {
+		switch (c) {
+		case 'i':
+			ifname = optarg;
+			break;
+		case 'w':
+			wfile = optarg;
+			break;
+		case 'c':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			rfile = optarg;
+			break;
+		case 't':
+			tap = optarg;
+			break;
+		case 'R':
+			rate = atoi(optarg);
+			break;
+		case 'n':
+			loops = atoi(optarg);
+			break;
+		case 'v':
+			if (!parse_range(optarg, &vfirst, &vlast))
+				return 1;
+			break;
+		case 'x':
+			if (!parse_range(optarg, &xfirst, &xlast))
+				return 1;
+			break;
+		case 'f':
+			pct = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (ifname && wfile)
+		return capture(ifname, wfile, seconds);
+	if (!rfile || !tap)
+		usage(argv[0]);
+	if (pct && !xfirst) {
+		fprintf(stderr, "--foreign-pct needs a --foreign VRID range\n");
+		return 1;
+	}
+
+	if (!read_pcap(rfile))
+		return 1;
+	if ((fd = open_tap(tap)) < 0)
+		return 1;
+
+	start = next = now();
+	for (loop = 0; loop < loops; loop++) {
+		for (i = 0; i < nr_adverts; i++) {
+			vrid = 0;
+			if (pct && (int) (sent % 100) < pct) {
+				vrid = xfirst + foreign % (xlast - xfirst + 1);
+				foreign++;
+			} else if (vfirst)
+				vrid = vfirst + sent % (vlast - vfirst + 1);
+
+			len = build_frame(frame, &adverts[i], vrid);
+			if (write(fd, frame, len) != len)
+				errors++;
+			sent++;
+
+			/* Pace the replay, sleeping when well ahead */
+			if (rate) {
+				next += 1.0 / rate;
+				while ((ahead = next - now()) > 0)
+					if (ahead > 0.001)
+						usleep(ahead * 1e6);
+			}
+		}
+	}
+	elapsed = now() - start;
+
+	printf("%lu adverts (%lu foreign, %lu write errors) in %.3fs :"
+	       " %.0f adverts/s\n", sent, foreign, errors, elapsed,
+	       (elapsed > 0) ? sent / elapsed : 0);
+	close(fd);
+	return 0;
+}
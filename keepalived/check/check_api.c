@@ -30,6 +30,7 @@
 #include "logger.h"
 #include "global_data.h"
 #include "check_misc.h"
+#include "check_shm.h"
 #include "check_smtp.h"
 #include "check_tcp.h"
 #include "check_http.h"
@@ -138,6 +139,22 @@ register_checkers_thread(void)
 }
 
 /* Sync checkers activity with netlink kernel reflection */
+static void
+set_checker_activity(checker * checker_obj, int enable)
+{
+	if (!CHECKER_ENABLED(checker_obj) && enable)
+		log_message(LOG_INFO,
+		       "Activating healtchecker for service [%s:%d]",
+		       inet_ntop2(CHECKER_RIP(checker_obj)),
+		       ntohs(CHECKER_RPORT(checker_obj)));
+	if (CHECKER_ENABLED(checker_obj) && !enable)
+		log_message(LOG_INFO,
+		       "Suspending healtchecker for service [%s:%d]",
+		       inet_ntop2(CHECKER_RIP(checker_obj)),
+		       ntohs(CHECKER_RPORT(checker_obj)));
+	checker_obj->enabled = enable;
+}
+
 void
 update_checker_activity(uint32_t address, int enable)
 {
@@ -153,27 +170,45 @@ update_checker_activity(uint32_t address, int enable)
 	if (!LIST_ISEMPTY(checkers_queue))
 		for (e = LIST_HEAD(checkers_queue); e; ELEMENT_NEXT(e)) {
 			checker_obj = ELEMENT_DATA(e);
-			if (CHECKER_VIP(checker_obj) == address && CHECKER_HA_SUSPEND(checker_obj)) {
-				if (!CHECKER_ENABLED(checker_obj) && enable)
-					log_message(LOG_INFO,
-					       "Activating healtchecker for service [%s:%d]",
-					       inet_ntop2(CHECKER_RIP(checker_obj)),
-					       ntohs(CHECKER_RPORT(checker_obj)));
-				if (CHECKER_ENABLED(checker_obj) && !enable)
-					log_message(LOG_INFO,
-					       "Suspending healtchecker for service [%s:%d]",
-					       inet_ntop2(CHECKER_RIP(checker_obj)),
-					       ntohs(CHECKER_RPORT(checker_obj)));
-				checker_obj->enabled = enable;
-			}
+			if (CHECKER_VIP(checker_obj) == address && CHECKER_HA_SUSPEND(checker_obj))
+				set_checker_activity(checker_obj, enable);
 		}
 }
 
+/* Reconcile checkers activity against a full list of local addresses */
+void
+resync_checker_activity(list addresses)
+{
+	checker *checker_obj;
+	element e, a;
+	int enable;
+
+	if (LIST_ISEMPTY(checkers_queue))
+		return;
+
+	for (e = LIST_HEAD(checkers_queue); e; ELEMENT_NEXT(e)) {
+		checker_obj = ELEMENT_DATA(e);
+		if (!CHECKER_HA_SUSPEND(checker_obj))
+			continue;
+
+		enable = 0;
+		if (!LIST_ISEMPTY(addresses))
+			for (a = LIST_HEAD(addresses); a; ELEMENT_NEXT(a))
+				if (*(uint32_t *) ELEMENT_DATA(a) ==
+				    CHECKER_VIP(checker_obj)) {
+					enable = 1;
+					break;
+				}
+		set_checker_activity(checker_obj, enable);
+	}
+}
+
 /* Install checkers keywords */
 void
 install_checkers_keyword(void)
 {
 	install_misc_check_keyword();
+	install_shm_check_keyword();
 	install_smtp_check_keyword();
 	install_tcp_check_keyword();
 	install_http_check_keyword();
@@ -24,10 +24,13 @@
 #include "check_parser.h"
 #include "check_data.h"
 #include "check_ssl.h"
+#include "ssl_pool.h"
 #include "check_api.h"
 #include "global_data.h"
+#include "track_shm.h"
 #include "ipwrapper.h"
 #include "ipvswrapper.h"
+#include "watchdog.h"
 #include "pidfile.h"
 #include "daemon.h"
 #include "signals.h"
@@ -47,9 +50,13 @@ stop_check(void)
 {
 	/* Destroy master thread */
 	signal_handler_destroy();
+	ssl_pool_stop();
 	thread_destroy_master(master);
 	free_checkers_queue();
+	http_free_pool();
 	free_ssl();
+	track_shm_close();
+	ipc_close();
 	if (!(debug & 16))
 		clear_services();
 	ipvs_stop();
@@ -96,6 +103,13 @@ start_check(void)
 		stop_check();
 		return;
 	}
+	if (data->track_shm_file)
+		track_shm_open(data->track_shm_file);
+	else
+		track_shm_close();
+#ifdef _WITH_VRRP_
+	kernel_netlink_set_rcvbuf(data->netlink_rcvbuf);
+#endif
 
 	/* Post initializations */
 	log_message(LOG_INFO, "Configuration is using : %lu Bytes", mem_allocated);
@@ -105,6 +119,7 @@ start_check(void)
 		stop_check();
 		return;
 	}
+	ssl_pool_start(check_data->ssl->workers);
 
 	/* Processing differential configuration parsing */
 	if (reload)
@@ -116,6 +131,10 @@ start_check(void)
 		return;
 	}
 
+	/* Stream service states to the VRRP child */
+	ipc_open(IPC_CHECK, check_ipc_handler, check_ipc_resync);
+	check_ipc_resync();
+
 	/* Dump configuration */
 	if (debug & 4) {
 		dump_global_data(data);
@@ -129,6 +148,9 @@ start_check(void)
 
 	/* Register checkers thread */
 	register_checkers_thread();
+
+	/* Heartbeat to the parent */
+	wdog_start();
 }
 
 /* Reload handler */
@@ -138,6 +160,7 @@ sighup_check(void *v, int sig)
 {
 	log_message(LOG_INFO, "Reloading Healthchecker child process(%d) on signal",
 		    getpid());
+	wdog_hold();
 	thread_add_event(master, reload_check_thread, NULL, 0);
 }
 
@@ -146,10 +169,27 @@ void
 sigend_check(void *v, int sig)
 {
 	log_message(LOG_INFO, "Terminating Healthchecker child process on signal");
+	wdog_hold();
 	if (master)
 		thread_add_terminate_event(master);
 }
 
+/* Stats dump handler */
+static int
+print_check_stats(thread * thread_obj)
+{
+	check_print_stats();
+	return 0;
+}
+
+void
+sigusr2_check(void *v, int sig)
+{
+	log_message(LOG_INFO, "Printing Healthchecker stats for process(%d)"
+			      " on signal", getpid());
+	thread_add_event(master, print_check_stats, NULL, 0);
+}
+
 /* CHECK Child signal handling */
 void
 check_signal_init(void)
@@ -158,6 +198,7 @@ check_signal_init(void)
 	signal_set(SIGHUP, sighup_check, NULL);
 	signal_set(SIGINT, sigend_check, NULL);
 	signal_set(SIGTERM, sigend_check, NULL);
+	signal_set(SIGUSR2, sigusr2_check, NULL);
 	signal_ignore(SIGPIPE);
 }
 
@@ -172,11 +213,13 @@ reload_check_thread(thread * thread_obj)
 	signal_reset();
 	signal_handler_destroy();
 
-	/* Destroy master thread */
+	/* Destroy master thread, no handshake may be left in flight */
+	ssl_pool_stop();
 	thread_destroy_master(master);
 	master = thread_make_master();
 	free_global_data(data);
 	free_checkers_queue();
+	http_free_pool();
 #ifdef _WITH_VRRP_
 	free_interface_queue();
 #endif
@@ -231,6 +274,7 @@ start_check_child(void)
 	int ret;
 
 	/* Initialize child process */
+	wdog_prefork(WDOG_CHILD_CHECK);
 	pid = fork();
 
 	if (pid < 0) {
@@ -242,9 +286,10 @@ start_check_child(void)
 		log_message(LOG_INFO, "Starting Healthcheck child process, pid=%d"
 			       , pid);
 
-		/* Start respawning thread */
+		/* Start respawning and heartbeat threads */
 		thread_add_child(master, check_respawn_thread, NULL,
 				 pid, RESPAWN_TIMER);
+		wdog_parent(WDOG_CHILD_CHECK, pid);
 		return 0;
 	}
 
@@ -262,6 +307,7 @@ start_check_child(void)
 	signal_handler_destroy();
 	thread_destroy_master(master);
 	master = thread_make_master();
+	wdog_child(WDOG_CHILD_CHECK);
 
 	/* change to / dir */
 	ret = chdir("/");
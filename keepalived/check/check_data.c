@@ -22,6 +22,7 @@
 
 #include "check_data.h"
 #include "check_api.h"
+#include "check_ssl.h"
 #include "logger.h"
 #include "memory.h"
 #include "utils.h"
@@ -66,6 +67,8 @@ dump_ssl(void)
 		log_message(LOG_INFO, " Key file : %s", ssl->keyfile);
 	if (!ssl->password && !ssl->cafile && !ssl->certfile && !ssl->keyfile)
 		log_message(LOG_INFO, " Using autogen SSL context");
+	if (ssl->workers)
+		log_message(LOG_INFO, " Handshake workers : %d", ssl->workers);
 }
 
 /* Virtual server group facility functions */
@@ -355,3 +358,20 @@ dump_check_data(check_conf_data *check_data_obj)
 	}
 	dump_checkers_queue();
 }
+
+void
+check_print_stats(void)
+{
+	FILE *fp;
+
+	fp = fopen_report(CHECK_STATS_FILE);
+	if (!fp) {
+		log_message(LOG_INFO, "Can't open %s (%m)", CHECK_STATS_FILE);
+		return;
+	}
+
+	/* Should not move once checkers run steadily */
+	fprintf(fp, "Heap allocations: %lu\n", mem_allocs);
+	ssl_print_stats(fp);
+	fclose(fp);
+}
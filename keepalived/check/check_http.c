@@ -21,6 +21,7 @@
  * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
  */
 
+#include <stddef.h>
 #include <openssl/err.h>
 #include "check_http.h"
 #include "check_ssl.h"
@@ -32,6 +33,7 @@
 #include "html.h"
 
 int http_connect_thread(thread *);
+int http_read_thread(thread *);
 
 /* Configuration stream handling */
 void
@@ -40,6 +42,7 @@ free_url(void *data)
 	url *url_obj = data;
 	FREE(url_obj->path);
 	FREE(url_obj->digest);
+	free_expect_set(url_obj->expect);
 	FREE(url_obj);
 }
 
@@ -49,11 +52,69 @@ dump_url(void *data)
 	url *url_obj = data;
 	log_message(LOG_INFO, "   Checked url = %s", url_obj->path);
 	if (url_obj->digest)
-		log_message(LOG_INFO, "           digest = %s",
-		       url_obj->digest);
+		log_message(LOG_INFO, "           digest = %s (%s)",
+		       url_obj->digest, digest_name(url_obj->digest_algo));
 	if (url_obj->status_code)
 		log_message(LOG_INFO, "           HTTP Status Code = %d",
 		       url_obj->status_code);
+	dump_expect_set(url_obj->expect);
+}
+
+/*
+ * Released request contexts, handed back to the next connections so
+ * that steady state checking does not allocate. Only the scheduler
+ * thread takes and gives them back.
+ */
+static REQ *req_pool = NULL;
+
+static REQ *
+http_req_get(void)
+{
+	REQ *req = req_pool;
+
+	if (!req)
+		return (REQ *) MALLOC(sizeof (REQ));
+	req_pool = req->next;
+	memset(req, 0, offsetof(REQ, context));
+	return req;
+}
+
+static void
+http_req_put(REQ * req)
+{
+	req->next = req_pool;
+	req_pool = req;
+}
+
+void
+http_free_pool(void)
+{
+	REQ *req;
+
+	while ((req = req_pool)) {
+		req_pool = req->next;
+		digest_free(&req->context);
+		FREE(req);
+	}
+}
+
+/* Close the connection and release its request context */
+static void
+http_close(http_arg * http_arg_obj)
+{
+	REQ *req = HTTP_REQ(http_arg_obj);
+
+	if (!req)
+		return;
+	if (req->conn.ssl) {
+		/* Quiet shutdown keeps the session resumable */
+		SSL_set_quiet_shutdown(req->conn.ssl, 1);
+		SSL_shutdown(req->conn.ssl);
+		SSL_free(req->conn.ssl);
+	}
+	close(req->conn.fd);
+	http_req_put(req);
+	http_arg_obj->req = NULL;
 }
 
 void
@@ -61,7 +122,10 @@ free_http_get_check(void *data)
 {
 	http_get_checker *http_get_chk = CHECKER_DATA(data);
 
+	http_close(http_get_chk->arg);
+	ssl_forget_session(http_get_chk);
 	free_list(http_get_chk->url);
+	FREE_PTR(http_get_chk->requests);
 	FREE(http_get_chk->arg);
 	FREE(http_get_chk);
 	FREE(data);
@@ -87,6 +151,10 @@ dump_http_get_check(void *data)
 	log_message(LOG_INFO, "   Nb get retry = %d", http_get_chk->nb_get_retry);
 	log_message(LOG_INFO, "   Delay before retry = %lu",
 	       http_get_chk->delay_before_retry/TIMER_HZ);
+	if (http_get_chk->persistent)
+		log_message(LOG_INFO, "   Persistent HTTP/1.1 connection");
+	if (http_get_chk->method == HTTP_METHOD_HEAD)
+		log_message(LOG_INFO, "   Method = HEAD");
 	dump_list(http_get_chk->url);
 }
 static http_get_checker *
@@ -151,6 +219,27 @@ delay_before_retry_handler(vector strvec)
 	http_get_chk->delay_before_retry = CHECKER_VALUE_INT(strvec) * TIMER_HZ;
 }
 
+void
+persistent_handler(vector strvec)
+{
+	http_get_checker *http_get_chk = CHECKER_GET();
+	http_get_chk->persistent = 1;
+}
+
+void
+method_handler(vector strvec)
+{
+	http_get_checker *http_get_chk = CHECKER_GET();
+	char *str = VECTOR_SLOT(strvec, 1);
+
+	if (!strcmp(str, "HEAD"))
+		http_get_chk->method = HTTP_METHOD_HEAD;
+	else if (!strcmp(str, "GET"))
+		http_get_chk->method = HTTP_METHOD_GET;
+	else
+		log_message(LOG_INFO, "Unknown HTTP method %s, using GET", str);
+}
+
 void
 url_handler(vector strvec)
 {
@@ -172,6 +261,25 @@ path_handler(vector strvec)
 	url_obj->path = CHECKER_VALUE_STRING(strvec);
 }
 
+/*
+ * Binary form of the digest, compared on each check. digest may come
+ * before digest_algo in the url block : a malformed digest is only
+ * reported once the algorithm is known.
+ */
+static void
+url_digest_parse(url * url_obj, int report)
+{
+	url_obj->digest_len = digest_parse(url_obj->digest_algo, url_obj->digest,
+					   url_obj->digest_bin);
+	if (url_obj->digest_len > 0)
+		return;
+	url_obj->digest_len = 0;
+	if (report)
+		log_message(LOG_INFO, "Bad %s digest %s for url %s, never matched",
+		       digest_name(url_obj->digest_algo), url_obj->digest,
+		       url_obj->path ? url_obj->path : "");
+}
+
 void
 digest_handler(vector strvec)
 {
@@ -179,6 +287,24 @@ digest_handler(vector strvec)
 	url *url_obj = LIST_TAIL_DATA(http_get_chk->url);
 
 	url_obj->digest = CHECKER_VALUE_STRING(strvec);
+	url_digest_parse(url_obj, url_obj->digest_algo != DIGEST_MD5);
+}
+
+void
+digest_algo_handler(vector strvec)
+{
+	http_get_checker *http_get_chk = CHECKER_GET();
+	url *url_obj = LIST_TAIL_DATA(http_get_chk->url);
+	int algo = digest_algo(VECTOR_SLOT(strvec, 1));
+
+	if (algo < 0) {
+		log_message(LOG_INFO, "Unknown digest_algo %s, using md5",
+		       VECTOR_SLOT(strvec, 1));
+		algo = DIGEST_MD5;
+	}
+	url_obj->digest_algo = algo;
+	if (url_obj->digest)
+		url_digest_parse(url_obj, 1);
 }
 
 void
@@ -190,6 +316,29 @@ status_code_handler(vector strvec)
 	url_obj->status_code = CHECKER_VALUE_INT(strvec);
 }
 
+static void
+expect_handler(int type, vector strvec)
+{
+	http_get_checker *http_get_chk = CHECKER_GET();
+	url *url_obj = LIST_TAIL_DATA(http_get_chk->url);
+
+	if (!url_obj->expect)
+		url_obj->expect = alloc_expect_set();
+	expect_add(url_obj->expect, type, CHECKER_VALUE_STRING(strvec));
+}
+
+void
+expect_string_handler(vector strvec)
+{
+	expect_handler(EXPECT_STRING, strvec);
+}
+
+void
+expect_regex_handler(vector strvec)
+{
+	expect_handler(EXPECT_REGEX, strvec);
+}
+
 void
 install_http_check_keyword(void)
 {
@@ -200,11 +349,16 @@ install_http_check_keyword(void)
 	install_keyword("connect_timeout", &connect_to_handler);
 	install_keyword("nb_get_retry", &nb_get_retry_handler);
 	install_keyword("delay_before_retry", &delay_before_retry_handler);
+	install_keyword("persistent", &persistent_handler);
+	install_keyword("method", &method_handler);
 	install_keyword("url", &url_handler);
 	install_sublevel();
 	install_keyword("path", &path_handler);
 	install_keyword("digest", &digest_handler);
+	install_keyword("digest_algo", &digest_algo_handler);
 	install_keyword("status_code", &status_code_handler);
+	install_keyword("expect_string", &expect_string_handler);
+	install_keyword("expect_regex", &expect_regex_handler);
 	install_sublevel_end();
 	install_sublevel_end();
 }
@@ -220,11 +374,16 @@ install_ssl_check_keyword(void)
 	install_keyword("connect_timeout", &connect_to_handler);
 	install_keyword("nb_get_retry", &nb_get_retry_handler);
 	install_keyword("delay_before_retry", &delay_before_retry_handler);
+	install_keyword("persistent", &persistent_handler);
+	install_keyword("method", &method_handler);
 	install_keyword("url", &url_handler);
 	install_sublevel();
 	install_keyword("path", &path_handler);
 	install_keyword("digest", &digest_handler);
+	install_keyword("digest_algo", &digest_algo_handler);
 	install_keyword("status_code", &status_code_handler);
+	install_keyword("expect_string", &expect_string_handler);
+	install_keyword("expect_regex", &expect_regex_handler);
 	install_sublevel_end();
 	install_sublevel_end();
 }
@@ -314,7 +473,7 @@ epilog(thread * thread_obj, int method, int t, int c)
 			smtp_alert(checker_obj->rs, NULL, NULL,
 				   "DOWN",
 				   "=> CHECK failed on service"
-				   " : MD5 digest mismatch <=");
+				   " : HTTP check mismatch <=");
 			update_svr_checker_state(DOWN, checker_obj->id
 						     , checker_obj->vs
 						     , checker_obj->rs);
@@ -343,15 +502,7 @@ epilog(thread * thread_obj, int method, int t, int c)
 	}
 
 	/* If req == NULL, fd is not created */
-	if (req) {
-		if (req->ssl)
-			SSL_free(req->ssl);
-		if (req->buffer)
-			FREE(req->buffer);
-		FREE(req);
-		http_arg_obj->req = NULL;
-		close(thread_obj->u.fd);
-	}
+	http_close(http_arg_obj);
 
 	/* Register next checker thread */
 	thread_add_timer(thread_obj->master, http_connect_thread, checker_obj, delay);
@@ -390,29 +541,26 @@ fetch_next_url(http_get_checker * http_get_check)
 	return list_element(http_get_check->url, http_arg_obj->url_it);
 }
 
-/* Handle response */
-int
-http_handle_response(thread * thread_obj, unsigned char digest[16]
-		     , int empty_buffer)
+/*
+ * Check the fetched url status code or digest. The real server is
+ * taken down on mismatch if it was alive. Returns 0 on mismatch.
+ */
+static int
+http_check_url(thread * thread_obj)
 {
 	checker *checker_obj = THREAD_ARG(thread_obj);
 	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
 	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
 	REQ *req = HTTP_REQ(http_arg_obj);
 	uint16_t addr_port = get_service_port(checker_obj);
-	int r, di = 0;
-	char *digest_tmp;
+	unsigned char digest[DIGEST_MAX_LEN];
+	char digest_str[2 * DIGEST_MAX_LEN + 1];
+	int len;
 	url *fetched_url = fetch_next_url(http_get_check);
 
-	/* First check if remote webserver returned data */
-	if (empty_buffer)
-		return timeout_epilog(thread_obj, "=> CHECK failed on service"
-				      " : empty buffer received <=\n\n",
-				      "Read, no data received from ");
-
-	/* Next check the HTTP status code */
+	/* First check the HTTP status code */
 	if (fetched_url->status_code) {
-		if (req->status_code != fetched_url->status_code) {
+		if (req->parser.status_code != fetched_url->status_code) {
 			/* check if server is currently alive */
 			if (svr_checker_up(checker_obj->id, checker_obj->rs)) {
 				log_message(LOG_INFO,
@@ -420,7 +568,7 @@ http_handle_response(thread * thread_obj, unsigned char digest[16]
 				       ", status_code [%d].",
 				       inet_ntop2(CHECKER_RIP(checker_obj)),
 				       ntohs(addr_port), fetched_url->path,
-				       req->status_code);
+				       req->parser.status_code);
 				smtp_alert(checker_obj->rs, NULL, NULL,
 					   "DOWN",
 					   "=> CHECK failed on service"
@@ -433,101 +581,395 @@ http_handle_response(thread * thread_obj, unsigned char digest[16]
 				    inet_ntop2(CHECKER_RIP(checker_obj))
 				    , ntohs(addr_port)
 				    , http_arg_obj->url_it + 1
-				    , req->status_code);
+				    , req->parser.status_code);
 				/*
 				 * We set retry iterator to max value to not retry
 				 * when service is already know as die.
 				 */
 				http_arg_obj->retry_it = http_get_check->nb_get_retry;
 			}
-			return epilog(thread_obj, 2, 0, 1);
-		} else {
+			return 0;
+		} else if (!fetched_url->expect) {
 			if (!svr_checker_up(checker_obj->id, checker_obj->rs))
 				log_message(LOG_INFO,
 				       "HTTP status code success to [%s:%d] url(%d).",
 				       inet_ntop2(CHECKER_RIP(checker_obj))
 				       , ntohs(addr_port)
 				       , http_arg_obj->url_it + 1);
-			return epilog(thread_obj, 1, 1, 0) + 1;
+			return 1;
 		}
 	}
 
-	/* Continue with MD5SUM */
-	if (fetched_url->digest) {
-		/* Compute MD5SUM */
-		digest_tmp = (char *) MALLOC(MD5_BUFFER_LENGTH + 1);
-		for (di = 0; di < 16; di++)
-			sprintf(digest_tmp + 2 * di, "%02x", digest[di]);
-
-		r = strcmp(fetched_url->digest, digest_tmp);
+	/* Then the expected body content */
+	if (fetched_url->expect && !EXPECT_DONE(fetched_url->expect)) {
+		/* check if server is currently alive */
+		if (svr_checker_up(checker_obj->id, checker_obj->rs)) {
+			log_message(LOG_INFO,
+			       "HTTP content error to [%s:%d] url(%s)"
+			       ", expected pattern not found.",
+			       inet_ntop2(CHECKER_RIP(checker_obj)),
+			       ntohs(addr_port), fetched_url->path);
+			smtp_alert(checker_obj->rs, NULL, NULL,
+				   "DOWN",
+				   "=> CHECK failed on service"
+				   " : HTTP content mismatch <=");
+			update_svr_checker_state(DOWN, checker_obj->id
+						     , checker_obj->vs
+						     , checker_obj->rs);
+		} else {
+			DBG("HTTP content to [%s:%d] url(%d) not matched.",
+			    inet_ntop2(CHECKER_RIP(checker_obj))
+			    , ntohs(addr_port)
+			    , http_arg_obj->url_it + 1);
+			http_arg_obj->retry_it = http_get_check->nb_get_retry;
+		}
+		return 0;
+	} else if (fetched_url->expect) {
+		if (!svr_checker_up(checker_obj->id, checker_obj->rs))
+			log_message(LOG_INFO,
+			       "HTTP content success to [%s:%d] url(%d).",
+			       inet_ntop2(CHECKER_RIP(checker_obj))
+			       , ntohs(addr_port)
+			       , http_arg_obj->url_it + 1);
+		if (fetched_url->status_code)
+			return 1;
+	}
 
-		if (r) {
+	/* Continue with the body digest */
+	if (fetched_url->digest) {
+		len = digest_final(&req->context, digest);
+		if (len != fetched_url->digest_len ||
+		    memcmp(digest, fetched_url->digest_bin, len)) {
+			digest_hex(digest, len, digest_str);
 			/* check if server is currently alive */
 			if (svr_checker_up(checker_obj->id, checker_obj->rs)) {
 				log_message(LOG_INFO,
-				       "MD5 digest error to [%s:%d] url[%s]"
-				       ", MD5SUM [%s].",
+				       "%s digest error to [%s:%d] url[%s]"
+				       ", digest [%s].",
+				       digest_name(fetched_url->digest_algo),
 				       inet_ntop2(CHECKER_RIP(checker_obj)),
 				       ntohs(addr_port), fetched_url->path,
-				       digest_tmp);
+				       digest_str);
 				smtp_alert(checker_obj->rs, NULL, NULL,
 					   "DOWN",
 					   "=> CHECK failed on service"
-					   " : HTTP MD5SUM mismatch <=");
+					   " : HTTP digest mismatch <=");
 				update_svr_checker_state(DOWN, checker_obj->id
 							     , checker_obj->vs
 							     , checker_obj->rs);
 			} else {
-				DBG("MD5SUM to [%s:%d] url(%d) = [%s].",
+				DBG("Digest to [%s:%d] url(%d) = [%s].",
 				    inet_ntop2(CHECKER_RIP(checker_obj))
 				    , ntohs(addr_port)
 				    , http_arg_obj->url_it + 1
-				    , digest_tmp);
+				    , digest_str);
 				/*
 				 * We set retry iterator to max value to not retry
 				 * when service is already know as die.
 				 */
 				http_arg_obj->retry_it = http_get_check->nb_get_retry;
 			}
-			FREE(digest_tmp);
-			return epilog(thread_obj, 2, 0, 1);
+			return 0;
 		} else {
 			if (!svr_checker_up(checker_obj->id, checker_obj->rs))
-				log_message(LOG_INFO, "MD5 digest success to [%s:%d] url(%d).",
+				log_message(LOG_INFO, "%s digest success to [%s:%d] url(%d).",
+				       digest_name(fetched_url->digest_algo),
 				       inet_ntop2(CHECKER_RIP(checker_obj))
 				       , ntohs(addr_port)
 				       , http_arg_obj->url_it + 1);
-			FREE(digest_tmp);
-			return epilog(thread_obj, 1, 1, 0) + 1;
+			return 1;
 		}
 	}
 
+	return 1;
+}
+
+/* Handle response */
+int
+http_handle_response(thread * thread_obj, int empty_buffer)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	url *fetched_url = fetch_next_url(http_get_check);
+
+	/* First check if remote webserver returned data */
+	if (empty_buffer)
+		return timeout_epilog(thread_obj, "=> CHECK failed on service"
+				      " : empty buffer received <=\n\n",
+				      "Read, no data received from ");
+
+	if (!http_check_url(thread_obj))
+		return epilog(thread_obj, 2, 0, 1);
+	if (fetched_url->status_code || fetched_url->digest ||
+	    fetched_url->expect)
+		return epilog(thread_obj, 1, 1, 0) + 1;
+
 	return epilog(thread_obj, 1, 0, 0) + 1;
 }
 
-/* Handle response stream performing MD5 updates */
+/*
+ * The digest is only computed when no status code is set, the status
+ * code is then checked alone. Expected patterns are checked in both
+ * cases.
+ */
+static int
+http_url_digest(url * url_obj)
+{
+	return url_obj && !url_obj->status_code && url_obj->digest;
+}
+
+/* Remote Web server answered all the urls */
+static void
+http_check_succeed(checker * checker_obj)
+{
+	uint16_t addr_port = get_service_port(checker_obj);
+
+	if (!svr_checker_up(checker_obj->id, checker_obj->rs)) {
+		log_message(LOG_INFO, "Remote Web server [%s:%d] succeed on service.",
+		       inet_ntop2(CHECKER_RIP(checker_obj))
+		       , ntohs(addr_port));
+		smtp_alert(checker_obj->rs, NULL, NULL, "UP",
+			   "=> CHECK succeed on service <=");
+		update_svr_checker_state(UP, checker_obj->id
+					   , checker_obj->vs
+					   , checker_obj->rs);
+	}
+}
+
+/*
+ * Persistent mode. All the urls are requested at once over an HTTP/1.1
+ * connection kept across delay_loop. Responses come back in order and
+ * are delimited by Content-Length, chunked encoding or connection close.
+ */
+
+/* Is the rest of the body still needed by the url checks */
+static int
+http_need_body(REQ * req)
+{
+	return req->digest || (req->expect && !EXPECT_DONE(req->expect));
+}
+
+/*
+ * Run the parser up to the next event worth stopping for. The body is
+ * fed to the digest and to the expected patterns on the fly. Stops on data
+ * once the rest of the body is no longer needed.
+ */
+static int
+http_parse_stream(REQ * req, char **cur, char *end)
+{
+	http_parser *p = &req->parser;
+	int ret;
+
+	while ((ret = http_parse(p, cur, end)) == HTTP_PARSE_DATA) {
+		if (req->digest)
+			digest_update(&req->context, p->data, p->data_len);
+		if (req->expect)
+			expect_feed(req->expect, p->data, p->data_len);
+		if (!http_need_body(req))
+			break;
+	}
+	return ret;
+}
+
+/* Prepare for the response to the current url */
+static void
+http_parse_start(http_get_checker * http_get_check, REQ * req)
+{
+	url *fetched_url = fetch_next_url(http_get_check);
+
+	http_parser_init(&req->parser,
+			 http_get_check->method == HTTP_METHOD_HEAD);
+	req->digest = http_url_digest(fetched_url);
+	req->expect = fetched_url ? fetched_url->expect : NULL;
+	if (req->expect)
+		expect_reset(req->expect);
+	if (req->digest)
+		digest_init(&req->context, fetched_url->digest_algo);
+}
+
+/* Register the next read on the persistent connection */
+static void
+http_pipeline_read(thread * thread_obj)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	REQ *req = HTTP_REQ(HTTP_ARG(http_get_check));
+
+	if (http_get_check->proto == PROTO_HTTP) {
+		thread_add_read(thread_obj->master, http_read_thread, checker_obj,
+				req->conn.fd, http_get_check->connection_to);
+		return;
+	}
+
+	/* SSL may hold decrypted data the socket won't signal anymore */
+	if (SSL_pending(req->conn.ssl))
+		thread_add_event(thread_obj->master, ssl_read_thread, checker_obj,
+				 req->conn.fd);
+	else
+		thread_add_read(thread_obj->master, ssl_read_thread, checker_obj,
+				req->conn.fd, http_get_check->connection_to);
+}
+
+/* Reopen the connection right away to go on with the remaining urls */
+static int
+http_pipeline_reopen(thread * thread_obj)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+
+	http_close(HTTP_ARG(http_get_check));
+	thread_add_event(thread_obj->master, http_connect_thread, checker_obj, 0);
+	return 1;
+}
+
+/*
+ * A response is complete, check it against its url. left tells if
+ * unread data follows it. Returns 0 to go on reading the pipeline.
+ */
+static int
+http_pipeline_next(thread * thread_obj, int left)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
+	REQ *req = HTTP_REQ(http_arg_obj);
+	int keepalive = req->parser.keepalive;
+
+	if (req->expect)
+		expect_eof(req->expect);
+	if (!http_check_url(thread_obj))
+		return epilog(thread_obj, 2, 0, 1) + 1;
+
+	http_arg_obj->url_it++;
+	http_arg_obj->retry_it = 0;
+	if (fetch_next_url(http_get_check)) {
+		if (!keepalive)
+			return http_pipeline_reopen(thread_obj);
+		http_parse_start(http_get_check, req);
+		return 0;
+	}
+
+	/* All urls answered, keep the connection for next loop */
+	http_check_succeed(checker_obj);
+	http_arg_obj->url_it = 0;
+	if (!keepalive || left)
+		http_close(http_arg_obj);
+	thread_add_timer(thread_obj->master, http_connect_thread, checker_obj,
+			 checker_obj->vs->delay_loop);
+	return 1;
+}
+
+static int
+http_pipeline_error(thread * thread_obj, char *msg)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
+	uint16_t addr_port = get_service_port(checker_obj);
+
+	if (svr_checker_up(checker_obj->id, checker_obj->rs)) {
+		log_message(LOG_INFO, "%s server [%s:%d] url(%d)."
+		       , msg
+		       , inet_ntop2(CHECKER_RIP(checker_obj))
+		       , ntohs(addr_port)
+		       , http_arg_obj->url_it + 1);
+		smtp_alert(checker_obj->rs, NULL, NULL,
+			   "DOWN",
+			   "=> HTTP CHECK failed on service"
+			   " : bad response <=");
+		update_svr_checker_state(DOWN, checker_obj->id
+					     , checker_obj->vs
+					     , checker_obj->rs);
+	}
+	return epilog(thread_obj, 1, 0, 0);
+}
+
+/* Handle r bytes read in the persistent connection buffer */
 int
-http_process_response(REQ *req, int r)
-{
-	req->len += r;
-	if (!req->extracted) {
-		if ((req->extracted =
-		     extract_html(req->buffer, req->len))) {
-			req->status_code = extract_status_code(req->buffer, req->len);
-			r = req->len - (req->extracted - req->buffer);
-			if (r) {
-				memmove(req->buffer, req->extracted, r);
-				MD5_Update(&req->context, req->buffer, r);
-				r = 0;
-			}
-			req->len = r;
-		}
-	} else if (req->len) {
-		MD5_Update(&req->context, req->buffer,
-			   req->len);
-		req->len = 0;
+http_pipeline_input(thread * thread_obj, int r)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	REQ *req = HTTP_REQ(HTTP_ARG(http_get_check));
+	char *cur = req->buffer;
+	char *end = req->buffer + r;
+	int ret;
+
+	req->reused = 0;
+	while ((ret = http_parse_stream(req, &cur, end)) != HTTP_PARSE_MORE) {
+		if (ret == HTTP_PARSE_ERROR)
+			return http_pipeline_error(thread_obj,
+						   "Malformed HTTP response from");
+		if (ret == HTTP_PARSE_DONE &&
+		    http_pipeline_next(thread_obj, cur < end))
+			return 0;
 	}
 
+	http_pipeline_read(thread_obj);
+	return 0;
+}
+
+/* Persistent connection closed or reset by the server */
+int
+http_pipeline_eof(thread * thread_obj)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	REQ *req = HTTP_REQ(HTTP_ARG(http_get_check));
+
+	/* Idle connection dropped by the server in between loops */
+	if (req->reused) {
+		http_pipeline_reopen(thread_obj);
+		return 0;
+	}
+
+	/* Body delimited by connection close */
+	if (http_parse_eof(&req->parser)) {
+		http_pipeline_next(thread_obj, 0);
+		return 0;
+	}
+
+	return http_pipeline_error(thread_obj, "Connection closed by");
+}
+
+/*
+ * Single request mode. Reading stops as soon as the verdict is known :
+ * right after the headers when the url has no digest nor expected
+ * pattern, as soon as all the patterns are found, at the end of the
+ * body otherwise. Only bodies delimited by connection close are
+ * read up to EOF.
+ */
+int
+http_response_done(thread * thread_obj)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	REQ *req = HTTP_REQ(HTTP_ARG(http_get_check));
+
+	if (req->expect)
+		expect_eof(req->expect);
+	return http_handle_response(thread_obj, !req->parser.headers);
+}
+
+int
+http_response_input(thread * thread_obj, int r)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	REQ *req = HTTP_REQ(HTTP_ARG(http_get_check));
+	char *cur = req->buffer;
+	char *end = req->buffer + r;
+	int ret;
+
+	while ((ret = http_parse_stream(req, &cur, end)) != HTTP_PARSE_MORE) {
+		if (ret == HTTP_PARSE_ERROR)
+			return http_pipeline_error(thread_obj,
+						   "Malformed HTTP response from");
+		if (ret == HTTP_PARSE_DONE || !http_need_body(req))
+			return http_response_done(thread_obj);
+	}
+
+	http_pipeline_read(thread_obj);
 	return 0;
 }
 
@@ -540,41 +982,23 @@ http_read_thread(thread * thread_obj)
 	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
 	REQ *req = HTTP_REQ(http_arg_obj);
 	uint16_t addr_port = get_service_port(checker_obj);
-	unsigned char digest[16];
 	int r = 0;
-	int val;
 
 	/* Handle read timeout */
 	if (thread_obj->type == THREAD_READ_TIMEOUT)
 		return timeout_epilog(thread_obj, "=> HTTP CHECK failed on service"
 				      " : recevice data <=\n\n", "HTTP read");
 
-	/* Set descriptor non blocking */
-	val = fcntl(thread_obj->u.fd, F_GETFL, 0);
-	fcntl(thread_obj->u.fd, F_SETFL, val | O_NONBLOCK);
-
-	/* read the HTTP stream */
-	r = read(thread_obj->u.fd, req->buffer + req->len,
-		 MAX_BUFFER_LENGTH - req->len);
-
-	/* restore descriptor flags */
-	fcntl(thread_obj->u.fd, F_SETFL, val);
-
-	/* Test if data are ready */
-	if (r == -1 && (errno == EAGAIN || errno == EINTR)) {
-		log_message(LOG_INFO, "Read error with server [%s:%d]: %s",
-		       inet_ntop2(CHECKER_RIP(checker_obj))
-		       , ntohs(addr_port)
-		       , strerror(errno));
-		thread_add_read(thread_obj->master, http_read_thread, checker_obj,
-				thread_obj->u.fd, http_get_check->connection_to);
+	/* read the HTTP stream, we are registered back if data are not ready */
+	r = l4_read(&req->conn, thread_obj, http_read_thread,
+		    http_get_check->connection_to, req->buffer, MAX_BUFFER_LENGTH);
+	if (r == L4_AGAIN)
 		return 0;
-	}
 
 	if (r == -1 || r == 0) {	/* -1:error , 0:EOF */
 
-		/* All the HTTP stream has been parsed */
-		MD5_Final(digest, &req->context);
+		if (http_get_check->persistent && (r == 0 || req->reused))
+			return http_pipeline_eof(thread_obj);
 
 		if (r == -1) {
 			/* We have encourred a real read error */
@@ -594,23 +1018,14 @@ http_read_thread(thread * thread_obj)
 			return epilog(thread_obj, 1, 0, 0);
 		}
 
-		/* Handle response stream */
-		http_handle_response(thread_obj, digest, (!req->extracted) ? 1 : 0);
-
-	} else {
-
-		/* Handle response stream */
-		http_process_response(req, r);
-
-		/*
-		 * Register next http stream reader.
-		 * Register itself to not perturbe global I/O multiplexer.
-		 */
-		thread_add_read(thread_obj->master, http_read_thread, checker_obj,
-				thread_obj->u.fd, http_get_check->connection_to);
+		/* All the HTTP stream has been parsed */
+		return http_response_done(thread_obj);
 	}
 
-	return 0;
+	/* Handle response stream */
+	if (http_get_check->persistent)
+		return http_pipeline_input(thread_obj, r);
+	return http_response_input(thread_obj, r);
 }
 
 /*
@@ -630,12 +1045,8 @@ http_response_thread(thread * thread_obj)
 		return timeout_epilog(thread_obj, "=> CHECK failed on service"
 				      " : recevice data <=\n\n", "WEB read");
 
-	/* Allocate & clean the get buffer */
-	req->buffer = (char *) MALLOC(MAX_BUFFER_LENGTH);
-	req->extracted = NULL;
-	req->len = 0;
-	req->error = 0;
-	MD5_Init(&req->context);
+	req->conn.error = 0;
+	http_parse_start(http_get_check, req);
 
 	/* Register asynchronous http/ssl read thread */
 	if (http_get_check->proto == PROTO_SSL)
@@ -647,6 +1058,48 @@ http_response_thread(thread * thread_obj)
 	return 0;
 }
 
+/*
+ * Requests only depend on the configuration. They are formatted once,
+ * back to back, on the checker first run when its address and port
+ * are final.
+ */
+static void
+http_prepare_requests(checker * checker_obj)
+{
+	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
+	uint16_t addr_port = get_service_port(checker_obj);
+	char *vhost = CHECKER_VHOST(checker_obj);
+	char *host = (vhost) ? vhost : inet_ntop2(CHECKER_RIP(checker_obj));
+	char *template = (http_get_check->persistent) ?
+			 REQUEST_TEMPLATE_PERSISTENT : REQUEST_TEMPLATE;
+	char buf[GET_BUFFER_LENGTH];
+	url *url_obj;
+	element e;
+	int len = 0;
+
+	for (e = LIST_HEAD(http_get_check->url); e; ELEMENT_NEXT(e)) {
+		url_obj = ELEMENT_DATA(e);
+		url_obj->request_len = snprintf(buf, GET_BUFFER_LENGTH, template,
+						HTTP_METHOD(http_get_check),
+						url_obj->path, host,
+						ntohs(addr_port));
+		if (url_obj->request_len >= GET_BUFFER_LENGTH)
+			url_obj->request_len = GET_BUFFER_LENGTH - 1;
+		len += url_obj->request_len;
+	}
+
+	http_get_check->requests = (char *) MALLOC(len + 1);
+	http_get_check->requests_len = len;
+	for (e = LIST_HEAD(http_get_check->url), len = 0; e; ELEMENT_NEXT(e)) {
+		url_obj = ELEMENT_DATA(e);
+		url_obj->request = http_get_check->requests + len;
+		snprintf(url_obj->request, url_obj->request_len + 1, template,
+			 HTTP_METHOD(http_get_check), url_obj->path, host,
+			 ntohs(addr_port));
+		len += url_obj->request_len;
+	}
+}
+
 /* remote Web server is connected, send it the get url query.  */
 int
 http_request_thread(thread * thread_obj)
@@ -656,11 +1109,10 @@ http_request_thread(thread * thread_obj)
 	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
 	REQ *req = HTTP_REQ(http_arg_obj);
 	uint16_t addr_port = get_service_port(checker_obj);
-	char *vhost = CHECKER_VHOST(checker_obj);
-	char *str_request;
-	url *fetched_url;
+	url *fetched_url = fetch_next_url(http_get_check);
+	char *str_request = fetched_url->request;
 	int ret = 0;
-	int val;
+	int len;
 
 	/* Handle read timeout */
 	if (thread_obj->type == THREAD_WRITE_TIMEOUT)
@@ -668,38 +1120,27 @@ http_request_thread(thread * thread_obj)
 				      " : read timeout <=\n\n",
 				      "Web read, timeout");
 
-	/* Allocate & clean the GET string */
-	str_request = (char *) MALLOC(GET_BUFFER_LENGTH);
-
-	fetched_url = fetch_next_url(http_get_check);
-	snprintf(str_request, GET_BUFFER_LENGTH, REQUEST_TEMPLATE,
-		 fetched_url->path,
-		 (vhost) ? vhost : inet_ntop2(CHECKER_RIP(checker_obj))
-		 , ntohs(addr_port));
+	/* Pipeline all the urls left, their requests follow each other */
+	if (http_get_check->persistent)
+		len = http_get_check->requests + http_get_check->requests_len -
+		      str_request;
+	else
+		len = fetched_url->request_len;
 	DBG("Processing url(%d) of [%s:%d].",
 	    http_arg_obj->url_it + 1
 	    , inet_ntop2(CHECKER_RIP(checker_obj))
 	    , ntohs(addr_port));
 
-	/* Set descriptor non blocking */
-	val = fcntl(thread_obj->u.fd, F_GETFL, 0);
-	fcntl(thread_obj->u.fd, F_SETFL, val | O_NONBLOCK);
-
-	/* Send the GET request to remote Web server */
-	if (http_get_check->proto == PROTO_SSL) {
-		ret = ssl_send_request(req->ssl, str_request,
-				       strlen(str_request));
-	} else {
-		ret = (send(thread_obj->u.fd, str_request, strlen(str_request), 0) !=
-		       -1) ? 1 : 0;
-	}
-
-	/* restore descriptor flags */
-	fcntl(thread_obj->u.fd, F_SETFL, val);
+	/* Send the GET request to remote Web server, short writes come back here */
+	ret = l4_write(&req->conn, thread_obj, http_request_thread,
+		       http_get_check->connection_to, str_request, len);
+	if (ret == L4_AGAIN)
+		return 0;
 
-	FREE(str_request);
+	if (ret == L4_ERROR && http_get_check->persistent && req->reused)
+		return http_pipeline_eof(thread_obj);
 
-	if (!ret) {
+	if (ret == L4_ERROR) {
 		log_message(LOG_INFO, "Cannot send get request to [%s:%d].",
 		       inet_ntop2(CHECKER_RIP(checker_obj))
 		       , ntohs(addr_port));
@@ -737,7 +1178,6 @@ http_check_thread(thread * thread_obj)
 	int ret = 1;
 	int status;
 	long timeout = 0;
-	int ssl_err = 0;
 	int new_req = 0;
 
 	status = tcp_socket_state(thread_obj->u.fd, thread_obj, CHECKER_RIP(checker_obj)
@@ -768,7 +1208,8 @@ http_check_thread(thread * thread_obj)
 
 	case connect_success:{
 			if (!http_arg_obj->req) {
-				http_arg_obj->req = (REQ *) MALLOC(sizeof (REQ));
+				http_arg_obj->req = http_req_get();
+				http_arg_obj->req->conn.fd = thread_obj->u.fd;
 				new_req = 1;
 			} else
 				new_req = 0;
@@ -778,15 +1219,19 @@ http_check_thread(thread * thread_obj)
 				if (thread_obj->type != THREAD_WRITE_TIMEOUT &&
 				    thread_obj->type != THREAD_READ_TIMEOUT)
 					ret = ssl_connect(thread_obj, new_req);
-				else {
+				else
+					ret = SSL_CONNECT_TIMEOUT;
+
+				if (ret == SSL_CONNECT_PENDING)
+					break;
+				if (ret == SSL_CONNECT_TIMEOUT) {
 					return timeout_epilog(thread_obj, "==> CHECK failed on service"
 							      " : connection timeout <=\n\n",
 							      "connect, timeout");
 				}
 
 				if (ret == -1) {
-					switch ((ssl_err = SSL_get_error(http_arg_obj->req->ssl,
-									 ret))) {
+					switch (http_arg_obj->req->conn.error) {
 					case SSL_ERROR_WANT_READ:
 						thread_add_read(thread_obj->master,
 								http_check_thread,
@@ -826,15 +1271,18 @@ http_check_thread(thread * thread_obj)
 				    , ntohs(addr_port));
 #ifdef _DEBUG_
 				if (http_get_check->proto == PROTO_SSL)
-					ssl_printerr(SSL_get_error
-						     (req->ssl, ret));
+					ssl_printerr(req->conn.error);
 #endif
+				/* Next check runs a full handshake */
+				if (http_get_check->proto == PROTO_SSL)
+					ssl_forget_session(http_get_check);
+
 				if ((http_get_check->proto == PROTO_SSL) &&
 				    (svr_checker_up(checker_obj->id, checker_obj->rs))) {
 					log_message(LOG_INFO, "SSL handshake/communication error"
 							 " connecting to server"
 							 " (openssl errno: %d) [%s:%d]."
-						       , SSL_get_error (http_arg_obj->req->ssl, ret)
+						       , http_arg_obj->req->conn.error
 						       , inet_ntop2(CHECKER_RIP(checker_obj))
 						       , ntohs(addr_port));
 					smtp_alert(checker_obj->rs, NULL, NULL,
@@ -862,9 +1310,11 @@ http_connect_thread(thread * thread_obj)
 	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
 	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
 	uint16_t addr_port = get_service_port(checker_obj);
+	REQ *req = HTTP_REQ(http_arg_obj);
 	url *fetched_url;
 	enum connect_result status;
 	int fd;
+	char c;
 
 	/*
 	 * Register a new checker thread & return
@@ -876,6 +1326,9 @@ http_connect_thread(thread * thread_obj)
 		return 0;
 	}
 
+	if (!http_get_check->requests)
+		http_prepare_requests(checker_obj);
+
 	/* Find eventual url end */
 	fetched_url = fetch_next_url(http_get_check);
 
@@ -884,22 +1337,26 @@ http_connect_thread(thread * thread_obj)
 		 * Check completed.
 		 * check if server is currently alive.
 		 */
-		if (!svr_checker_up(checker_obj->id, checker_obj->rs)) {
-			log_message(LOG_INFO, "Remote Web server [%s:%d] succeed on service.",
-			       inet_ntop2(CHECKER_RIP(checker_obj))
-			       , ntohs(addr_port));
-			smtp_alert(checker_obj->rs, NULL, NULL, "UP",
-				   "=> CHECK succeed on service <=");
-			update_svr_checker_state(UP, checker_obj->id
-						   , checker_obj->vs
-						   , checker_obj->rs);
-		}
+		http_check_succeed(checker_obj);
 		http_arg_obj->req = NULL;
 		return epilog(thread_obj, 1, 0, 0) + 1;
 	}
 
+	/* Go on with the kept connection unless the server dropped it */
+	if (http_get_check->persistent && req) {
+		if (recv(req->conn.fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) < 0 &&
+		    errno == EAGAIN) {
+			req->reused = 1;
+			thread_add_write(thread_obj->master, http_request_thread,
+					 checker_obj, req->conn.fd,
+					 http_get_check->connection_to);
+			return 0;
+		}
+		http_close(http_arg_obj);
+	}
+
 	/* Create the socket */
-	if ((fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) {
+	if ((fd = tcp_socket()) == -1) {
 		DBG("WEB connection fail to create socket.");
 		return 0;
 	}
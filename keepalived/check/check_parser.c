@@ -59,6 +59,11 @@ sslkey_handler(vector strvec)
 {
 	check_data->ssl->keyfile = set_value(strvec);
 }
+static void
+sslworkers_handler(vector strvec)
+{
+	check_data->ssl->workers = atoi(VECTOR_SLOT(strvec, 1));
+}
 
 /* Virtual Servers handlers */
 static void
@@ -274,6 +279,7 @@ check_init_keywords(void)
 	install_keyword("ca", &sslca_handler);
 	install_keyword("certificate", &sslcert_handler);
 	install_keyword("key", &sslkey_handler);
+	install_keyword("handshake_workers", &sslworkers_handler);
 
 	/* Virtual server mapping */
 	install_keyword_root("virtual_server_group", &vsg_handler);
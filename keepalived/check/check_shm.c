@@ -0,0 +1,146 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        SHM CHECK. Read realserver state from the shared memory
+ *              tracking feed maintained by an external process.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include "check_shm.h"
+#include "check_api.h"
+#include "track_shm.h"
+#include "memory.h"
+#include "ipwrapper.h"
+#include "logger.h"
+#include "smtp.h"
+#include "utils.h"
+#include "parser.h"
+
+int shm_check_thread(thread *);
+
+/* Configuration stream handling */
+void
+free_shm_check(void *data)
+{
+	shm_checker *shm_chk = CHECKER_DATA(data);
+
+	FREE_PTR(shm_chk->slot);
+	FREE(shm_chk);
+	FREE(data);
+}
+
+void
+dump_shm_check(void *data)
+{
+	shm_checker *shm_chk = CHECKER_DATA(data);
+	log_message(LOG_INFO, "   Keepalive method = SHM_CHECK");
+	log_message(LOG_INFO, "   slot = %s", shm_chk->slot);
+}
+
+void
+shm_check_handler(vector strvec)
+{
+	shm_checker *shm_chk = (shm_checker *) MALLOC(sizeof (shm_checker));
+
+	shm_chk->index = -1;
+	shm_chk->generation = TRACK_SHM_NOGEN;
+
+	/* queue new checker */
+	queue_checker(free_shm_check, dump_shm_check, shm_check_thread,
+		      shm_chk);
+}
+
+void
+shm_slot_handler(vector strvec)
+{
+	shm_checker *shm_chk = CHECKER_GET();
+	shm_chk->slot = CHECKER_VALUE_STRING(strvec);
+}
+
+void
+install_shm_check_keyword(void)
+{
+	install_keyword("SHM_CHECK", &shm_check_handler);
+	install_sublevel();
+	install_keyword("shm_slot", &shm_slot_handler);
+	install_sublevel_end();
+}
+
+static void
+shm_check_state(checker * checker_obj, int alive, char *reason)
+{
+	shm_checker *shm_chk = CHECKER_ARG(checker_obj);
+
+	if (alive == svr_checker_up(checker_obj->id, checker_obj->rs))
+		return;
+
+	log_message(LOG_INFO, "Shm check to [%s] for [%s] %s.",
+	       inet_ntop2(CHECKER_RIP(checker_obj)), shm_chk->slot, reason);
+	smtp_alert(checker_obj->rs, NULL, NULL,
+		   (alive) ? "UP" : "DOWN",
+		   (alive) ? "=> SHM CHECK succeed on service <=" :
+			     "=> SHM CHECK failed on service <=");
+	update_svr_checker_state(alive, checker_obj->id
+				      , checker_obj->vs
+				      , checker_obj->rs);
+}
+
+/*
+ * Polled every delay_loop, only a slot generation change is applied.
+ * No fork and no connection, this is a couple of memory reads.
+ */
+int
+shm_check_thread(thread * thread_obj)
+{
+	checker *checker_obj;
+	shm_checker *shm_chk;
+	track_shm_value val;
+
+	checker_obj = THREAD_ARG(thread_obj);
+	shm_chk = CHECKER_ARG(checker_obj);
+
+	/* Register next timer checker */
+	thread_add_timer(thread_obj->master, shm_check_thread, checker_obj,
+			 checker_obj->vs->delay_loop);
+
+	if (!CHECKER_ENABLED(checker_obj) || !shm_chk->slot)
+		return 0;
+
+	if (track_shm_read(shm_chk->slot, &shm_chk->index, &val) < 0) {
+		/* Slot busy, try again next round */
+		if (shm_chk->index >= 0)
+			return 0;
+		shm_chk->generation = TRACK_SHM_NOGEN;
+		shm_check_state(checker_obj, 0, "missing from feed");
+		return 0;
+	}
+
+	if (val.generation == shm_chk->generation)
+		return 0;
+	shm_chk->generation = val.generation;
+
+	if (val.status) {
+		shm_check_state(checker_obj, 0, "failed");
+		return 0;
+	}
+
+	if (val.weight != TRACK_SHM_NOWEIGHT)
+		update_svr_wgt(val.weight, checker_obj->vs, checker_obj->rs);
+	shm_check_state(checker_obj, 1, "success");
+	return 0;
+}
@@ -379,7 +379,7 @@ smtp_get_line_cb(thread *thread_obj)
 	checker *chk = THREAD_ARG(thread_obj);
 	smtp_checker *smtp_chk = CHECKER_ARG(chk);
 	smtp_host *smtp_hst = smtp_chk->host_ptr;
-	int f, r, x;
+	int r, x;
 
         /* Handle read timeout */
         if (thread_obj->type == THREAD_READ_TIMEOUT) {
@@ -396,25 +396,15 @@ smtp_get_line_cb(thread *thread_obj)
 		smtp_clear_buff(thread_obj);
 	}
 
-	/* Set descriptor non blocking */
-        f = fcntl(thread_obj->u.fd, F_GETFL, 0);
-        fcntl(thread_obj->u.fd, F_SETFL, f | O_NONBLOCK);
-
-        /* read the data */
-        r = read(thread_obj->u.fd, smtp_chk->buff + smtp_chk->buff_ctr,
-                 SMTP_BUFF_MAX - smtp_chk->buff_ctr);
-
-	if (r == -1 && (errno == EAGAIN || errno == EINTR)) {
-		thread_add_read(thread_obj->master, smtp_get_line_cb, chk,
-				thread_obj->u.fd, smtp_chk->timeout);
-        	fcntl(thread_obj->u.fd, F_SETFL, f);
+	/* read the data, we are registered back if there is none yet */
+	r = l4_read(&smtp_chk->conn, thread_obj, smtp_get_line_cb,
+		    smtp_chk->timeout, smtp_chk->buff + smtp_chk->buff_ctr,
+		    SMTP_BUFF_MAX - smtp_chk->buff_ctr);
+	if (r == L4_AGAIN)
 		return 0;
-	} else if (r > 0)
+	else if (r > 0)
 		smtp_chk->buff_ctr += r;
 
-        /* restore descriptor flags */
-        fcntl(thread_obj->u.fd, F_SETFL, f);
-
 	/* check if we have a newline, if so, callback */
 	for (x = 0; x < SMTP_BUFF_MAX; x++) {
 		if (smtp_chk->buff[x] == '\n') {
@@ -478,9 +468,8 @@ smtp_get_line(thread *thread_obj, int (*callback) (struct _thread *))
 
 /*
  * The scheduler function that puts the data out on the wire.
- * All our data will fit into one packet, so we only check if
- * the current write would block or not. If it wants to block,
- * we'll return to the scheduler and try again later. 
+ * If the write would block or is short, l4_write() returns us
+ * to the scheduler and we go on from there later.
  */
 int
 smtp_put_line_cb(thread *thread_obj)
@@ -488,7 +477,7 @@ smtp_put_line_cb(thread *thread_obj)
 	checker *chk = THREAD_ARG(thread_obj);
 	smtp_checker *smtp_chk = CHECKER_ARG(chk);
 	smtp_host *smtp_hst = smtp_chk->host_ptr;
-	int f, w;
+	int w;
 
 
         /* Handle read timeout */
@@ -498,22 +487,11 @@ smtp_put_line_cb(thread *thread_obj)
 		return 0;
 	}
 
-	/* Set descriptor non blocking */
-        f = fcntl(thread_obj->u.fd, F_GETFL, 0);
-        fcntl(thread_obj->u.fd, F_SETFL, f | O_NONBLOCK);
-
-        /* write the data */
-        w = write(thread_obj->u.fd, smtp_chk->buff, smtp_chk->buff_ctr);
-
-	if (w == -1 && (errno == EAGAIN || errno == EINTR)) {
-		thread_add_write(thread_obj->master, smtp_put_line_cb, chk,
-				 thread_obj->u.fd, smtp_chk->timeout);
-        	fcntl(thread_obj->u.fd, F_SETFL, f);
+	/* write the data, we are registered back until it is all out */
+	w = l4_write(&smtp_chk->conn, thread_obj, smtp_put_line_cb,
+		     smtp_chk->timeout, smtp_chk->buff, smtp_chk->buff_ctr);
+	if (w == L4_AGAIN)
 		return 0;
-	}
-
-        /* restore descriptor flags */
-        fcntl(thread_obj->u.fd, F_SETFL, f);
 
 	DBG("SMTP_CHECK [%s:%d] > %s", inet_ntop2(smtp_hst->ip),
 	    ntohs(smtp_hst->port), smtp_chk->buff);
@@ -701,6 +679,8 @@ smtp_check_thread(thread *thread_obj)
 			    inet_ntop2(smtp_hst->ip), ntohs(smtp_hst->port));
 
 			/* Enter the engine at SMTP_START */
+			smtp_chk->conn.fd = thread_obj->u.fd;
+			smtp_chk->conn.sent = 0;
 			smtp_chk->state = SMTP_START;
 			smtp_engine_thread(thread_obj);
 			return 0;
@@ -796,7 +776,7 @@ smtp_connect_thread(thread *thread_obj)
 	smtp_hst = smtp_chk->host_ptr;
 
 	/* Create the socket, failling here should be an oddity */
-	if ((sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) {
+	if ((sd = tcp_socket()) == -1) {
 		DBG("SMTP_CHECK connection failed to create socket.");
 		thread_add_timer(thread_obj->master, smtp_connect_thread, chk,
 				 chk->vs->delay_loop);
@@ -57,6 +57,34 @@ password_cb(char *buf, int num, int rwflag, void *userdata)
 	return (plen);
 }
 
+/*
+ * New session, or TLSv1.3 ticket received after the handshake. Kept
+ * by the checker to resume its next connection to the same server.
+ */
+static int
+ssl_new_session(SSL * ssl, SSL_SESSION * session)
+{
+	checker *checker_obj = SSL_get_app_data(ssl);
+	http_get_checker *http_get_check;
+
+	if (!checker_obj)
+		return 0;
+
+	http_get_check = CHECKER_ARG(checker_obj);
+	if (http_get_check->ssl_session)
+		SSL_SESSION_free(http_get_check->ssl_session);
+	http_get_check->ssl_session = session;
+	return 1;
+}
+
+void
+ssl_forget_session(http_get_checker * http_get_check)
+{
+	if (http_get_check->ssl_session)
+		SSL_SESSION_free(http_get_check->ssl_session);
+	http_get_check->ssl_session = NULL;
+}
+
 /* Inititalize global SSL context */
 static BIO *bio_err = 0;
 static int
@@ -79,6 +107,18 @@ build_ssl_ctx(void)
 	ssl->meth = SSLv23_method();
 	ssl->ctx = SSL_CTX_new(ssl->meth);
 
+	/*
+	 * Client session cache. Sessions and tickets are handed to the
+	 * checkers, so each real server resumes its own session.
+	 */
+	SSL_CTX_set_session_cache_mode(ssl->ctx, SSL_SESS_CACHE_CLIENT |
+					 SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ssl->ctx, ssl_new_session);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	/* Servers closing without close_notify would void the session */
+	SSL_CTX_set_options(ssl->ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
 	/* return for autogen context */
 	if (!check_data->ssl) {
 		check_data->ssl = ssl;
@@ -153,7 +193,7 @@ int
 ssl_printerr(int err)
 {
 	unsigned long extended_error = 0;
-	char *ssl_strerr;
+	char ssl_strerr[256];
 
 	switch (err) {
 	case SSL_ERROR_ZERO_RETURN:
@@ -175,18 +215,23 @@ ssl_printerr(int err)
 		log_message(LOG_INFO, "  SSL error: (syscall error)");
 		break;
 	case SSL_ERROR_SSL:{
-			ssl_strerr = (char *) MALLOC(500);
-
 			extended_error = ERR_get_error();
-			ERR_error_string(extended_error, ssl_strerr);
+			ERR_error_string_n(extended_error, ssl_strerr,
+					   sizeof (ssl_strerr));
 			log_message(LOG_INFO, "  SSL error: (%s)", ssl_strerr);
-			FREE(ssl_strerr);
 			break;
 		}
 	}
 	return 0;
 }
 
+/* Handshake back from the SSL pool, resume the checker */
+static void
+ssl_connect_done(ssl_job * job)
+{
+	thread_add_event(master, http_check_thread, job->arg, job->fd);
+}
+
 int
 ssl_connect(thread * thread_obj, int new_req)
 {
@@ -194,46 +239,84 @@ ssl_connect(thread * thread_obj, int new_req)
 	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
 	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
 	REQ *req = HTTP_REQ(http_arg_obj);
+	ssl_job *job = &req->job;
 	int ret = 0;
-	int val = 0;
 
-	/* First round, create SSL context */
+	/* First round, create SSL context and try to resume */
 	if (new_req) {
-		req->ssl = SSL_new(check_data->ssl->ctx);
-		req->bio = BIO_new_socket(thread_obj->u.fd, BIO_NOCLOSE);
-		SSL_set_bio(req->ssl, req->bio, req->bio);
+		req->conn.ssl = SSL_new(check_data->ssl->ctx);
+		SSL_set_fd(req->conn.ssl, thread_obj->u.fd);
+		SSL_set_app_data(req->conn.ssl, checker_obj);
+		if (http_get_check->ssl_session)
+			SSL_set_session(req->conn.ssl, http_get_check->ssl_session);
 	}
 
-	/* Set descriptor non blocking */
-	val = fcntl(thread_obj->u.fd, F_GETFL, 0);
-	fcntl(thread_obj->u.fd, F_SETFL, val | O_NONBLOCK);
-
-	ret = SSL_connect(req->ssl);
+	if (ssl_pool_size() && job->state == SSL_JOB_IDLE) {
+		/*
+		 * Whole handshake runs on a worker. The SSL object and the
+		 * checker session are left alone until ssl_connect_done().
+		 */
+		job->ssl = req->conn.ssl;
+		job->fd = thread_obj->u.fd;
+		job->timeout = TIMER_LONG(thread_obj->sands) - TIMER_LONG(time_now);
+		job->done = ssl_connect_done;
+		job->arg = checker_obj;
+		ssl_pool_submit(job);
+		return SSL_CONNECT_PENDING;
+	} else if (job->state == SSL_JOB_DONE) {
+		job->state = SSL_JOB_IDLE;
+		if (job->timedout)
+			return SSL_CONNECT_TIMEOUT;
+		ret = job->ret;
+		req->conn.error = job->error;
+	} else {
+		ERR_clear_error();
+		ret = SSL_connect(req->conn.ssl);
+		req->conn.error = SSL_get_error(req->conn.ssl, ret);
+	}
 
-	/* restore descriptor flags */
-	fcntl(thread_obj->u.fd, F_SETFL, val);
+	if (ret == 1) {
+		if (SSL_session_reused(req->conn.ssl))
+			http_get_check->ssl_resumed++;
+		else
+			http_get_check->ssl_handshake++;
+	}
 
 	return ret;
 }
 
-int
-ssl_send_request(SSL * ssl, char *str_request, int request_len)
+/* SSL_GET handshake counters, dumped on SIGUSR2 */
+void
+ssl_print_stats(FILE * fp)
 {
-	int err, r = 0;
-
-	while (1) {
-		err = 1;
-		r = SSL_write(ssl, str_request, request_len);
-		if (SSL_ERROR_NONE != SSL_get_error(ssl, r))
-			break;
-		err++;
-		if (request_len != r)
-			break;
-		err++;
-		break;
+	http_get_checker *http_get_check;
+	unsigned long full = 0, resumed = 0;
+	checker *checker_obj;
+	element e;
+
+	for (e = LIST_HEAD(checkers_queue); e; ELEMENT_NEXT(e)) {
+		checker_obj = ELEMENT_DATA(e);
+		if (checker_obj->free_func != free_http_get_check)
+			continue;
+		http_get_check = CHECKER_ARG(checker_obj);
+		if (http_get_check->proto != PROTO_SSL)
+			continue;
+
+		fprintf(fp, "SSL_GET: [%s:%d]\n",
+			inet_ntop2(CHECKER_RIP(checker_obj)),
+			ntohs(get_service_port(checker_obj)));
+		fprintf(fp, "  Full handshakes: %lu\n", http_get_check->ssl_handshake);
+		fprintf(fp, "  Resumed: %lu\n", http_get_check->ssl_resumed);
+		full += http_get_check->ssl_handshake;
+		resumed += http_get_check->ssl_resumed;
 	}
 
-	return (err == 3) ? 1 : 0;
+	if (!full && !resumed)
+		return;
+	fprintf(fp, "SSL sessions:\n");
+	fprintf(fp, "  Full handshakes: %lu\n", full);
+	fprintf(fp, "  Resumed: %lu\n", resumed);
+	fprintf(fp, "  Hit rate: %lu%%\n", resumed * 100 / (full + resumed));
 }
 
 /* Asynchronous SSL stream reader */
@@ -244,69 +327,44 @@ ssl_read_thread(thread * thread_obj)
 	http_get_checker *http_get_check = CHECKER_ARG(checker_obj);
 	http_arg *http_arg_obj = HTTP_ARG(http_get_check);
 	REQ *req = HTTP_REQ(http_arg_obj);
-	unsigned char digest[16];
 	int r = 0;
-	int val;
 
 	/* Handle read timeout */
-	if (thread_obj->type == THREAD_READ_TIMEOUT && !req->extracted)
+	if (thread_obj->type == THREAD_READ_TIMEOUT)
 		return timeout_epilog(thread_obj, "=> SSL CHECK failed on service"
 				      " : recevice data <=\n\n", "SSL read");
 
-	/* Set descriptor non blocking */
-	val = fcntl(thread_obj->u.fd, F_GETFL, 0);
-	fcntl(thread_obj->u.fd, F_SETFL, val | O_NONBLOCK);
-
-	/* read the SSL stream */
-	r = SSL_read(req->ssl, req->buffer + req->len,
-		     MAX_BUFFER_LENGTH - req->len);
-
-	/* restore descriptor flags */
-	fcntl(thread_obj->u.fd, F_SETFL, val);
-
-	req->error = SSL_get_error(req->ssl, r);
+	/* read the SSL stream, we are registered back if data are not ready */
+	r = l4_read(&req->conn, thread_obj, ssl_read_thread,
+		    http_get_check->connection_to, req->buffer, MAX_BUFFER_LENGTH);
+	if (r == L4_AGAIN)
+		return 0;
 
-	if (req->error == SSL_ERROR_WANT_READ) {
-		 /* async read unfinished */ 
-		thread_add_read(thread_obj->master, ssl_read_thread, checker_obj,
-				thread_obj->u.fd, http_get_check->connection_to);
-	} else if (r > 0 && req->error == 0) {
-		/* Handle response stream */
-		http_process_response(req, r);
+	/* Handle response stream */
+	if (r > 0) {
+		if (http_get_check->persistent)
+			return http_pipeline_input(thread_obj, r);
+		return http_response_input(thread_obj, r);
+	}
 
-		/*
-		 * Register next ssl stream reader.
-		 * Register itself to not perturbe global I/O multiplexer.
-		 */
-		thread_add_read(thread_obj->master, ssl_read_thread, checker_obj,
-				thread_obj->u.fd, http_get_check->connection_to);
-	} else if (req->error) {
-
-		/* All the SSL streal has been parsed */
-		MD5_Final(digest, &req->context);
-		SSL_set_quiet_shutdown(req->ssl, 1);
-
-		r = (req->error ==
-		     SSL_ERROR_ZERO_RETURN) ? SSL_shutdown(req->ssl) : 0;
-
-		if (r && !req->extracted) {
-			/* check if server is currently alive */
-			if (svr_checker_up(checker_obj->id, checker_obj->rs)) {
-				smtp_alert(checker_obj->rs, NULL, NULL,
-					   "DOWN",
-					   "=> SSL CHECK failed on service"
-					   " : cannot receive data <=\n\n");
-				update_svr_checker_state(DOWN, checker_obj->id
-							     , checker_obj->vs
-							     , checker_obj->rs);
-			}
-			return epilog(thread_obj, 1, 0, 0);
+	if (http_get_check->persistent)
+		return http_pipeline_eof(thread_obj);
+
+	/* Nothing at all before the stream was closed */
+	if (!req->parser.headers && r == L4_EOF) {
+		/* check if server is currently alive */
+		if (svr_checker_up(checker_obj->id, checker_obj->rs)) {
+			smtp_alert(checker_obj->rs, NULL, NULL,
+				   "DOWN",
+				   "=> SSL CHECK failed on service"
+				   " : cannot receive data <=\n\n");
+			update_svr_checker_state(DOWN, checker_obj->id
+						     , checker_obj->vs
+						     , checker_obj->rs);
 		}
-
-		/* Handle response stream */
-		http_handle_response(thread_obj, digest, (!req->extracted) ? 1 : 0);
-
+		return epilog(thread_obj, 1, 0, 0);
 	}
 
-	return 0;
+	/* All the SSL stream has been parsed */
+	return http_response_done(thread_obj);
 }
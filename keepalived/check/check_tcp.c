@@ -31,6 +31,7 @@
 #include "parser.h"
 
 int tcp_connect_thread(thread *);
+int tcp_watch_thread(thread *);
 
 /* Configuration stream handling */
 void
@@ -38,6 +39,8 @@ free_tcp_check(void *data)
 {
 	tcp_checker *tcp_chk = CHECKER_DATA(data);
 
+	if (tcp_chk->conn.fd != -1)
+		close(tcp_chk->conn.fd);
 	FREE(tcp_chk);
 	FREE(data);
 }
@@ -54,6 +57,8 @@ dump_tcp_check(void *data)
 	if (tcp_chk->bindto)
 		log_message(LOG_INFO, "   Bind to = %s", inet_ntop2(tcp_chk->bindto));
 	log_message(LOG_INFO, "   Connection timeout = %d", tcp_chk->connection_to/TIMER_HZ);
+	if (tcp_chk->persistent)
+		log_message(LOG_INFO, "   Persistent connection");
 }
 
 void
@@ -61,6 +66,8 @@ tcp_check_handler(vector strvec)
 {
 	tcp_checker *tcp_chk = (tcp_checker *) MALLOC(sizeof (tcp_checker));
 
+	tcp_chk->conn.fd = -1;
+
 	/* queue new checker */
 	queue_checker(free_tcp_check, dump_tcp_check, tcp_connect_thread,
 		      tcp_chk);
@@ -87,6 +94,13 @@ connect_timeout_handler(vector strvec)
 	tcp_chk->connection_to = CHECKER_VALUE_INT(strvec) * TIMER_HZ;
 }
 
+void
+tcp_persistent_handler(vector strvec)
+{
+	tcp_checker *tcp_chk = CHECKER_GET();
+	tcp_chk->persistent = 1;
+}
+
 void
 install_tcp_check_keyword(void)
 {
@@ -95,6 +109,7 @@ install_tcp_check_keyword(void)
 	install_keyword("connect_port", &connect_port_handler);
 	install_keyword("bindto", &bind_handler);
 	install_keyword("connect_timeout", &connect_timeout_handler);
+	install_keyword("persistent", &tcp_persistent_handler);
 	install_sublevel_end();
 }
 
@@ -119,7 +134,17 @@ tcp_check_thread(thread * thread_obj)
 	 * Otherwise we have a real connection error or connection timeout.
 	 */
 	if (status == connect_success) {
-		close(thread_obj->u.fd);
+		if (tcp_check->persistent) {
+			tcp_keepalive(thread_obj->u.fd,
+				      checker_obj->vs->delay_loop,
+				      tcp_check->connection_to);
+			tcp_check->conn.fd = thread_obj->u.fd;
+			tcp_check->since = TIMER_LONG(time_now);
+			thread_add_read(thread_obj->master, tcp_watch_thread,
+					checker_obj, thread_obj->u.fd,
+					checker_obj->vs->delay_loop);
+		} else
+			close(thread_obj->u.fd);
 
 		if (!svr_checker_up(checker_obj->id, checker_obj->rs)) {
 			log_message(LOG_INFO, "TCP connection to [%s:%d] success.",
@@ -149,10 +174,79 @@ tcp_check_thread(thread * thread_obj)
 
 	}
 
-	/* Register next timer checker */
-	if (status != connect_in_progress)
-		thread_add_timer(thread_obj->master, tcp_connect_thread, checker_obj,
-				 checker_obj->vs->delay_loop);
+	/* Register next timer checker, unless the connection is watched */
+	if (status == connect_in_progress ||
+	    (status == connect_success && tcp_check->persistent))
+		return 0;
+	thread_add_timer(thread_obj->master, tcp_connect_thread, checker_obj,
+			 checker_obj->vs->delay_loop);
+	return 0;
+}
+
+/*
+ * Persistent mode. The connection is kept open and nothing is sent on
+ * it : the kernel keepalive probes and TCP_USER_TIMEOUT turn a dead
+ * peer into a socket error, a stopped service closes the stream. Both
+ * wake this read thread up, delay_loop only paces its timeouts.
+ */
+int
+tcp_watch_thread(thread * thread_obj)
+{
+	checker *checker_obj = THREAD_ARG(thread_obj);
+	tcp_checker *tcp_check = CHECKER_ARG(checker_obj);
+	long delay_loop = checker_obj->vs->delay_loop;
+	uint16_t addr_port = CHECKER_RPORT(checker_obj);
+	char buf[512];
+	int r;
+
+	if (tcp_check->connection_port)
+		addr_port = tcp_check->connection_port;
+
+	if (thread_obj->type == THREAD_READ_TIMEOUT) {
+		if (CHECKER_ENABLED(checker_obj)) {
+			thread_add_read(thread_obj->master, tcp_watch_thread,
+					checker_obj, thread_obj->u.fd, delay_loop);
+			return 0;
+		}
+		/* Disabled, the connect thread loop takes over */
+		r = L4_EOF;
+	} else {
+		/* Whatever the server says is dropped, only the stream end matters */
+		r = l4_read(&tcp_check->conn, thread_obj, tcp_watch_thread,
+			    delay_loop, buf, sizeof (buf));
+		if (r == L4_AGAIN)
+			return 0;
+		if (r > 0) {
+			thread_add_read(thread_obj->master, tcp_watch_thread,
+					checker_obj, thread_obj->u.fd, delay_loop);
+			return 0;
+		}
+	}
+
+	if (r == L4_ERROR && svr_checker_up(checker_obj->id, checker_obj->rs)) {
+		log_message(LOG_INFO, "TCP connection to [%s:%d] lost : %s",
+		       inet_ntop2(CHECKER_RIP(checker_obj))
+		       , ntohs(addr_port)
+		       , strerror(errno));
+		smtp_alert(checker_obj->rs, NULL, NULL,
+			   "DOWN",
+			   "=> TCP CHECK failed on service <=");
+		update_svr_checker_state(DOWN, checker_obj->id
+					     , checker_obj->vs
+					     , checker_obj->rs);
+	}
+	close(thread_obj->u.fd);
+	tcp_check->conn.fd = -1;
+
+	/*
+	 * Reconnect right away, the new connection tells whether the
+	 * server is still there. One dropped as soon as opened waits for
+	 * delay_loop instead, not to loop on it.
+	 */
+	if (TIMER_LONG(time_now) - tcp_check->since >= delay_loop)
+		delay_loop = 0;
+	thread_add_timer(thread_obj->master, tcp_connect_thread, checker_obj,
+			 delay_loop);
 	return 0;
 }
 
@@ -175,7 +269,7 @@ tcp_connect_thread(thread * thread_obj)
 		return 0;
 	}
 
-	if ((fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) {
+	if ((fd = tcp_socket()) == -1) {
 		DBG("TCP connect fail to create socket.");
 		return 0;
 	}
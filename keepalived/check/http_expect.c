@@ -0,0 +1,280 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        HTTP body content matching. Expected strings and regexes
+ *              are searched incrementally as the body is read.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include <string.h>
+#include <syslog.h>
+#include "http_expect.h"
+#include "logger.h"
+#include "memory.h"
+
+static void
+free_expect_pattern(void *data)
+{
+	expect_pattern *pat = data;
+
+	if (pat->type == EXPECT_REGEX)
+		regfree(&pat->re);
+	FREE(pat->str);
+	FREE(pat);
+}
+
+static void
+dump_expect_pattern(void *data)
+{
+	expect_pattern *pat = data;
+
+	log_message(LOG_INFO, "           expect_%s = %s",
+	       (pat->type == EXPECT_REGEX) ? "regex" : "string", pat->str);
+}
+
+expect_set *
+alloc_expect_set(void)
+{
+	expect_set *set;
+
+	set = (expect_set *) MALLOC(sizeof (expect_set));
+	set->patterns = alloc_list(free_expect_pattern, dump_expect_pattern);
+	return set;
+}
+
+void
+free_expect_set(expect_set * set)
+{
+	if (!set)
+		return;
+	free_list(set->patterns);
+	if (set->go)
+		FREE(set->go);
+	if (set->out)
+		FREE(set->out);
+	if (set->line)
+		FREE(set->line);
+	FREE(set);
+}
+
+void
+dump_expect_set(expect_set * set)
+{
+	if (set)
+		dump_list(set->patterns);
+}
+
+/*
+ * (Re)build the string automaton. Node 0 is the root, goto transitions
+ * are completed with the failure links so that matching is a single
+ * table lookup per byte.
+ */
+static void
+expect_build(expect_set * set)
+{
+	expect_pattern *pat;
+	element e;
+	unsigned char *s;
+	int *fail, *queue;
+	int nodes = 1, size = 1;
+	int head = 0, tail = 0;
+	int c, n, r, cur;
+
+	for (e = LIST_HEAD(set->patterns); e; ELEMENT_NEXT(e)) {
+		pat = ELEMENT_DATA(e);
+		if (pat->type == EXPECT_STRING)
+			size += strlen(pat->str);
+	}
+
+	if (set->go)
+		FREE(set->go);
+	if (set->out)
+		FREE(set->out);
+	set->go = (int *) MALLOC(size * 256 * sizeof (int));
+	set->out = (unsigned int *) MALLOC(size * sizeof (unsigned int));
+	memset(set->go, 0xff, size * 256 * sizeof (int));
+
+	/* Trie of the strings */
+	for (e = LIST_HEAD(set->patterns); e; ELEMENT_NEXT(e)) {
+		pat = ELEMENT_DATA(e);
+		if (pat->type != EXPECT_STRING)
+			continue;
+		for (s = (unsigned char *) pat->str, cur = 0; *s; s++) {
+			if (set->go[cur * 256 + *s] < 0)
+				set->go[cur * 256 + *s] = nodes++;
+			cur = set->go[cur * 256 + *s];
+		}
+		set->out[cur] |= pat->bit;
+	}
+
+	/* Breadth first, failure links and missing transitions */
+	fail = (int *) MALLOC(nodes * sizeof (int));
+	queue = (int *) MALLOC(nodes * sizeof (int));
+	for (c = 0; c < 256; c++) {
+		n = set->go[c];
+		if (n < 0)
+			set->go[c] = 0;
+		else if (n) {
+			fail[n] = 0;
+			queue[tail++] = n;
+		}
+	}
+	while (head < tail) {
+		r = queue[head++];
+		for (c = 0; c < 256; c++) {
+			n = set->go[r * 256 + c];
+			if (n < 0) {
+				set->go[r * 256 + c] = set->go[fail[r] * 256 + c];
+				continue;
+			}
+			fail[n] = set->go[fail[r] * 256 + c];
+			set->out[n] |= set->out[fail[n]];
+			queue[tail++] = n;
+		}
+	}
+	FREE(fail);
+	FREE(queue);
+}
+
+/*
+ * Add a pattern, str is taken over. Returns -1 if it can't be used,
+ * it is then dropped.
+ */
+int
+expect_add(expect_set * set, int type, char *str)
+{
+	expect_pattern *pat;
+	int err;
+	char buf[128];
+
+	if (LIST_SIZE(set->patterns) >= EXPECT_MAX) {
+		log_message(LOG_INFO, "Too many expect patterns, %s ignored", str);
+		FREE(str);
+		return -1;
+	}
+	if (!*str) {
+		log_message(LOG_INFO, "Empty expect pattern ignored");
+		FREE(str);
+		return -1;
+	}
+
+	pat = (expect_pattern *) MALLOC(sizeof (expect_pattern));
+	pat->type = type;
+	pat->str = str;
+	if (type == EXPECT_REGEX) {
+		err = regcomp(&pat->re, str, REG_EXTENDED | REG_NOSUB);
+		if (err) {
+			regerror(err, &pat->re, buf, sizeof (buf));
+			log_message(LOG_INFO, "Bad expect_regex %s : %s, ignored",
+			       str, buf);
+			FREE(str);
+			FREE(pat);
+			return -1;
+		}
+		if (!set->line)
+			set->line = (char *) MALLOC(EXPECT_LINE_MAX);
+		set->regex++;
+	}
+
+	pat->bit = 1U << LIST_SIZE(set->patterns);
+	set->all |= pat->bit;
+	list_add(set->patterns, pat);
+	if (type == EXPECT_STRING)
+		expect_build(set);
+	return 0;
+}
+
+/* Forget the previous body */
+void
+expect_reset(expect_set * set)
+{
+	set->node = 0;
+	set->line_len = 0;
+	set->found = 0;
+}
+
+/* Match the gathered line against the regexes still expected */
+static void
+expect_line(expect_set * set)
+{
+	expect_pattern *pat;
+	element e;
+	int len = set->line_len;
+
+	if (len && set->line[len - 1] == '\r')
+		len--;
+	set->line[len] = '\0';
+	set->line_len = 0;
+
+	for (e = LIST_HEAD(set->patterns); e; ELEMENT_NEXT(e)) {
+		pat = ELEMENT_DATA(e);
+		if (pat->type == EXPECT_REGEX && !(set->found & pat->bit) &&
+		    !regexec(&pat->re, set->line, 0, NULL, 0))
+			set->found |= pat->bit;
+	}
+}
+
+/* Feed a body segment. Returns 1 once every pattern has been found */
+int
+expect_feed(expect_set * set, char *data, int len)
+{
+	unsigned char *s = (unsigned char *) data;
+	unsigned char *end = s + len;
+	int node = set->node;
+	char *nl;
+	int n;
+
+	if (EXPECT_DONE(set))
+		return 1;
+
+	if (set->go) {
+		for (; s < end; s++) {
+			node = set->go[node * 256 + *s];
+			set->found |= set->out[node];
+		}
+		set->node = node;
+	}
+
+	while (set->regex && len > 0 && !EXPECT_DONE(set)) {
+		nl = memchr(data, '\n', len);
+		n = nl ? nl - data : len;
+		if (n > EXPECT_LINE_MAX - 1 - set->line_len)
+			n = EXPECT_LINE_MAX - 1 - set->line_len;
+		memcpy(set->line + set->line_len, data, n);
+		set->line_len += n;
+		data += n;
+		len -= n;
+		if (nl == data) {
+			data++;
+			len--;
+			expect_line(set);
+		} else if (set->line_len == EXPECT_LINE_MAX - 1)
+			expect_line(set);
+	}
+
+	return EXPECT_DONE(set);
+}
+
+/* Body is complete, match the last unterminated line */
+int
+expect_eof(expect_set * set)
+{
+	if (set->regex && set->line_len && !EXPECT_DONE(set))
+		expect_line(set);
+	return EXPECT_DONE(set);
+}
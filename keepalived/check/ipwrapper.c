@@ -44,6 +44,59 @@ weigh_live_realservers(virtual_server * vs)
 	return count;
 }
 
+/* Stream a realserver or virtualserver quorum state to the VRRP child */
+static void
+ipc_svr_state(virtual_server * vs, real_server * rs)
+{
+	ipc_msg msg;
+
+	memset(&msg, 0, sizeof (ipc_msg));
+	msg.type = IPC_MSG_STATE;
+	if (vs->vsgname)
+		snprintf(msg.vs, IPC_KEY_LEN, "group:%s", vs->vsgname);
+	else if (vs->vfwmark)
+		snprintf(msg.vs, IPC_KEY_LEN, "fwmark:%u", vs->vfwmark);
+	else
+		snprintf(msg.vs, IPC_KEY_LEN, "%s:%d", inet_ntop2(SVR_IP(vs)),
+			 ntohs(SVR_PORT(vs)));
+
+	if (rs) {
+		snprintf(msg.rs, IPC_KEY_LEN, "%s:%d", inet_ntop2(SVR_IP(rs)),
+			 ntohs(SVR_PORT(rs)));
+		msg.up = ISALIVE(rs);
+	} else
+		msg.up = (vs->quorum_state == UP);
+
+	ipc_send(&msg);
+}
+
+/* Send every service state, on startup and on VRRP child request */
+void
+check_ipc_resync(void)
+{
+	element e, f;
+	virtual_server *vs;
+
+	if (LIST_ISEMPTY(check_data->vs))
+		return;
+
+	for (e = LIST_HEAD(check_data->vs); e; ELEMENT_NEXT(e)) {
+		vs = ELEMENT_DATA(e);
+		ipc_svr_state(vs, NULL);
+		if (LIST_ISEMPTY(vs->rs))
+			continue;
+		for (f = LIST_HEAD(vs->rs); f; ELEMENT_NEXT(f))
+			ipc_svr_state(vs, ELEMENT_DATA(f));
+	}
+}
+
+void
+check_ipc_handler(ipc_msg * msg)
+{
+	if (msg->type == IPC_MSG_RESYNC)
+		check_ipc_resync();
+}
+
 /* Remove a realserver IPVS rule */
 static int
 clear_service_rs(list vs_group, virtual_server * vs, list l)
@@ -286,6 +339,7 @@ perform_svr_state(int alive, virtual_server * vs, real_server * rs)
 			ipvs_cmd(LVS_CMD_ADD_DEST, check_data->vs_group, vs, rs);
 		}
 		rs->alive = alive;
+		ipc_svr_state(vs, rs);
 		if (rs->notify_up) {
 			log_message(LOG_INFO, "Executing [%s] for service [%s:%d]"
 			       " in VS [%s:%d]"
@@ -300,6 +354,7 @@ perform_svr_state(int alive, virtual_server * vs, real_server * rs)
 		if (vs->quorum_state == DOWN
 		  && weigh_live_realservers(vs) >= vs->quorum + vs->hysteresis) {
 			vs->quorum_state = UP;
+			ipc_svr_state(vs, NULL);
 			log_message(LOG_INFO, "Gained quorum %lu+%lu=%lu <= %u for VS [%s:%d]"
 				    , vs->quorum
 				    , vs->hysteresis
@@ -336,6 +391,7 @@ perform_svr_state(int alive, virtual_server * vs, real_server * rs)
 			ipvs_cmd(LVS_CMD_DEL_DEST, check_data->vs_group, vs, rs);
 		}
 		rs->alive = alive;
+		ipc_svr_state(vs, rs);
 		if (rs->notify_down) {
 			log_message(LOG_INFO, "Executing [%s] for service [%s:%d]"
 			       " in VS [%s:%d]"
@@ -353,6 +409,7 @@ perform_svr_state(int alive, virtual_server * vs, real_server * rs)
 		if (vs->quorum_state == UP
 		    && weigh_live_realservers(vs) < vs->quorum - vs->hysteresis) {
 			vs->quorum_state = DOWN;
+			ipc_svr_state(vs, NULL);
 			log_message(LOG_INFO, "Lost quorum %lu-%lu=%lu > %u for VS [%s:%d]"
 				    , vs->quorum
 				    , vs->hysteresis
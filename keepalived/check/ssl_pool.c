@@ -0,0 +1,319 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        SSL handshake worker pool. Handshakes are run by a few
+ *              threads, completions are signalled back to the scheduler
+ *              through an eventfd.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <syslog.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <openssl/err.h>
+#include "scheduler.h"
+#include "ssl_pool.h"
+#include "logger.h"
+#include "memory.h"
+
+/*
+ * Workers only run SSL_connect() on the job they own. They never log,
+ * allocate through MALLOC or touch the scheduler : all of these are
+ * left to ssl_pool_thread() once the job is back.
+ */
+static pthread_t pool_thread[SSL_POOL_MAX];
+static int pool_size = 0;
+static int pool_stopping = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static ssl_job *pool_queue = NULL;
+static ssl_job *pool_tail = NULL;
+static ssl_job *pool_done = NULL;
+static int done_fd = -1;	/* completions, read by the scheduler */
+static int stop_fd = -1;	/* never drained, wakes pending handshakes */
+
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+/* Older OpenSSL needs the application to provide its locking */
+static pthread_mutex_t *ssl_locks = NULL;
+
+static void
+ssl_lock_cb(int mode, int n, const char *file, int line)
+{
+	if (mode & CRYPTO_LOCK)
+		pthread_mutex_lock(&ssl_locks[n]);
+	else
+		pthread_mutex_unlock(&ssl_locks[n]);
+}
+
+static unsigned long
+ssl_id_cb(void)
+{
+	return (unsigned long) pthread_self();
+}
+
+static void
+ssl_locks_init(void)
+{
+	int i;
+
+	ssl_locks = (pthread_mutex_t *) MALLOC(CRYPTO_num_locks() *
+					       sizeof (pthread_mutex_t));
+	for (i = 0; i < CRYPTO_num_locks(); i++)
+		pthread_mutex_init(&ssl_locks[i], NULL);
+	CRYPTO_set_id_callback(ssl_id_cb);
+	CRYPTO_set_locking_callback(ssl_lock_cb);
+}
+
+static void
+ssl_locks_free(void)
+{
+	int i;
+
+	CRYPTO_set_locking_callback(NULL);
+	CRYPTO_set_id_callback(NULL);
+	for (i = 0; i < CRYPTO_num_locks(); i++)
+		pthread_mutex_destroy(&ssl_locks[i]);
+	FREE(ssl_locks);
+	ssl_locks = NULL;
+}
+#endif
+
+static long
+ssl_pool_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * TIMER_HZ + ts.tv_nsec / 1000;
+}
+
+/* Non blocking handshake, polled until done, timed out or aborted */
+static void
+ssl_pool_handshake(ssl_job * job)
+{
+	long deadline = ssl_pool_clock() + job->timeout;
+	struct pollfd pfd[2];
+	long left;
+
+	while (1) {
+		ERR_clear_error();
+		job->ret = SSL_connect(job->ssl);
+		if (job->ret == 1) {
+			job->error = SSL_ERROR_NONE;
+			break;
+		}
+
+		job->error = SSL_get_error(job->ssl, job->ret);
+		if (job->error != SSL_ERROR_WANT_READ &&
+		    job->error != SSL_ERROR_WANT_WRITE)
+			break;
+
+		left = deadline - ssl_pool_clock();
+		if (left <= 0) {
+			job->timedout = 1;
+			break;
+		}
+
+		pfd[0].fd = job->fd;
+		pfd[0].events = (job->error == SSL_ERROR_WANT_READ) ? POLLIN : POLLOUT;
+		pfd[1].fd = stop_fd;
+		pfd[1].events = POLLIN;
+		if (poll(pfd, 2, (left + 999) / 1000) < 0 && errno != EINTR)
+			break;
+		if (pfd[1].revents)
+			break;
+	}
+
+	/* Error strings are per thread, ours would never be read */
+	ERR_clear_error();
+}
+
+static void *
+ssl_pool_worker(void *arg)
+{
+	uint64_t one = 1;
+	ssl_job *job;
+
+	while (1) {
+		pthread_mutex_lock(&pool_lock);
+		while (!pool_queue && !pool_stopping)
+			pthread_cond_wait(&pool_cond, &pool_lock);
+		if (pool_stopping) {
+			pthread_mutex_unlock(&pool_lock);
+			break;
+		}
+		job = pool_queue;
+		pool_queue = job->next;
+		if (!pool_queue)
+			pool_tail = NULL;
+		pthread_mutex_unlock(&pool_lock);
+
+		ssl_pool_handshake(job);
+
+		pthread_mutex_lock(&pool_lock);
+		job->next = pool_done;
+		pool_done = job;
+		pthread_mutex_unlock(&pool_lock);
+		/* Can only fail on overflow, the scheduler is woken anyway */
+		if (write(done_fd, &one, sizeof (one)) < 0)
+			continue;
+	}
+
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+	OPENSSL_thread_stop();
+#endif
+	return NULL;
+}
+
+/* Scheduler side, hand finished jobs back to their owners */
+static int
+ssl_pool_thread(thread * thread_obj)
+{
+	ssl_job *job, *next;
+	uint64_t count;
+
+	if (thread_obj->type != THREAD_READ_TIMEOUT &&
+	    read(done_fd, &count, sizeof (count)) == sizeof (count)) {
+		pthread_mutex_lock(&pool_lock);
+		job = pool_done;
+		pool_done = NULL;
+		pthread_mutex_unlock(&pool_lock);
+
+		for (; job; job = next) {
+			next = job->next;
+			job->next = NULL;
+			job->state = SSL_JOB_DONE;
+			(*job->done) (job);
+		}
+	}
+
+	thread_add_read(master, ssl_pool_thread, NULL, done_fd, SSL_POOL_TIMER);
+	return 0;
+}
+
+void
+ssl_pool_submit(ssl_job * job)
+{
+	job->next = NULL;
+	job->state = SSL_JOB_QUEUED;
+	job->timedout = 0;
+
+	pthread_mutex_lock(&pool_lock);
+	if (pool_tail)
+		pool_tail->next = job;
+	else
+		pool_queue = job;
+	pool_tail = job;
+	pthread_cond_signal(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+int
+ssl_pool_size(void)
+{
+	return pool_size;
+}
+
+/*
+ * Start workers on the current master thread. Signals are blocked
+ * while they are spawned so that they are all delivered to the
+ * scheduler.
+ */
+int
+ssl_pool_start(int workers)
+{
+	sigset_t all, old;
+	int i;
+
+	if (workers > SSL_POOL_MAX)
+		workers = SSL_POOL_MAX;
+	if (workers <= 0 || pool_size)
+		return 0;
+
+	done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (done_fd < 0 || stop_fd < 0) {
+		log_message(LOG_INFO, "SSL pool: can't create eventfd (%m)");
+		ssl_pool_stop();
+		return -1;
+	}
+
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+	ssl_locks_init();
+#endif
+	pool_stopping = 0;
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (i = 0; i < workers; i++) {
+		if (pthread_create(&pool_thread[i], NULL, ssl_pool_worker, NULL))
+			break;
+		pool_size++;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (!pool_size) {
+		log_message(LOG_INFO, "SSL pool: can't start workers");
+		ssl_pool_stop();
+		return -1;
+	}
+
+	thread_add_read(master, ssl_pool_thread, NULL, done_fd, SSL_POOL_TIMER);
+	log_message(LOG_INFO, "SSL pool: %d handshake workers", pool_size);
+	return 0;
+}
+
+/*
+ * Abort pending handshakes and join the workers. Queued and finished
+ * jobs are dropped : their owners are about to be released.
+ */
+void
+ssl_pool_stop(void)
+{
+	uint64_t one = 1;
+	int i;
+
+	pthread_mutex_lock(&pool_lock);
+	pool_stopping = 1;
+	pthread_cond_broadcast(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+	if (stop_fd >= 0 && write(stop_fd, &one, sizeof (one)) < 0)
+		log_message(LOG_INFO, "SSL pool: can't wake workers (%m)");
+
+	for (i = 0; i < pool_size; i++)
+		pthread_join(pool_thread[i], NULL);
+
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+	if (ssl_locks)
+		ssl_locks_free();
+#endif
+	if (done_fd >= 0)
+		close(done_fd);
+	if (stop_fd >= 0)
+		close(stop_fd);
+	done_fd = stop_fd = -1;
+	pool_queue = pool_tail = pool_done = NULL;
+	pool_size = 0;
+	pool_stopping = 0;
+}
@@ -86,6 +86,12 @@ set_default_smtp_connection_timeout(conf_data * conf_data_obj)
 	conf_data_obj->smtp_connection_to = DEFAULT_SMTP_CONNECTION_TIMEOUT;
 }
 
+static void
+set_default_netlink_rcvbuf(conf_data * conf_data_obj)
+{
+	conf_data_obj->netlink_rcvbuf = DEFAULT_NETLINK_RCVBUF;
+}
+
 static void
 set_default_values(conf_data * conf_data_obj)
 {
@@ -96,6 +102,7 @@ set_default_values(conf_data * conf_data_obj)
 	set_default_smtp_server(conf_data_obj);
 	set_default_smtp_connection_timeout(conf_data_obj);
 	set_default_email_from(conf_data_obj);
+	set_default_netlink_rcvbuf(conf_data_obj);
 }
 
 /* email facility functions */
@@ -123,6 +130,32 @@ alloc_email(char *addr)
 	list_add(data->email, new);
 }
 
+/* VRRP CPU affinity facility functions */
+static void
+free_cpu(void *data_obj)
+{
+	FREE(data_obj);
+}
+static void
+dump_cpu(void *data_obj)
+{
+	int *cpu = data_obj;
+	log_message(LOG_INFO, " VRRP CPU affinity = %d", *cpu);
+}
+
+void
+alloc_cpu_affinity(int cpu)
+{
+	int *new;
+
+	if (!data->vrrp_cpu_affinity)
+		data->vrrp_cpu_affinity = alloc_list(free_cpu, dump_cpu);
+
+	new = (int *) MALLOC(sizeof (int));
+	*new = cpu;
+	list_add(data->vrrp_cpu_affinity, new);
+}
+
 /* data facility functions */
 conf_data *
 alloc_global_data(void)
@@ -139,11 +172,13 @@ alloc_global_data(void)
 void
 free_global_data(conf_data * global_data)
 {
-	free_list(data->email);
-	FREE_PTR(data->router_id);
-	FREE_PTR(data->plugin_dir);
-	FREE_PTR(data->email_from);
-	FREE(data);
+	free_list(global_data->email);
+	free_list(global_data->vrrp_cpu_affinity);
+	FREE_PTR(global_data->router_id);
+	FREE_PTR(global_data->plugin_dir);
+	FREE_PTR(global_data->track_shm_file);
+	FREE_PTR(global_data->email_from);
+	FREE(global_data);
 }
 
 void
@@ -171,4 +206,16 @@ dump_global_data(conf_data * global_data)
 		       data->email_from);
 		dump_list(data->email);
 	}
+	if (data->vrrp_rt_priority)
+		log_message(LOG_INFO, " VRRP realtime priority = %d",
+		       data->vrrp_rt_priority);
+	if (data->vrrp_no_swap)
+		log_message(LOG_INFO, " VRRP memory locked");
+	if (!LIST_ISEMPTY(data->vrrp_cpu_affinity))
+		dump_list(data->vrrp_cpu_affinity);
+	if (data->netlink_rcvbuf)
+		log_message(LOG_INFO, " Netlink reflector receive buffer = %d",
+		       data->netlink_rcvbuf);
+	if (data->track_shm_file)
+		log_message(LOG_INFO, " Tracking feed = %s", data->track_shm_file);
 }
@@ -28,6 +28,7 @@
 #include "parser.h"
 #include "memory.h"
 #include "utils.h"
+#include "logger.h"
 
 /* data handlers */
 /* Global def handlers */
@@ -64,6 +65,42 @@ smtpip_handler(vector strvec)
 	inet_ston(VECTOR_SLOT(strvec, 1), &data->smtp_server);
 }
 static void
+netlink_rcvbuf_handler(vector strvec)
+{
+	data->netlink_rcvbuf = atoi(VECTOR_SLOT(strvec, 1));
+}
+static void
+vrrp_rt_priority_handler(vector strvec)
+{
+	int priority = atoi(VECTOR_SLOT(strvec, 1));
+
+	if (priority < 1 || priority > 99) {
+		log_message(LOG_INFO, "vrrp_rt_priority %d out of range [1-99]",
+		       priority);
+		return;
+	}
+	data->vrrp_rt_priority = priority;
+}
+static void
+vrrp_no_swap_handler(vector strvec)
+{
+	data->vrrp_no_swap = 1;
+}
+static void
+track_shm_file_handler(vector strvec)
+{
+	FREE_PTR(data->track_shm_file);
+	data->track_shm_file = set_value(strvec);
+}
+static void
+vrrp_cpu_affinity_handler(vector strvec)
+{
+	int i;
+
+	for (i = 1; i < VECTOR_SIZE(strvec); i++)
+		alloc_cpu_affinity(atoi(VECTOR_SLOT(strvec, i)));
+}
+static void
 email_handler(vector strvec)
 {
 	vector email_vec = read_value_block();
@@ -90,4 +127,9 @@ global_init_keywords(void)
 	install_keyword("smtp_server", &smtpip_handler);
 	install_keyword("smtp_connect_timeout", &smtpto_handler);
 	install_keyword("notification_email", &email_handler);
+	install_keyword("netlink_rcvbuf", &netlink_rcvbuf_handler);
+	install_keyword("vrrp_rt_priority", &vrrp_rt_priority_handler);
+	install_keyword("vrrp_no_swap", &vrrp_no_swap_handler);
+	install_keyword("vrrp_cpu_affinity", &vrrp_cpu_affinity_handler);
+	install_keyword("track_shm_file", &track_shm_file_handler);
 }
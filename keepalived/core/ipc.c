@@ -0,0 +1,168 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Healthcheck to VRRP child channel. A datagram socketpair
+ *              created by the parent, kept open there so that respawned
+ *              children find it back.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include "ipc.h"
+#include "scheduler.h"
+#include "logger.h"
+
+/* Local vars */
+static int ipc_pair[2] = { -1, -1 };
+static int ipc_fd = -1;
+static void (*ipc_handler) (ipc_msg *);
+static void (*ipc_resync) (void);
+
+/* Records are batched until the end of the scheduler loop */
+static ipc_msg ipc_out[IPC_BATCH];
+static int ipc_out_count;
+static int ipc_flush_pending;
+static int ipc_retry_pending;
+static ipc_msg ipc_in[IPC_BATCH];
+
+/* Parent side, before the children are forked */
+void
+ipc_init(void)
+{
+	int i;
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, ipc_pair) < 0) {
+		log_message(LOG_INFO, "IPC: can't create socketpair (%m)");
+		ipc_pair[0] = ipc_pair[1] = -1;
+		return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		fcntl(ipc_pair[i], F_SETFL, O_NONBLOCK | fcntl(ipc_pair[i], F_GETFL));
+		fcntl(ipc_pair[i], F_SETFD, FD_CLOEXEC);
+	}
+}
+
+static int
+ipc_retry_thread(thread * thread_obj)
+{
+	ipc_retry_pending = 0;
+	if (ipc_resync)
+		(*ipc_resync) ();
+	return 0;
+}
+
+static void
+ipc_flush(void)
+{
+	size_t len = ipc_out_count * sizeof (ipc_msg);
+
+	if (!ipc_out_count)
+		return;
+	ipc_out_count = 0;
+
+	if (send(ipc_fd, ipc_out, len, 0) == len)
+		return;
+
+	/* Peer not there or lagging : state is resent as a whole later */
+	if (!ipc_retry_pending) {
+		log_message(LOG_INFO, "IPC: send failed (%m), resync scheduled");
+		ipc_retry_pending = 1;
+		thread_add_timer(master, ipc_retry_thread, NULL, IPC_RETRY);
+	}
+}
+
+static int
+ipc_flush_thread(thread * thread_obj)
+{
+	ipc_flush_pending = 0;
+	ipc_flush();
+	return 0;
+}
+
+void
+ipc_send(ipc_msg * msg)
+{
+	if (ipc_fd < 0)
+		return;
+
+	memcpy(&ipc_out[ipc_out_count++], msg, sizeof (ipc_msg));
+	if (ipc_out_count == IPC_BATCH) {
+		ipc_flush();
+		return;
+	}
+
+	if (!ipc_flush_pending) {
+		ipc_flush_pending = 1;
+		thread_add_event(master, ipc_flush_thread, NULL, 0);
+	}
+}
+
+static int
+ipc_read_thread(thread * thread_obj)
+{
+	ssize_t len;
+	int i;
+
+	if (thread_obj->type != THREAD_READ_TIMEOUT) {
+		while ((len = recv(ipc_fd, ipc_in, sizeof (ipc_in), 0)) > 0)
+			for (i = 0; i < len / sizeof (ipc_msg); i++)
+				(*ipc_handler) (&ipc_in[i]);
+	}
+
+	thread_add_read(master, ipc_read_thread, NULL, ipc_fd, IPC_TIMER);
+	return 0;
+}
+
+/*
+ * Child side. Keep our end of the channel and start reading it.
+ * Called again on reload, once the master thread was rebuilt.
+ */
+void
+ipc_open(int side, void (*handler) (ipc_msg *), void (*resync) (void))
+{
+	if (ipc_pair[!side] >= 0) {
+		close(ipc_pair[!side]);
+		ipc_pair[!side] = -1;
+	}
+
+	ipc_fd = ipc_pair[side];
+	ipc_handler = handler;
+	ipc_resync = resync;
+	ipc_out_count = 0;
+	ipc_flush_pending = 0;
+	ipc_retry_pending = 0;
+	if (ipc_fd < 0)
+		return;
+
+	thread_add_read(master, ipc_read_thread, NULL, ipc_fd, IPC_TIMER);
+}
+
+void
+ipc_close(void)
+{
+	if (ipc_fd >= 0)
+		close(ipc_fd);
+	ipc_fd = -1;
+	ipc_pair[0] = ipc_pair[1] = -1;
+}
@@ -21,10 +21,19 @@
  * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
  */
 
+#include <openssl/err.h>
 #include "layer4.h"
 #include "check_api.h"
 #include "utils.h"
 
+/* Checker socket, non blocking and close on exec from the start */
+int
+tcp_socket(void)
+{
+	return socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		      IPPROTO_TCP);
+}
+
 enum connect_result
 tcp_bind_connect(int fd, uint32_t addr_ip, uint16_t addr_port, uint32_t bind_ip)
 {
@@ -32,7 +41,6 @@ tcp_bind_connect(int fd, uint32_t addr_ip, uint16_t addr_port, uint32_t bind_ip)
 	int long_inet;
 	struct sockaddr_in sa_in;
 	int ret;
-	int val;
 
 	/* free the tcp port after closing the socket descriptor */
 	li.l_onoff = 1;
@@ -40,10 +48,6 @@ tcp_bind_connect(int fd, uint32_t addr_ip, uint16_t addr_port, uint32_t bind_ip)
 	setsockopt(fd, SOL_SOCKET, SO_LINGER, (char *) &li,
 		   sizeof (struct linger));
 
-	/* Make socket non-block. */
-	val = fcntl(fd, F_GETFL, 0);
-	fcntl(fd, F_SETFL, val | O_NONBLOCK);
-
 	/* Bind socket */
 	long_inet = sizeof (struct sockaddr_in);
 	memset(&sa_in, 0, long_inet);
@@ -64,10 +68,8 @@ tcp_bind_connect(int fd, uint32_t addr_ip, uint16_t addr_port, uint32_t bind_ip)
 	ret = connect(fd, (struct sockaddr *) &sa_in, long_inet);
 
 	/* Immediate success */
-	if (ret == 0) {
-		fcntl(fd, F_SETFL, val);
+	if (ret == 0)
 		return connect_success;
-	}
 
 	/* If connect is in progress then return 1 else it's real error. */
 	if (ret < 0) {
@@ -75,11 +77,35 @@ tcp_bind_connect(int fd, uint32_t addr_ip, uint16_t addr_port, uint32_t bind_ip)
 			return connect_error;
 	}
 
-	/* restore previous fd args */
-	fcntl(fd, F_SETFL, val);
 	return connect_in_progress;
 }
 
+/*
+ * Have the kernel watch an idle connection. Keepalive probes start
+ * after idle and go every second, a peer silent for timeout more makes
+ * the connection fail with ETIMEDOUT. Unacknowledged data give up at
+ * the same deadline. Both are in TIMER_HZ units.
+ */
+void
+tcp_keepalive(int fd, long idle, long timeout)
+{
+	unsigned int ms = (idle + timeout) / (TIMER_HZ / 1000);
+	int val = 1;
+
+	setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &val, sizeof (val));
+	val = idle / TIMER_HZ;
+	val = (val < 1) ? 1 : (val > 32767) ? 32767 : val;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &val, sizeof (val));
+	val = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &val, sizeof (val));
+	val = timeout / TIMER_HZ;
+	val = (val < 1) ? 1 : (val > 127) ? 127 : val;
+	setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &val, sizeof (val));
+#ifdef TCP_USER_TIMEOUT
+	setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &ms, sizeof (ms));
+#endif
+}
+
 enum connect_result
 tcp_connect(int fd, uint32_t addr_ip, uint16_t addr_port)
 {
@@ -174,3 +200,97 @@ tcp_connection_state(int fd, enum connect_result status, thread * thread_obj,
 		break;
 	}
 }
+
+/*
+ * Register func for the direction the transport waits for. TLS may
+ * need to write while reading and the other way around.
+ */
+static int
+l4_again(l4_conn * conn, thread * thread_obj, int (*func) (struct _thread *)
+	 , long timeout, int want_write)
+{
+	if (want_write)
+		thread_add_write(thread_obj->master, func, THREAD_ARG(thread_obj)
+				 , conn->fd, timeout);
+	else
+		thread_add_read(thread_obj->master, func, THREAD_ARG(thread_obj)
+				, conn->fd, timeout);
+	return L4_AGAIN;
+}
+
+/*
+ * Read at most len bytes. Returns the byte count, L4_EOF when the peer
+ * closed the stream and L4_ERROR on failure. When nothing can be read
+ * yet, func is registered back with timeout and L4_AGAIN is returned.
+ */
+int
+l4_read(l4_conn * conn, thread * thread_obj, int (*func) (struct _thread *)
+	, long timeout, char *buf, int len)
+{
+	int r;
+
+	if (!conn->ssl) {
+		r = read(conn->fd, buf, len);
+		if (r == -1 && (errno == EAGAIN || errno == EINTR))
+			return l4_again(conn, thread_obj, func, timeout, 0);
+		return (r < 0) ? L4_ERROR : r;
+	}
+
+	ERR_clear_error();
+	r = SSL_read(conn->ssl, buf, len);
+	conn->error = SSL_get_error(conn->ssl, r);
+	switch (conn->error) {
+	case SSL_ERROR_NONE:
+		return r;
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		return l4_again(conn, thread_obj, func, timeout,
+				conn->error == SSL_ERROR_WANT_WRITE);
+	case SSL_ERROR_ZERO_RETURN:
+		return L4_EOF;
+	default:
+		return L4_ERROR;
+	}
+}
+
+/*
+ * Write the len bytes of buf. A short write is remembered in conn and
+ * func registered back with timeout, the next call with the same
+ * buffer goes on where this one stopped and L4_AGAIN is returned
+ * meanwhile. Returns len once everything is out, L4_ERROR on failure.
+ */
+int
+l4_write(l4_conn * conn, thread * thread_obj, int (*func) (struct _thread *)
+	 , long timeout, char *buf, int len)
+{
+	int w;
+
+	if (!conn->ssl) {
+		w = send(conn->fd, buf + conn->sent, len - conn->sent,
+			 MSG_NOSIGNAL);
+		if (w == -1 && (errno == EAGAIN || errno == EINTR))
+			return l4_again(conn, thread_obj, func, timeout, 1);
+	} else {
+		/* Without partial writes, TLS records go out whole */
+		ERR_clear_error();
+		w = SSL_write(conn->ssl, buf + conn->sent, len - conn->sent);
+		conn->error = SSL_get_error(conn->ssl, w);
+		if (conn->error == SSL_ERROR_WANT_READ ||
+		    conn->error == SSL_ERROR_WANT_WRITE)
+			return l4_again(conn, thread_obj, func, timeout,
+					conn->error == SSL_ERROR_WANT_WRITE);
+		if (conn->error != SSL_ERROR_NONE)
+			w = -1;
+	}
+
+	if (w <= 0) {
+		conn->sent = 0;
+		return L4_ERROR;
+	}
+
+	conn->sent += w;
+	if (conn->sent < len)
+		return l4_again(conn, thread_obj, func, timeout, 1);
+	conn->sent = 0;
+	return len;
+}
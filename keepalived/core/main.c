@@ -25,6 +25,8 @@
 #include "signals.h"
 #include "pidfile.h"
 #include "logger.h"
+#include "ipc.h"
+#include "watchdog.h"
 
 /* global var */
 char *conf_file = NULL;		/* Configuration file */
@@ -71,6 +73,12 @@ stop_keepalived(void)
 static void
 start_keepalived(void)
 {
+#if defined _WITH_LVS_ && defined _WITH_VRRP_
+	/* Healthcheck to VRRP channel, when running both */
+	if ((daemon_mode & 3) == 3 || !daemon_mode)
+		ipc_init();
+#endif
+
 #ifdef _WITH_LVS_
 	/* start healthchecker child */
 	if (daemon_mode & 2 || !daemon_mode)
@@ -97,6 +105,16 @@ sighup(void *v, int sig)
 		kill(checkers_child, SIGHUP);
 }
 
+/* SIGUSR2 handler, children dump their statistics */
+void
+sigusr2(void *v, int sig)
+{
+	if (vrrp_child > 0)
+		kill(vrrp_child, SIGUSR2);
+	if (checkers_child > 0)
+		kill(checkers_child, SIGUSR2);
+}
+
 /* Terminate handler */
 void
 sigend(void *v, int sig)
@@ -125,6 +143,7 @@ signal_init(void)
 	signal_set(SIGHUP, sighup, NULL);
 	signal_set(SIGINT, sigend, NULL);
 	signal_set(SIGTERM, sigend, NULL);
+	signal_set(SIGUSR2, sigusr2, NULL);
 	signal_ignore(SIGPIPE);
 }
 
@@ -158,9 +177,10 @@ usage(const char *prog)
 		"  %s --version            -v    Display the version number\n"
 		"  %s --pid                -p    pidfile\n"
 		"  %s --checkers_pid       -c    checkers pidfile\n"
-		"  %s --vrrp_pid           -r    vrrp pidfile\n",
+		"  %s --vrrp_pid           -r    vrrp pidfile\n"
+		"  %s --watchdog           -W    Restart a child missing its heartbeat for this many ms.\n",
 		prog, prog, prog, prog, prog, prog, prog, prog,
-		prog, prog, prog, prog, prog, prog, prog);
+		prog, prog, prog, prog, prog, prog, prog, prog);
 }
 
 /* Command line parser */
@@ -187,6 +207,7 @@ parse_cmdline(int argc, char **argv)
 		{"pid", 'p', POPT_ARG_STRING, &option_arg, 'p'},
 		{"checkers_pid", 'c', POPT_ARG_STRING, &option_arg, 'c'},
 		{"vrrp_pid", 'r', POPT_ARG_STRING, &option_arg, 'r'},
+		{"watchdog", 'W', POPT_ARG_STRING, &option_arg, 'W'},
 		{NULL, 0, 0, NULL, 0}
 	};
 
@@ -245,6 +266,9 @@ parse_cmdline(int argc, char **argv)
 	case 'r':
 		vrrp_pidfile = option_arg;
 		break;
+	case 'W':
+		wdog_timer = atoi(option_arg) * (TIMER_HZ / 1000);
+		break;
 	}
 
 	/* the others */
@@ -290,6 +314,9 @@ parse_cmdline(int argc, char **argv)
 		case 'r':
 			vrrp_pidfile = option_arg;
 			break;
+		case 'W':
+			wdog_timer = atoi(option_arg) * (TIMER_HZ / 1000);
+			break;
 		}
 	}
 
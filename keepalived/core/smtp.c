@@ -533,8 +533,7 @@ smtp_connect(smtp_thread_arg * smtp_arg)
 {
 	enum connect_result status;
 
-	if ((smtp_arg->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP))
-	    == -1) {
+	if ((smtp_arg->fd = tcp_socket()) == -1) {
 		DBG("SMTP connect fail to create socket.");
 		free_smtp_all(smtp_arg);
 		return;
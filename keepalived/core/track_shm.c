@@ -0,0 +1,252 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Shared memory tracking feed. Status pushed by an external
+ *              process through a memory mapped file of fixed-size slots.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "track_shm.h"
+#include "logger.h"
+#include "memory.h"
+
+/* Retries on a slot being written before giving up this round */
+#define TRACK_SHM_RETRY	8
+
+/* Local vars */
+static track_shm_hdr *shm_hdr = NULL;
+static track_shm_slot *shm_slot = NULL;
+static size_t shm_size = 0;
+static uint32_t shm_nslots = 0;
+static char *shm_path = NULL;
+static int shm_lost = 0;	/* mapping dropped, retried on read */
+
+/* A feed shrunk under the mapping faults on access */
+static sigjmp_buf shm_jmp;
+static volatile sig_atomic_t shm_reading = 0;
+
+static void
+track_shm_sigbus(int sig)
+{
+	if (shm_reading)
+		siglongjmp(shm_jmp, 1);
+
+	/* Not ours, die as if we were not there */
+	signal(SIGBUS, SIG_DFL);
+	raise(SIGBUS);
+}
+
+static void
+track_shm_unmap(void)
+{
+	if (shm_hdr)
+		munmap(shm_hdr, shm_size);
+	shm_hdr = NULL;
+	shm_slot = NULL;
+	shm_size = 0;
+	shm_nslots = 0;
+}
+
+void
+track_shm_close(void)
+{
+	track_shm_unmap();
+	FREE_PTR(shm_path);
+	shm_path = NULL;
+	shm_lost = 0;
+}
+
+/* Map shm_path at its current size, errors are only logged if report */
+static int
+track_shm_map(int report)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(shm_path, O_RDONLY);
+	if (fd < 0) {
+		if (report)
+			log_message(LOG_INFO, "Tracking feed %s: can't open (%m)",
+			       shm_path);
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof (track_shm_hdr)) {
+		if (report)
+			log_message(LOG_INFO, "Tracking feed %s: bad size",
+			       shm_path);
+		close(fd);
+		return -1;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		if (report)
+			log_message(LOG_INFO, "Tracking feed %s: can't map (%m)",
+			       shm_path);
+		return -1;
+	}
+
+	shm_hdr = map;
+	shm_size = st.st_size;
+	if (shm_hdr->magic != TRACK_SHM_MAGIC ||
+	    shm_hdr->version != TRACK_SHM_VERSION ||
+	    shm_hdr->nslots > (shm_size - sizeof (track_shm_hdr)) /
+			      sizeof (track_shm_slot)) {
+		if (report)
+			log_message(LOG_INFO, "Tracking feed %s: bad header",
+			       shm_path);
+		track_shm_unmap();
+		return -1;
+	}
+	shm_slot = (track_shm_slot *) (shm_hdr + 1);
+	shm_nslots = shm_hdr->nslots;
+
+	log_message(LOG_INFO, "Tracking feed %s: %u slots", shm_path,
+	       shm_nslots);
+	return 0;
+}
+
+/* Map the feed, replacing any previous mapping */
+int
+track_shm_open(char *path)
+{
+	struct sigaction sa;
+
+	track_shm_close();
+
+	memset(&sa, 0, sizeof (sa));
+	sa.sa_handler = track_shm_sigbus;
+	sa.sa_flags = SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGBUS, &sa, NULL);
+
+	shm_path = (char *) MALLOC(strlen(path) + 1);
+	strcpy(shm_path, path);
+	if (track_shm_map(1) < 0) {
+		shm_lost = 1;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * The header no longer matches the mapping or the mapping faulted :
+ * map the feed again as it is now. A failure is reported once until
+ * the feed comes back.
+ */
+static int
+track_shm_remap(void)
+{
+	track_shm_unmap();
+	if (track_shm_map(!shm_lost) < 0) {
+		shm_lost = 1;
+		return -1;
+	}
+	shm_lost = 0;
+	return 0;
+}
+
+static int
+track_shm_match(int index, char *name)
+{
+	return index >= 0 && index < shm_nslots &&
+	       !strncmp(shm_slot[index].name, name, TRACK_SHM_NAMELEN);
+}
+
+static int
+track_shm_lookup(char *name, int *index, track_shm_value *val)
+{
+	track_shm_slot *slot;
+	uint32_t gen;
+	int i;
+
+	if (!track_shm_match(*index, name)) {
+		for (i = 0; i < shm_nslots; i++)
+			if (track_shm_match(i, name))
+				break;
+		if (i == shm_nslots) {
+			*index = -1;
+			return -1;
+		}
+		*index = i;
+	}
+
+	slot = &shm_slot[*index];
+	for (i = 0; i < TRACK_SHM_RETRY; i++) {
+		gen = slot->generation;
+		if (gen & 1)
+			continue;
+		__sync_synchronize();
+		val->status = slot->status;
+		val->weight = slot->weight;
+		__sync_synchronize();
+		if (slot->generation == gen) {
+			val->generation = gen;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Read slot by name. index caches the slot position between calls
+ * and is refreshed if the writer moved the slot. Returns 0 when a
+ * consistent value was read, -1 if the slot is missing or was busy.
+ */
+int
+track_shm_read(char *name, int *index, track_shm_value *val)
+{
+	int ret;
+
+	if (!shm_path || (!shm_slot && track_shm_remap() < 0))
+		return -1;
+
+	if (sigsetjmp(shm_jmp, 0)) {
+		shm_reading = 0;
+		log_message(LOG_INFO, "Tracking feed %s: shrunk while mapped",
+		       shm_path);
+		track_shm_unmap();
+		shm_lost = 1;
+		return -1;
+	}
+	shm_reading = 1;
+
+	/* Header rewritten, the feed may have been resized */
+	if (shm_hdr->magic != TRACK_SHM_MAGIC ||
+	    shm_hdr->nslots != shm_nslots) {
+		shm_reading = 0;
+		if (track_shm_remap() < 0)
+			return -1;
+		shm_reading = 1;
+	}
+
+	ret = track_shm_lookup(name, index, val);
+	shm_reading = 0;
+	return ret;
+}
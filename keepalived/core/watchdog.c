@@ -0,0 +1,184 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Parent/child heartbeat watchdog. Each child writes to a
+ *              pipe from its scheduler loop, the parent kills a child
+ *              whose loop stopped turning so that it gets respawned.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <syslog.h>
+#include "watchdog.h"
+#include "scheduler.h"
+#include "logger.h"
+
+/* global var */
+unsigned long wdog_timer = 0;
+
+/* Parent side, one pipe per child */
+static char *wdog_name[2] = { "Healthcheck", "VRRP" };
+static int wdog_pipe[2][2] = { {-1, -1}, {-1, -1} };
+static pid_t wdog_pid[2] = { -1, -1 };
+static thread *wdog_thread[2] = { NULL, NULL };
+
+/* Child side */
+static int wdog_fd = -1;
+
+static void
+wdog_reset(int side)
+{
+	if (wdog_thread[side])
+		thread_cancel(wdog_thread[side]);
+	wdog_thread[side] = NULL;
+	if (wdog_pipe[side][0] >= 0)
+		close(wdog_pipe[side][0]);
+	if (wdog_pipe[side][1] >= 0)
+		close(wdog_pipe[side][1]);
+	wdog_pipe[side][0] = wdog_pipe[side][1] = -1;
+}
+
+/* Parent side, before forking a child */
+void
+wdog_prefork(int side)
+{
+	int i;
+
+	wdog_reset(side);
+	if (!wdog_timer)
+		return;
+
+	if (pipe(wdog_pipe[side]) < 0) {
+		log_message(LOG_INFO, "Watchdog: can't create %s pipe (%m)",
+			    wdog_name[side]);
+		wdog_pipe[side][0] = wdog_pipe[side][1] = -1;
+		return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		fcntl(wdog_pipe[side][i], F_SETFL,
+		      O_NONBLOCK | fcntl(wdog_pipe[side][i], F_GETFL));
+		fcntl(wdog_pipe[side][i], F_SETFD, FD_CLOEXEC);
+	}
+}
+
+static int
+wdog_read_thread(thread * thread_obj)
+{
+	int fd = THREAD_FD(thread_obj);
+	int side = (fd == wdog_pipe[WDOG_CHILD_VRRP][0]) ? WDOG_CHILD_VRRP : WDOG_CHILD_CHECK;
+	unsigned long timer = wdog_timer;
+	char buf[64];
+	ssize_t len;
+
+	wdog_thread[side] = NULL;
+
+	if (thread_obj->type == THREAD_READ_TIMEOUT) {
+		log_message(LOG_INFO, "Watchdog: %s child process(%d) missed"
+				      " its heartbeat, killing it",
+			    wdog_name[side], wdog_pid[side]);
+		kill(wdog_pid[side], SIGKILL);
+		return 0;
+	}
+
+	len = read(fd, buf, sizeof (buf));
+	if (len == 0) {
+		/* Child is gone, SIGCHLD will respawn it */
+		wdog_reset(side);
+		return 0;
+	}
+	if (len > 0 && buf[len - 1] == WDOG_HOLD)
+		timer = WDOG_HOLD_TIMER;
+
+	wdog_thread[side] = thread_add_read(master, wdog_read_thread, NULL,
+					    fd, timer);
+	return 0;
+}
+
+/* Parent side, once the child is forked */
+void
+wdog_parent(int side, pid_t pid)
+{
+	if (wdog_pipe[side][0] < 0)
+		return;
+
+	close(wdog_pipe[side][1]);
+	wdog_pipe[side][1] = -1;
+	wdog_pid[side] = pid;
+
+	/* Child parses its configuration before the first heartbeat */
+	wdog_thread[side] = thread_add_read(master, wdog_read_thread, NULL,
+					    wdog_pipe[side][0], WDOG_HOLD_TIMER);
+}
+
+/*
+ * Child side. Keep our write end only, the master thread was rebuilt
+ * so there is nothing to cancel.
+ */
+void
+wdog_child(int side)
+{
+	int i;
+
+	wdog_fd = wdog_pipe[side][1];
+	wdog_pipe[side][1] = -1;
+	for (i = 0; i < 2; i++) {
+		if (wdog_pipe[i][0] >= 0)
+			close(wdog_pipe[i][0]);
+		if (wdog_pipe[i][1] >= 0)
+			close(wdog_pipe[i][1]);
+		wdog_pipe[i][0] = wdog_pipe[i][1] = -1;
+		wdog_thread[i] = NULL;
+	}
+}
+
+static void
+wdog_write(char c)
+{
+	/* Full pipe means the parent is lagging, not us */
+	if (wdog_fd >= 0 && write(wdog_fd, &c, 1) < 0)
+		return;
+}
+
+static int
+wdog_beat_thread(thread * thread_obj)
+{
+	wdog_write(WDOG_BEAT);
+	thread_add_timer(master, wdog_beat_thread, NULL, wdog_timer / 4);
+	return 0;
+}
+
+/* Child side, start beating. Called again once a reload rebuilt master */
+void
+wdog_start(void)
+{
+	if (wdog_fd < 0)
+		return;
+
+	thread_cancel_func(master, wdog_beat_thread, NULL);
+	thread_add_event(master, wdog_beat_thread, NULL, 0);
+}
+
+/* Child side, the loop is about to block for long : reload or stop */
+void
+wdog_hold(void)
+{
+	wdog_write(WDOG_HOLD);
+}
@@ -69,5 +69,6 @@ extern void free_checkers_queue(void);
 extern void register_checkers_thread(void);
 extern void install_checkers_keyword(void);
 extern void update_checker_activity(uint32_t address, int enable);
+extern void resync_checker_activity(list addresses);
 
 #endif
@@ -61,6 +61,7 @@ typedef struct _ssl_data {
 	char *cafile;
 	char *certfile;
 	char *keyfile;
+	int workers;		/* SSL pool size, 0 = inline handshakes */
 } ssl_data;
 
 /* Real Server definition */
@@ -162,6 +163,9 @@ typedef struct _check_conf_data {
 			 (X)->addr_port == (Y)->addr_port &&	\
 			 (X)->weight    == (Y)->weight)
 
+/* Statistics dumped on SIGUSR2 */
+#define CHECK_STATS_FILE	"/var/run/keepalived_check.stats"
+
 /* Global vars exported */
 extern check_conf_data *check_data;
 extern check_conf_data *old_check_data;
@@ -180,5 +184,6 @@ extern void set_rsgroup(char *gname);
 extern check_conf_data *alloc_check_data(void);
 extern void free_check_data(check_conf_data * check_data_obj);
 extern void dump_check_data(check_conf_data * check_data_obj);
+extern void check_print_stats(void);
 
 #endif
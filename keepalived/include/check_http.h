@@ -26,27 +26,40 @@
 
 /* system includes */
 #include <stdio.h>
-#include <openssl/md5.h>
 #include <openssl/ssl.h>
 
 /* local includes */
 #include "check_data.h"
+#include "check_api.h"
 #include "ipwrapper.h"
 #include "scheduler.h"
 #include "layer4.h"
 #include "list.h"
+#include "html.h"
+#include "digest.h"
+#include "ssl_pool.h"
+#include "http_expect.h"
+
+/* global defs */
+#define GET_BUFFER_LENGTH 2048
+#define MAX_BUFFER_LENGTH 4096
+#define PROTO_HTTP	0x01
+#define PROTO_SSL	0x02
+#define HTTP_METHOD_GET		0
+#define HTTP_METHOD_HEAD	1
 
 /* Checker argument structure  */
 /* ssl specific thread arguments defs */
-typedef struct {
-	char *buffer;
-	char *extracted;
-	int error;
-	int status_code;
-	int len;
-	SSL *ssl;
-	BIO *bio;
-	MD5_CTX context;
+typedef struct _req {
+	struct _req *next;	/* free list link */
+	l4_conn conn;		/* socket and TLS over it */
+	http_parser parser;	/* response framing */
+	int reused;		/* connection kept from last loop, no data yet */
+	int digest;		/* body is needed for the url digest */
+	expect_set *expect;	/* body is searched for the url patterns */
+	ssl_job job;		/* handshake handed to the SSL pool */
+	digest_ctx context;	/* kept on reuse with its EVP context */
+	char buffer[MAX_BUFFER_LENGTH];	/* last, not cleared on reuse */
 } REQ;
 
 /* http specific thread arguments defs */
@@ -59,7 +72,13 @@ typedef struct _http_arg {
 typedef struct _url {
 	char *path;
 	char *digest;
+	int digest_algo;	/* DIGEST_MD5, DIGEST_SHA1... */
+	unsigned char digest_bin[DIGEST_MAX_LEN];
+	int digest_len;		/* 0 if digest is malformed */
 	int status_code;
+	expect_set *expect;	/* expect_string & expect_regex */
+	char *request;		/* formatted request, in checker requests */
+	int request_len;
 } url;
 typedef struct _http_get_checker {
 	int proto;
@@ -68,31 +87,42 @@ typedef struct _http_get_checker {
 	long connection_to;
 	int nb_get_retry;
 	long delay_before_retry;
+	int persistent;		/* HTTP/1.1 pipelined, connection kept */
+	int method;		/* HTTP_METHOD_GET or HTTP_METHOD_HEAD */
 	list url;
+	char *requests;		/* all the url requests, back to back */
+	int requests_len;
+	SSL_SESSION *ssl_session;	/* kept for resumption */
+	unsigned long ssl_handshake;	/* full SSL handshakes */
+	unsigned long ssl_resumed;	/* resumed SSL handshakes */
 	http_arg *arg;
 } http_get_checker;
 
-/* global defs */
-#define MD5_BUFFER_LENGTH 32
-#define GET_BUFFER_LENGTH 2048
-#define MAX_BUFFER_LENGTH 4096
-#define PROTO_HTTP	0x01
-#define PROTO_SSL	0x02
 
-/* GET processing command */
-#define REQUEST_TEMPLATE "GET %s HTTP/1.0\r\n" \
+/* GET or HEAD processing command */
+#define REQUEST_TEMPLATE "%s %s HTTP/1.0\r\n" \
+                         "User-Agent:KeepAliveClient\r\n" \
+                         "Host: %s:%d\r\n\r\n"
+#define REQUEST_TEMPLATE_PERSISTENT "%s %s HTTP/1.1\r\n" \
                          "User-Agent:KeepAliveClient\r\n" \
                          "Host: %s:%d\r\n\r\n"
 /* macro utility */
 #define HTTP_ARG(X) ((X)->arg)
 #define HTTP_REQ(X) ((X)->req)
+#define HTTP_METHOD(X) (((X)->method == HTTP_METHOD_HEAD) ? "HEAD" : "GET")
 
 /* Define prototypes */
 extern void install_http_check_keyword(void);
+extern void free_http_get_check(void *data);
+extern void http_free_pool(void);
+extern uint16_t get_service_port(checker * checker_obj);
 extern int epilog(thread * thread_obj, int metod, int t, int c);
 extern int timeout_epilog(thread * thread_obj, char *smtp_msg, char *debug_msg);
 extern url *fetch_next_url(http_get_checker * http_get_check);
-extern int http_process_response(REQ * req, int r);
-extern int http_handle_response(thread * thread_obj, unsigned char digest[16]
-				, int empty_buffer);
+extern int http_response_input(thread * thread_obj, int r);
+extern int http_response_done(thread * thread_obj);
+extern int http_handle_response(thread * thread_obj, int empty_buffer);
+extern int http_check_thread(thread * thread_obj);
+extern int http_pipeline_input(thread * thread_obj, int r);
+extern int http_pipeline_eof(thread * thread_obj);
 #endif
@@ -0,0 +1,43 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        check_shm.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _CHECK_SHM_H
+#define _CHECK_SHM_H
+
+/* system includes */
+#include <stdlib.h>
+#include <stdint.h>
+
+/* local includes */
+#include "scheduler.h"
+
+/* Checker argument structure  */
+typedef struct _shm_checker {
+	char *slot;		/* tracking feed slot name */
+	int index;		/* cached slot position in the feed */
+	uint32_t generation;	/* slot generation last applied */
+} shm_checker;
+
+/* Prototypes defs */
+extern void install_shm_check_keyword(void);
+
+#endif
@@ -30,6 +30,7 @@
 /* local includes */
 #include "check_data.h"
 #include "scheduler.h"
+#include "layer4.h"
 #include "list.h"
 
 #define SMTP_BUFF_MAX		512
@@ -66,6 +67,7 @@ typedef struct _smtp_checker {
 	char buff[SMTP_BUFF_MAX];
 	int buff_ctr;
 	int (*buff_cb) (struct _thread *);
+	l4_conn conn;		/* plain TCP, tracks short writes */
 
 	int state;
 
@@ -27,13 +27,18 @@
 /* local includes */
 #include "check_http.h"
 
+/* ssl_connect() results besides SSL_connect() ones */
+#define SSL_CONNECT_PENDING	-2	/* handed to the SSL pool */
+#define SSL_CONNECT_TIMEOUT	-3	/* timed out in the SSL pool */
+
 /* Prototypes */
 extern void install_ssl_check_keyword(void);
 extern int init_ssl_ctx(void);
 extern void clear_ssl(SSL_DATA * ssl);
 extern int ssl_connect(thread * thread_obj, int new_req);
 extern int ssl_printerr(int err);
-extern int ssl_send_request(SSL * ssl, char *str_request, int request_len);
 extern int ssl_read_thread(thread * thread_obj);
+extern void ssl_forget_session(http_get_checker * http_get_check);
+extern void ssl_print_stats(FILE * fp);
 
 #endif
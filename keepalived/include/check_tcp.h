@@ -30,12 +30,16 @@
 
 /* local includes */
 #include "scheduler.h"
+#include "layer4.h"
 
 /* Checker argument structure  */
 typedef struct _tcp_checker {
 	uint16_t connection_port;
 	uint32_t bindto;
 	int connection_to;
+	int persistent;		/* keep the connection, watch it */
+	l4_conn conn;		/* kept connection, fd -1 if none */
+	long since;		/* when it was established */
 } tcp_checker;
 
 /* Prototypes defs */
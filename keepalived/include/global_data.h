@@ -36,6 +36,7 @@
 #define DEFAULT_SMTP_SERVER 0x7f000001
 #define DEFAULT_SMTP_CONNECTION_TIMEOUT (30 * TIMER_HZ)
 #define DEFAULT_PLUGIN_DIR "/etc/keepalived/plugins"
+#define DEFAULT_NETLINK_RCVBUF (1024 * 1024)
 
 /* email link list */
 typedef struct _email {
@@ -45,8 +46,13 @@ typedef struct _email {
 /* Configuration data root */
 typedef struct _conf_data {
 	int linkbeat_use_polling;
+	int netlink_rcvbuf;
+	int vrrp_rt_priority;
+	int vrrp_no_swap;
+	list vrrp_cpu_affinity;
 	char *router_id;
 	char *plugin_dir;
+	char *track_shm_file;
 	char *email_from;
 	uint32_t smtp_server;
 	long smtp_connection_to;
@@ -58,6 +64,7 @@ extern conf_data *data;		/* Global configuration data */
 
 /* Prototypes */
 extern void alloc_email(char *addr);
+extern void alloc_cpu_affinity(int cpu);
 extern conf_data *alloc_global_data(void);
 extern void free_global_data(conf_data *global_data);
 extern void dump_global_data(conf_data *global_data);
@@ -0,0 +1,79 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        http_expect.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _HTTP_EXPECT_H
+#define _HTTP_EXPECT_H
+
+/* system includes */
+#include <regex.h>
+
+/* local includes */
+#include "list.h"
+
+/* Limits */
+#define EXPECT_MAX	32		/* patterns per url, one bit each */
+#define EXPECT_LINE_MAX	2048		/* regex line, longer ones are split */
+
+/* Pattern types */
+#define EXPECT_STRING	0
+#define EXPECT_REGEX	1
+
+typedef struct _expect_pattern {
+	int type;
+	char *str;
+	unsigned int bit;
+	regex_t re;		/* EXPECT_REGEX only */
+} expect_pattern;
+
+/*
+ * Patterns expected in an url body. The strings are compiled into a
+ * single Aho-Corasick automaton so the body is scanned once whatever
+ * their number. Regexes are matched line by line. Everything is built
+ * at configuration time : feeding the body allocates nothing.
+ */
+typedef struct _expect_set {
+	list patterns;
+	unsigned int all;	/* bits of all the patterns */
+	int *go;		/* automaton, 256 transitions per node */
+	unsigned int *out;	/* string bits matched on reaching a node */
+	int regex;		/* number of regex patterns */
+	char *line;		/* regex line being gathered */
+
+	/* Per check state */
+	int node;
+	int line_len;
+	unsigned int found;
+} expect_set;
+
+/* macro utility */
+#define EXPECT_DONE(E)	((E)->found == (E)->all)
+
+/* Prototypes */
+extern expect_set *alloc_expect_set(void);
+extern void free_expect_set(expect_set * set);
+extern void dump_expect_set(expect_set * set);
+extern int expect_add(expect_set * set, int type, char *str);
+extern void expect_reset(expect_set * set);
+extern int expect_feed(expect_set * set, char *data, int len);
+extern int expect_eof(expect_set * set);
+
+#endif
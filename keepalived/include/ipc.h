@@ -0,0 +1,63 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        ipc.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _IPC_H
+#define _IPC_H
+
+/* system includes */
+#include <stdint.h>
+
+/* local includes */
+#include "timer.h"
+
+/* Channel ends */
+#define IPC_CHECK	0	/* healthcheck child */
+#define IPC_VRRP	1	/* VRRP child */
+
+#define IPC_KEY_LEN	64
+#define IPC_BATCH	64		/* records per datagram */
+#define IPC_TIMER	(60 * TIMER_HZ)	/* read thread timeout */
+#define IPC_RETRY	TIMER_HZ	/* full resync delay after a loss */
+
+/* Record types */
+#define IPC_MSG_STATE	1	/* checker -> VRRP : service state */
+#define IPC_MSG_RESYNC	2	/* VRRP -> checker : send all states */
+
+/*
+ * Services are named by key : "<VIP>:<port>", "fwmark:<mark>" or
+ * "group:<name>" for a virtual server, "<RIP>:<port>" for a real
+ * server of that virtual server.
+ */
+typedef struct {
+	uint32_t type;
+	uint32_t up;
+	char vs[IPC_KEY_LEN];
+	char rs[IPC_KEY_LEN];	/* empty for the virtual server quorum */
+} ipc_msg;
+
+/* Prototypes */
+extern void ipc_init(void);
+extern void ipc_open(int side, void (*handler) (ipc_msg *), void (*resync) (void));
+extern void ipc_close(void);
+extern void ipc_send(ipc_msg *msg);
+
+#endif
@@ -29,6 +29,7 @@
 /* locale includes */
 #include "check_data.h"
 #include "smtp.h"
+#include "ipc.h"
 
 /* NAT netmask */
 #define HOST_NETMASK   0xffffffff
@@ -57,5 +58,7 @@ extern void update_svr_checker_state(int alive, checker_id_t cid,
 extern int init_services(void);
 extern int clear_services(void);
 extern int clear_diff_services(void);
+extern void check_ipc_resync(void);
+extern void check_ipc_handler(ipc_msg *msg);
 
 #endif
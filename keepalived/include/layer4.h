@@ -31,6 +31,9 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/ssl.h>
 
 /* local includes */
 #include "scheduler.h"
@@ -42,13 +45,34 @@ enum connect_result {
 	connect_success
 };
 
+/* l4_read() & l4_write() results, beside a byte count */
+#define L4_EOF		0
+#define L4_ERROR	-1
+#define L4_AGAIN	-2		/* caller thread registered back */
+
+/*
+ * Checker connection. The socket is non blocking from its creation and
+ * TLS, when ssl is set, runs over the same descriptor : checkers do
+ * their I/O through l4_read() & l4_write() whatever the transport.
+ */
+typedef struct _l4_conn {
+	int fd;
+	SSL *ssl;		/* NULL on plain TCP */
+	int error;		/* SSL_get_error() of the last TLS call */
+	int sent;		/* part of the pending write already out */
+} l4_conn;
+
 /* Prototypes defs */
+extern int tcp_socket(void);
+
 extern enum connect_result
  tcp_bind_connect(int, uint32_t, uint16_t, uint32_t);
 
 extern enum connect_result
  tcp_connect(int, uint32_t, uint16_t);
 
+extern void tcp_keepalive(int, long, long);
+
 extern enum connect_result
  tcp_socket_state(int, thread *, uint32_t, uint16_t,
 		  int (*func) (struct _thread *));
@@ -57,4 +81,12 @@ extern void
  tcp_connection_state(int, enum connect_result
 		      , thread *, int (*func) (struct _thread *)
 		      , long);
+
+extern int
+ l4_read(l4_conn *, thread *, int (*func) (struct _thread *), long,
+	 char *, int);
+
+extern int
+ l4_write(l4_conn *, thread *, int (*func) (struct _thread *), long,
+	  char *, int);
 #endif
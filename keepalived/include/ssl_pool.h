@@ -0,0 +1,65 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        ssl_pool.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _SSL_POOL_H
+#define _SSL_POOL_H
+
+/* system includes */
+#include <openssl/ssl.h>
+
+/* local includes */
+#include "timer.h"
+
+/* Limits */
+#define SSL_POOL_MAX	64			/* workers */
+#define SSL_POOL_TIMER	(60 * TIMER_HZ)		/* eventfd read thread timeout */
+
+/* Job states */
+#define SSL_JOB_IDLE	0
+#define SSL_JOB_QUEUED	1			/* owned by the workers */
+#define SSL_JOB_DONE	2			/* back, result not consumed */
+
+/*
+ * Handshake handed to a worker. Embedded in the caller's own data :
+ * nothing is allocated from the workers, and nothing in the job may
+ * be touched by the scheduler while it is queued.
+ */
+typedef struct _ssl_job {
+	struct _ssl_job *next;
+	SSL *ssl;
+	int fd;
+	long timeout;		/* handshake budget, usec */
+	int state;
+	int ret;		/* SSL_connect() result */
+	int error;		/* SSL_get_error() seen by the worker */
+	int timedout;
+	void (*done) (struct _ssl_job *);	/* run from the scheduler */
+	void *arg;
+} ssl_job;
+
+/* Prototypes */
+extern int ssl_pool_start(int workers);
+extern void ssl_pool_stop(void);
+extern int ssl_pool_size(void);
+extern void ssl_pool_submit(ssl_job * job);
+
+#endif
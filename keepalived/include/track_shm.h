@@ -0,0 +1,73 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        track_shm.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _TRACK_SHM_H
+#define _TRACK_SHM_H
+
+/* system includes */
+#include <stdint.h>
+
+/*
+ * Tracking feed file layout. An external process owns the file and
+ * updates slots in place; keepalived maps it read-only. A writer
+ * increments the slot generation before (odd) and after (even) each
+ * update so that readers can detect and retry torn reads.
+ *
+ * The file is mapped at its size when opened and must not shrink. To
+ * resize it, rewrite nslots (the file is mapped again) or write a new
+ * file, rename it over the feed and clear the old one's magic. A feed
+ * truncated anyway is dropped and mapped again on next read.
+ */
+#define TRACK_SHM_MAGIC		0x4b414653	/* "KAFS" */
+#define TRACK_SHM_VERSION	1
+#define TRACK_SHM_NAMELEN	32
+#define TRACK_SHM_NOWEIGHT	-1		/* keep configured weight */
+#define TRACK_SHM_NOGEN		1		/* odd, never read from a slot */
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nslots;
+	uint32_t pad;
+} track_shm_hdr;
+
+typedef struct {
+	char name[TRACK_SHM_NAMELEN];	/* NUL terminated */
+	volatile uint32_t generation;	/* odd while being written */
+	int32_t status;			/* 0 = up, anything else = down */
+	int32_t weight;			/* RS weight or TRACK_SHM_NOWEIGHT */
+	uint32_t pad;
+} track_shm_slot;
+
+/* Consistent copy of a slot */
+typedef struct {
+	uint32_t generation;
+	int status;
+	int weight;
+} track_shm_value;
+
+/* Prototypes */
+extern int track_shm_open(char *path);
+extern void track_shm_close(void);
+extern int track_shm_read(char *name, int *index, track_shm_value *val);
+
+#endif
@@ -65,6 +65,62 @@ typedef struct {		/* rfc2338.5.1 */
 #define VRRP_ADVER_DFL	1	/* advert. interval (in sec) -- rfc2338.5.3.7 */
 #define VRRP_GARP_DELAY (5 * TIMER_HZ)	/* Default delay to launch gratuitous arp */
 
+/* Per instance counters, only ever touched from the dispatcher */
+typedef struct {
+	unsigned long adv_sent;		/* adverts sent */
+	unsigned long adv_rcvd;		/* adverts received */
+	unsigned long pri_zero_sent;	/* priority 0 adverts sent */
+	unsigned long pri_zero_rcvd;	/* priority 0 adverts received */
+	unsigned long packet_ko;	/* VRRP_PACKET_KO adverts */
+	unsigned long packet_drop;	/* VRRP_PACKET_DROP adverts */
+	unsigned long packet_null;	/* VRRP_PACKET_NULL reads */
+	unsigned long ttl_err;		/* TTL is not 255 */
+	unsigned long version_err;	/* unknown VRRP version */
+	unsigned long length_err;	/* payload too short */
+	unsigned long checksum_err;	/* bad VRRP checksum */
+	unsigned long auth_type_err;	/* auth type mismatch */
+	unsigned long auth_err;		/* bad password or AH digest */
+	unsigned long vrid_err;		/* VRID mismatch */
+	unsigned long addr_list_err;	/* VIP count or list mismatch */
+	unsigned long interval_err;	/* advert interval mismatch */
+	unsigned long become_master;
+	unsigned long release_master;
+	unsigned long become_backup;
+	unsigned long become_fault;
+} vrrp_stats;
+
+/* State transition history */
+#define VRRP_HISTORY_SIZE	16
+
+#define VRRP_CAUSE_INIT		0	/* daemon startup */
+#define VRRP_CAUSE_RELOAD	1	/* configuration reload */
+#define VRRP_CAUSE_TIMEOUT	2	/* advert or master down timer */
+#define VRRP_CAUSE_ADVERT	3	/* advert received */
+#define VRRP_CAUSE_PRIO_ZERO	4	/* master resigned */
+#define VRRP_CAUSE_HIGHER_PRIO	5	/* higher priority advert */
+#define VRRP_CAUSE_LOWER_PRIO	6	/* lower priority advert, preempting */
+#define VRRP_CAUSE_FAULT	7	/* interface or tracked object down */
+#define VRRP_CAUSE_RECOVER	8	/* interface and tracked objects up */
+#define VRRP_CAUSE_SYNC		9	/* sync group member transition */
+
+typedef struct {
+	TIMEVAL time;		/* monotonic timestamp */
+	uint8_t from;		/* previous state */
+	uint8_t to;		/* new state */
+	uint8_t cause;		/* VRRP_CAUSE_* */
+} vrrp_transition;
+
+/* Failover timing, stages of the last transition to MASTER */
+typedef struct {
+	TIMEVAL last_adv;	/* last valid advert received */
+	TIMEVAL detect;		/* transition to MASTER decided */
+	TIMEVAL addr;		/* VIPs, eVIPs & routes installed */
+	TIMEVAL garp;		/* first gratuitous ARP sent */
+	TIMEVAL notify;		/* notify scripts spawned */
+	TIMEVAL syncd;		/* LVS sync daemon switched */
+	int cause;		/* VRRP_CAUSE_* of the transition */
+} vrrp_trace;
+
 /*
  * parameters per vrrp sync group. A vrrp_sync_group is a set
  * of VRRP instances that need to be state sync together.
@@ -74,6 +130,11 @@ typedef struct _vrrp_sgroup {
 	vector iname;		/* Set of VRRP instances in this group */
 	list index_list;	/* List of VRRP instances */
 	int state;		/* current stable state */
+	int num_backup;		/* members in BACKUP state */
+	int num_master;		/* members in MASTER state */
+	int num_fault;		/* members in FAULT state */
+	int num_member_fault;	/* members with a tracked object down */
+	int election;		/* MASTER election forced on members */
 
 	/* State transition notification */
 	int notify_exec;
@@ -92,6 +153,9 @@ typedef struct _vrrp_rt {
 	int dont_track_primary; /* If set ignores ifp faults */
 	list track_ifp;		/* Interface state we monitor */
 	list track_script;	/* Script state we monitor */
+	list track_svc;		/* LVS service state we monitor */
+	int num_track_fault;	/* Tracked objects down with no weight */
+	int track_weight;	/* Sum of tracked objects current weights */
 	uint32_t mcast_saddr;	/* Src IP address to use in VRRP IP header */
 	char *lvs_syncd_if;	/* handle LVS sync daemon state using this
 				 * instance FSM & running on specific interface
@@ -118,6 +182,7 @@ typedef struct _vrrp_rt {
 	int state;		/* internal state (init/backup/master) */
 	int init_state;		/* the initial state of the instance */
 	int wantstate;		/* user explicitly wants a state (back/mast) */
+	int reloaded;		/* running state kept across a reload */
 	int fd_in;		/* IN socket descriptor */
 	int fd_out;		/* OUT socket descriptor */
 
@@ -155,6 +220,13 @@ typedef struct _vrrp_rt {
 
 	/* IPSEC AH counter def --rfc2402.3.3.2 */
 	seq_counter *ipsecah_counter;
+
+	/* Statistics */
+	vrrp_stats stats;
+	int cause;		/* event being handled, VRRP_CAUSE_* */
+	vrrp_transition history[VRRP_HISTORY_SIZE];
+	unsigned int history_count;
+	vrrp_trace trace;
 } vrrp_rt;
 
 /* VRRP state machine -- rfc2338.6.4 */
@@ -200,16 +272,11 @@ typedef struct _vrrp_rt {
 
 #define VRRP_PKT_SADDR(V) (((V)->mcast_saddr) ? (V)->mcast_saddr : IF_ADDR((V)->ifp))
 
-#define VRRP_IF_ISUP(V)        ((IF_ISUP((V)->ifp) || (V)->dont_track_primary) & \
-                               ((!LIST_ISEMPTY((V)->track_ifp)) ? TRACK_ISUP((V)->track_ifp) : 1))
-
-#define VRRP_SCRIPT_ISUP(V)    ((!LIST_ISEMPTY((V)->track_script)) ? SCRIPT_ISUP((V)->track_script) : 1)
-
-#define VRRP_ISUP(V)           (VRRP_IF_ISUP(V) && VRRP_SCRIPT_ISUP(V))
+#define VRRP_ISUP(V)           (!(V)->num_track_fault)
 
 /* prototypes */
-extern int open_vrrp_send_socket(const int proto, const int idx);
-extern int open_vrrp_socket(const int proto, const int idx);
+extern int open_vrrp_send_socket(const int proto, interface * ifp);
+extern int open_vrrp_socket(const int proto, interface * ifp);
 extern int new_vrrp_socket(vrrp_rt * vrrp);
 extern void close_vrrp_socket(vrrp_rt * vrrp);
 extern void vrrp_send_gratuitous_arp(vrrp_rt * vrrp);
@@ -226,5 +293,9 @@ extern void shutdown_vrrp_instances(void);
 extern void clear_diff_vrrp(void);
 extern void clear_diff_script(void);
 extern void vrrp_restore_interface(vrrp_rt * vrrp, int advF);
+extern void vrrp_record_transition(vrrp_rt * vrrp, int state);
+extern const char *vrrp_state_name(int state);
+extern const char *vrrp_cause_name(int cause);
+extern long vrrp_trace_delta(TIMEVAL from, TIMEVAL to);
 
 #endif
@@ -30,6 +30,7 @@
 /* Daemon define */
 #define PROG_VRRP	"Keepalived_vrrp"
 #define WDOG_VRRP	"/tmp/.vrrp"
+#define VRRP_PREFAULT_STACK	(64 * 1024)
 
 /* Prototypes */
 extern int start_vrrp_child(void);
@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <syslog.h>
 #include <arpa/inet.h>
 
@@ -54,10 +55,16 @@ typedef struct _vrrp_conf_data {
 	list vrrp;
 	list vrrp_index;
 	list vrrp_index_fd;
+	list vrrp_index_name;
+	list vrrp_index_ifvrid;
 	list vrrp_socket_pool;
 	list vrrp_script;
+	list vrrp_svc;
 } vrrp_conf_data;
 
+/* Counters & transition history dump, written on SIGUSR2 */
+#define VRRP_STATS_FILE	"/var/run/keepalived.stats"
+
 /* Global Vars exported */
 extern vrrp_conf_data *vrrp_data;
 extern vrrp_conf_data *old_vrrp_data;
@@ -71,6 +78,8 @@ extern void alloc_vrrp(char *iname);
 extern void alloc_vrrp_track(vector strvec);
 extern void alloc_vrrp_script(char *sname);
 extern void alloc_vrrp_track_script(vector strvec);
+extern void alloc_vrrp_track_vs(vector strvec);
+extern void alloc_vrrp_track_rs(vector strvec);
 extern void alloc_vrrp_vip(vector strvec);
 extern void alloc_vrrp_evip(vector strvec);
 extern void alloc_vrrp_vroute(vector strvec);
@@ -80,5 +89,6 @@ extern vrrp_conf_data *alloc_vrrp_data(void);
 extern void free_vrrp_data(vrrp_conf_data * vrrp_data_obj);
 extern void dump_vrrp_data(vrrp_conf_data * vrrp_data_obj);
 extern void free_vrrp_sockpool(vrrp_conf_data * vrrp_data_obj);
+extern void vrrp_print_stats(void);
 
 #endif
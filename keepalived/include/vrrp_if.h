@@ -57,6 +57,9 @@ struct ethtool_value {
         uint32_t   data;
 };
 #endif
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP	0x10000		/* driver signals L1 up */
+#endif
 #define LINK_UP   1
 #define LINK_DOWN 0
 #define IF_NAMESIZ    20	/* Max interface lenght size */
@@ -64,11 +67,18 @@ struct ethtool_value {
 #define ARPHRD_ETHER 1
 #define ARPHRD_LOOPBACK 772
 #define POLLING_DELAY TIMER_HZ
+#define IF_HASH_SIZE 256
 
 /* Interface Linkbeat code selection */
 #define LB_IOCTL   0x1
 #define LB_MII     0x2
 #define LB_ETHTOOL 0x4
+#define LB_NETLINK 0x8
+
+/* RFC2863 operstate as reported by IFLA_OPERSTATE. Drivers that never
+ * signal carrier to the kernel are left in unknown state.
+ */
+#define OPER_UNKNOWN 0
 
 /* Interface structure definition */
 typedef struct _interface {
@@ -82,6 +92,11 @@ typedef struct _interface {
 	int hw_addr_len;	/* MAC addresss length */
 	int lb_type;		/* Interface regs selection */
 	int linkbeat;		/* LinkBeat from MII BMSR req */
+	u_char operstate;	/* operstate from netlink, OPER_UNKNOWN if none */
+	int pinned;		/* referenced by configuration */
+	unsigned int nl_gen;	/* last netlink resync generation seen */
+	thread *lb_thread;	/* linkbeat polling thread, if any */
+	list tracking_vrrp;	/* VRRP instances tracking this interface */
 } interface;
 
 /* Tracked interface structure definition */
@@ -98,6 +113,7 @@ typedef struct _tracked_if {
 #define IF_HWADDR(X) ((X)->hw_addr)
 #define IF_MII_SUPPORTED(X) ((X)->lb_type & LB_MII)
 #define IF_ETHTOOL_SUPPORTED(X) ((X)->lb_type & LB_ETHTOOL)
+#define IF_NETLINK_SUPPORTED(X) ((X)->lb_type & LB_NETLINK)
 #define IF_LINKBEAT(X) ((X)->linkbeat)
 #define IF_ISUP(X) (((X)->flags & IFF_UP)      && \
                     ((X)->flags & IFF_RUNNING) && \
@@ -105,15 +121,21 @@ typedef struct _tracked_if {
 
 /* prototypes */
 extern interface *if_get_by_ifindex(const int ifindex);
+extern interface *if_lookup_by_ifname(const char *ifname);
 extern interface *if_get_by_ifname(const char *ifname);
 extern int if_linkbeat(const interface *ifp);
 extern int if_mii_probe(const char *ifname);
 extern int if_ethtool_probe(const char *ifname);
 extern void if_add_queue(interface * ifp);
+extern void if_rehash_queue(interface * ifp, const int ifindex, const char *ifname);
+extern int if_del_queue(interface * ifp);
+extern void if_linkbeat_add(interface * ifp);
+extern void if_resync_purge(unsigned int gen);
 extern int if_monitor_thread(thread * thread_obj);
 extern void init_interface_queue(void);
 extern void init_interface_linkbeat(void);
 extern void free_interface_queue(void);
+extern void if_reset_tracking(void);
 extern void dump_if(void *if_data_obj);
 extern int if_join_vrrp_group(int sd, interface * ifp, int proto);
 extern void if_leave_vrrp_group(int sd, interface * ifp);
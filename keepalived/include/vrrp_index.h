@@ -34,6 +34,8 @@
 #include "vrrp.h"
 
 /* Macro definition */
+#define VRRP_NAME_HASH_SIZE	1024
+#define VRRP_IFVRID_HASH_SIZE	1024
 
 /* prototypes */
 extern void alloc_vrrp_bucket(vrrp_rt *vrrp);
@@ -41,5 +43,9 @@ extern void alloc_vrrp_fd_bucket(vrrp_rt *vrrp);
 extern void remove_vrrp_fd_bucket(vrrp_rt *vrrp);
 extern void set_vrrp_fd_bucket(int old_fd, vrrp_rt *vrrp);
 extern vrrp_rt *vrrp_index_lookup(const int vrid, const int fd);
+extern void alloc_vrrp_name_bucket(vrrp_rt *vrrp);
+extern vrrp_rt *vrrp_index_lookup_name(const char *iname);
+extern vrrp_rt *alloc_vrrp_ifvrid_bucket(vrrp_rt *vrrp);
+extern vrrp_rt *vrrp_index_lookup_ifvrid(const int ifindex, const int vrid);
 
 #endif
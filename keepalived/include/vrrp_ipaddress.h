@@ -40,7 +40,6 @@ typedef struct {
 	uint32_t addr;		/* the ip address */
 	uint32_t broadcast;	/* the broadcast address */
 	uint8_t mask;		/* the ip address CIDR netmask */
-	int ifindex;		/* Interface index owning IP address */
 	interface *ifp;		/* Interface owning IP address */
 	int scope;		/* the ip address scope */
 	char *label;		/* Alias name, e.g. eth0:1 */
@@ -54,7 +53,7 @@ typedef struct {
 /* Macro definition */
 #define IP_ISEQ(X,Y)   ((X)->addr    == (Y)->addr     && \
 			(X)->mask    == (Y)->mask     && \
-			(X)->ifindex == (Y)->ifindex  && \
+			(X)->ifp     == (Y)->ifp      && \
 			(X)->scope   == (Y)->scope)
 
 /* prototypes */
@@ -29,6 +29,7 @@
 #include <arpa/inet.h>
 
 /* local includes */
+#include "vrrp_if.h"
 #include "list.h"
 #include "vector.h"
 
@@ -40,7 +41,7 @@ typedef struct _ip_route {
 	uint32_t gw2;		/* Will use RTA_MULTIPATH */
 	uint32_t src;		/* RTA_PREFSRC */
 	uint32_t metric;	/* RTA_PRIORITY */
-	int index;		/* RTA_OIF */
+	interface *ifp;		/* RTA_OIF */
 	int blackhole;
 	int scope;
 	int table;
@@ -57,7 +58,7 @@ typedef struct _ip_route {
 			 (X)->src    == (Y)->src   && \
 			 (X)->table  == (Y)->table && \
 			 (X)->scope  == (Y)->scope && \
-			 (X)->index  == (Y)->index)
+			 (X)->ifp    == (Y)->ifp)
 
 /* prototypes */
 extern int netlink_route_ipv4(ip_route *iproute, int cmd);
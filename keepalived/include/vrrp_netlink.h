@@ -43,12 +43,22 @@ struct nl_handle {
 	__u32 seq;
 };
 
+/* Netlink reflector statistics */
+typedef struct _nl_stats {
+	unsigned long overrun;		/* ENOBUFS on reflector socket */
+	unsigned long resync;		/* full link/address re-dumps */
+} nl_stats;
+
 /* Define types */
 #define NETLINK_TIMER (30 * TIMER_HZ)
+#define NETLINK_BATCH 64			/* datagrams per reflector read */
+#define NETLINK_RESYNC_DELAY (5 * TIMER_HZ)	/* min delay between resyncs */
 
 /* Global vars exported */
 extern struct nl_handle nl_kernel;	/* Kernel reflection channel */
 extern struct nl_handle nl_cmd;		/* Command channel */
+extern nl_stats netlink_stats;		/* Reflector statistics */
+extern unsigned int netlink_resync_gen;	/* Current link resync generation */
 
 /* prototypes */
 extern int addattr32(struct nlmsghdr *n, int maxlen, int type, uint32_t data_obj);
@@ -64,6 +74,7 @@ extern int netlink_talk(struct nl_handle *nl, struct nlmsghdr *n);
 extern int netlink_interface_lookup(void);
 extern int netlink_interface_refresh(void);
 extern void kernel_netlink_init(void);
+extern void kernel_netlink_set_rcvbuf(int size);
 extern void kernel_netlink_close(void);
 
 #endif
@@ -60,6 +60,9 @@ do {						\
 /* extern prototypes */
 extern void vrrp_dispatcher_release(vrrp_conf_data * conf_data_obj);
 extern int vrrp_dispatcher_init(thread * thread_obj);
+extern void vrrp_dispatcher_cancel(void);
+extern void vrrp_dispatcher_reload(vrrp_conf_data * old);
+extern void vrrp_dispatcher_dump_stats(void);
 extern int vrrp_read_dispatcher_thread(thread * thread_obj);
 
 #endif
@@ -42,6 +42,7 @@
 
 /* extern prototypes */
 extern void vrrp_init_instance_sands(vrrp_rt *);
+extern void vrrp_set_state(vrrp_rt *, int);
 extern void vrrp_sync_smtp_notifier(vrrp_sgroup *);
 extern void vrrp_sync_set_group(vrrp_sgroup *);
 extern int vrrp_sync_group_up(vrrp_sgroup *);
@@ -33,10 +33,11 @@
 /* local includes */
 #include "vector.h"
 #include "list.h"
+#include "vrrp_if.h"
+#include "ipc.h"
 
 /* Macro definition */
-#define TRACK_ISUP(L)	(vrrp_tracked_up((L)))
-#define SCRIPT_ISUP(L)	(vrrp_script_up((L)))
+#define SCRIPT_ISUP(S)	((S)->result >= (S)->rise)
 
 /* VRRP script tracking defaults */
 #define VRRP_SCRIPT_DI 1       /* external script track interval (in sec) */
@@ -57,12 +58,16 @@
 typedef struct _vrrp_script {
 	char *sname;		/* instance name */
 	char *script;		/* the command to be called */
+	char *shm_slot;		/* tracking feed slot, replaces script */
+	int shm_index;		/* cached slot position in the feed */
+	uint32_t shm_gen;	/* slot generation last applied */
 	int interval;		/* interval between script calls */
 	int weight;		/* weight associated to this script */
 	int result;		/* result of last call to this script: 0..R-1 = KO, R..R+F-1 = OK */
 	int inuse;		/* how many users have weight>0 ? */
 	int rise;		/* R: how many successes before OK */
 	int fall;		/* F: how many failures before KO */
+	list tracking_vrrp;	/* VRRP instances tracking this script */
 } vrrp_script;
 
 /* Tracked script structure definition */
@@ -71,16 +76,46 @@ typedef struct _tracked_sc {
 	vrrp_script *scr;	/* script pointer, cannot be NULL */
 } tracked_sc;
 
+/* LVS service state received from the healthcheck child */
+typedef struct _vrrp_svc {
+	char vs[IPC_KEY_LEN];	/* virtual server key */
+	char rs[IPC_KEY_LEN];	/* real server key, empty for VS quorum */
+	int up;			/* last state reported */
+	list tracking_vrrp;	/* VRRP instances tracking this service */
+} vrrp_svc;
+
+/* Tracked service structure definition */
+typedef struct _tracked_svc {
+	int weight;		/* tracking weight when non-zero */
+	vrrp_svc *svc;		/* service pointer, cannot be NULL */
+} tracked_svc;
+
+/* Tracking VRRP instance reverse index entry. Each tracked object
+ * (interface or script) keeps the list of instances tracking it, so
+ * that a state change is pushed to the instances concerned only.
+ */
+typedef struct _tracking_vrrp {
+	int weight;		/* tracking weight when non-zero */
+	struct _vrrp_rt *vrrp;	/* instance backpointer, cannot be NULL */
+} tracking_vrrp;
+
 /* prototypes */
 extern void dump_track(void *track_data_obj);
 extern void alloc_track(list track_list, vector strvec);
 extern void dump_track_script(void *track_data_obj);
 extern void alloc_track_script(list track_list, vector strvec);
-extern int vrrp_tracked_up(list l);
 extern void vrrp_log_tracked_down(list l);
-extern int vrrp_tracked_weight(list l);
-extern int vrrp_script_up(list l);
-extern int vrrp_script_weight(list l);
 extern vrrp_script* find_script_by_name(char *name);
+extern void free_tracking_vrrp(void *data);
+extern void vrrp_init_track(struct _vrrp_rt *vrrp);
+extern void vrrp_track_if_update(interface *ifp, int was_up);
+extern void vrrp_track_script_update(vrrp_script *vscript, int was_up);
+extern void free_vsvc(void *data);
+extern void dump_vsvc(void *data);
+extern void dump_track_svc(void *track_data_obj);
+extern void alloc_track_vs(list track_list, vector strvec);
+extern void alloc_track_rs(list track_list, vector strvec);
+extern void vrrp_ipc_handler(ipc_msg *msg);
+extern void vrrp_ipc_resync(void);
 
 #endif
@@ -0,0 +1,52 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        watchdog.c include file.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _WATCHDOG_H
+#define _WATCHDOG_H
+
+/* system includes */
+#include <sys/types.h>
+
+/* local includes */
+#include "timer.h"
+
+/* Watched children */
+#define WDOG_CHILD_CHECK	0	/* healthcheck child */
+#define WDOG_CHILD_VRRP		1	/* VRRP child */
+
+/* Heartbeat bytes */
+#define WDOG_BEAT	'.'	/* scheduler loop alive */
+#define WDOG_HOLD	'h'	/* long silence expected (reload, stop) */
+
+#define WDOG_HOLD_TIMER	(60 * TIMER_HZ)	/* startup, reload and stop budget */
+
+/* Global vars exported */
+extern unsigned long wdog_timer;	/* missed heartbeat budget, 0 = off */
+
+/* Prototypes */
+extern void wdog_prefork(int side);
+extern void wdog_parent(int side, pid_t pid);
+extern void wdog_child(int side);
+extern void wdog_start(void);
+extern void wdog_hold(void);
+
+#endif
@@ -201,6 +201,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 	if (ip->ttl != VRRP_IP_TTL) {
 		log_message(LOG_INFO, "invalid ttl. %d and expect %d", ip->ttl,
 		       VRRP_IP_TTL);
+		vrrp->stats.ttl_err++;
 		return VRRP_PACKET_KO;
 	}
 
@@ -208,6 +209,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 	if ((hd->vers_type >> 4) != VRRP_VERSION) {
 		log_message(LOG_INFO, "invalid version. %d and expect %d",
 		       (hd->vers_type >> 4), VRRP_VERSION);
+		vrrp->stats.version_err++;
 		return VRRP_PACKET_KO;
 	}
 
@@ -219,6 +221,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 		log_message(LOG_INFO,
 		       "ip payload too short. %d and expect at least %d",
 		       ntohs(ip->tot_len) - ihl, sizeof (vrrp_pkt));
+		vrrp->stats.length_err++;
 		return VRRP_PACKET_KO;
 	}
 
@@ -226,6 +229,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 	if (in_csum((u_short *) hd,
 	    sizeof(vrrp_pkt) + VRRP_AUTH_LEN + hd->naddr * sizeof(uint32_t), 0)) {
 		log_message(LOG_INFO, "Invalid vrrp checksum");
+		vrrp->stats.checksum_err++;
 		return VRRP_PACKET_KO;
 	}
 
@@ -236,6 +240,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 	if (vrrp->auth_type != hd->auth_type) {
 		log_message(LOG_INFO, "receive a %d auth, expecting %d!",
 		       vrrp->auth_type, hd->auth_type);
+		vrrp->stats.auth_type_err++;
 		return VRRP_PACKET_KO;
 	}
 
@@ -245,6 +250,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 		    - sizeof (vrrp->auth_data);
 		if (memcmp(pw, vrrp->auth_data, sizeof(vrrp->auth_data)) != 0) {
 			log_message(LOG_INFO, "receive an invalid passwd!");
+			vrrp->stats.auth_err++;
 			return VRRP_PACKET_KO;
 		}
 	}
@@ -254,6 +260,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 		log_message(LOG_INFO,
 		       "received VRID mismatch. Received %d, Expected %d",
 		       hd->vrid, vrrp->vrid);
+		vrrp->stats.vrid_err++;
 		return VRRP_PACKET_DROP;
 	}
 
@@ -265,6 +272,7 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 		if (hd->naddr != LIST_SIZE(vrrp->vip)) {
 			log_message(LOG_INFO,
 			       "receive an invalid ip number count associated with VRID!");
+			vrrp->stats.addr_list_err++;
 			return VRRP_PACKET_KO;
 		}
 
@@ -277,12 +285,14 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 				log_message(LOG_INFO,
 				       "one or more VIP associated with"
 				       " VRID mismatch actual MASTER advert");
+				vrrp->stats.addr_list_err++;
 				return VRRP_PACKET_KO;
 			}
 		}
 	} else if (hd->naddr > 0) {
 		log_message(LOG_INFO,
 		       "receive an invalid ip number count associated with VRID!");
+		vrrp->stats.addr_list_err++;
 		return VRRP_PACKET_KO;
 	}
 
@@ -295,12 +305,18 @@ vrrp_in_chk(vrrp_rt * vrrp, char *buffer)
 		       "advertissement interval mismatch mine=%d rcved=%d",
 		       vrrp->adver_int, hd->adver_int);
 		/* to prevent concurent VRID running => multiple master in 1 VRID */
+		vrrp->stats.interval_err++;
 		return VRRP_PACKET_DROP;
 	}
 
 	/* check the authenicaion if it is ipsec ah */
-	if (hd->auth_type == VRRP_AUTH_AH)
-		return (vrrp_in_chk_ipsecah(vrrp, buffer));
+	if (hd->auth_type == VRRP_AUTH_AH && vrrp_in_chk_ipsecah(vrrp, buffer)) {
+		vrrp->stats.auth_err++;
+		return VRRP_PACKET_KO;
+	}
+
+	if (hd->priority == 0)
+		vrrp->stats.pri_zero_rcvd++;
 
 	return VRRP_PACKET_OK;
 }
@@ -541,6 +557,10 @@ vrrp_send_adv(vrrp_rt * vrrp, int prio)
 	/* build the packet */
 	vrrp_build_pkt(vrrp, prio);
 
+	vrrp->stats.adv_sent++;
+	if (prio == VRRP_PRIO_STOP)
+		vrrp->stats.pri_zero_sent++;
+
 	/* send it */
 	return vrrp_send_pkt(vrrp);
 }
@@ -552,19 +572,27 @@ vrrp_check_packet(vrrp_rt * vrrp, char *buf, int buflen)
 	int ret;
 
 	if (buflen > 0) {
+		vrrp->stats.adv_rcvd++;
 		ret = vrrp_in_chk(vrrp, buf);
 
 		if (ret == VRRP_PACKET_DROP) {
 			log_message(LOG_INFO, "Sync instance needed on %s !!!",
 			       IF_NAME(vrrp->ifp));
+			vrrp->stats.packet_drop++;
 		}
 
-		if (ret == VRRP_PACKET_KO)
+		if (ret == VRRP_PACKET_KO) {
 			log_message(LOG_INFO, "bogus VRRP packet received on %s !!!",
 			       IF_NAME(vrrp->ifp));
+			vrrp->stats.packet_ko++;
+		}
+
+		if (ret == VRRP_PACKET_OK)
+			vrrp->trace.last_adv = time_now;
 		return ret;
 	}
 
+	vrrp->stats.packet_null++;
 	return VRRP_PACKET_NULL;
 }
 
@@ -593,6 +621,8 @@ vrrp_send_gratuitous_arp(vrrp_rt * vrrp)
 					       IF_NAME(ipaddress->ifp),
 					       inet_ntop2(ipaddress->addr));
 				send_gratuitous_arp(ipaddress);
+				if (TIMER_ISNULL(vrrp->trace.garp))
+					vrrp->trace.garp = timer_now();
 			}
 		if (!LIST_ISEMPTY(vrrp->evip))
 			for (e = LIST_HEAD(vrrp->evip); e; ELEMENT_NEXT(e)) {
@@ -609,10 +639,42 @@ vrrp_send_gratuitous_arp(vrrp_rt * vrrp)
 	}
 }
 
+/*
+ * Failover tracing. Stages are timestamped as they complete and
+ * logged as a single record once the instance is fully MASTER.
+ */
+long
+vrrp_trace_delta(TIMEVAL from, TIMEVAL to)
+{
+	if (TIMER_ISNULL(from) || TIMER_ISNULL(to) || timer_cmp(to, from) < 0)
+		return -1;
+	return TIMER_LONG(timer_sub(to, from));
+}
+
+static void
+vrrp_log_trace(vrrp_rt * vrrp)
+{
+	vrrp_trace *t = &vrrp->trace;
+
+	log_message(LOG_INFO, "VRRP_Instance(%s) failover trace: cause=%s"
+			      " detect=%ldus addr=%ldus garp=%ldus notify=%ldus"
+			      " syncd=%ldus total=%ldus",
+	       vrrp->iname, vrrp_cause_name(t->cause),
+	       vrrp_trace_delta(t->last_adv, t->detect),
+	       vrrp_trace_delta(t->detect, t->addr),
+	       vrrp_trace_delta(t->detect, t->garp),
+	       vrrp_trace_delta(t->detect, t->notify),
+	       vrrp_trace_delta(t->detect, t->syncd),
+	       vrrp_trace_delta(t->detect, timer_now()));
+}
+
 /* becoming master */
 void
 vrrp_state_become_master(vrrp_rt * vrrp)
 {
+	TIMER_RESET(vrrp->trace.garp);
+	TIMER_RESET(vrrp->trace.syncd);
+
 	/* add the ip addresses */
 	if (!LIST_ISEMPTY(vrrp->vip))
 		vrrp_handle_ipaddress(vrrp, IPADDRESS_ADD, VRRP_VIP_TYPE);
@@ -623,18 +685,107 @@ vrrp_state_become_master(vrrp_rt * vrrp)
 	/* add virtual routes */
 	if (!LIST_ISEMPTY(vrrp->vroutes))
 		vrrp_handle_iproutes(vrrp, IPROUTE_ADD);
+	vrrp->trace.addr = timer_now();
 
 	/* remotes arp tables update */
 	vrrp_send_gratuitous_arp(vrrp);
 
 	/* Check if notify is needed */
 	notify_instance_exec(vrrp, VRRP_STATE_MAST);
+	vrrp->trace.notify = timer_now();
 
 #ifdef _HAVE_IPVS_SYNCD_
 	/* Check if sync daemon handling is needed */
-	if (vrrp->lvs_syncd_if)
+	if (vrrp->lvs_syncd_if) {
 		ipvs_syncd_master(vrrp->lvs_syncd_if, vrrp->vrid);
+		vrrp->trace.syncd = timer_now();
+	}
 #endif
+
+	vrrp_log_trace(vrrp);
+}
+
+const char *
+vrrp_state_name(int state)
+{
+	switch (state) {
+	case VRRP_STATE_INIT:
+		return "INIT";
+	case VRRP_STATE_BACK:
+		return "BACKUP";
+	case VRRP_STATE_MAST:
+		return "MASTER";
+	case VRRP_STATE_FAULT:
+		return "FAULT";
+	case VRRP_STATE_GOTO_MASTER:
+		return "GOTO_MASTER";
+	}
+	return "UNKNOWN";
+}
+
+const char *
+vrrp_cause_name(int cause)
+{
+	static const char *names[] = {
+		"startup", "reload", "timeout", "advert", "priority 0 advert",
+		"higher priority advert", "lower priority advert", "fault",
+		"recovery", "sync group"
+	};
+
+	if (cause < 0 || cause > VRRP_CAUSE_SYNC)
+		return "unknown";
+	return names[cause];
+}
+
+/*
+ * Account a state change into counters and the transition ring.
+ * Faults and fault recoveries are reported as such unless they are
+ * driven by the sync group.
+ */
+void
+vrrp_record_transition(vrrp_rt * vrrp, int state)
+{
+	vrrp_transition *t;
+	int cause = vrrp->cause;
+
+	if (state == vrrp->state)
+		return;
+
+	switch (state) {
+	case VRRP_STATE_MAST:
+		vrrp->stats.become_master++;
+		break;
+	case VRRP_STATE_BACK:
+		vrrp->stats.become_backup++;
+		break;
+	case VRRP_STATE_FAULT:
+		vrrp->stats.become_fault++;
+		break;
+	default:
+		/* INIT & GOTO_MASTER are not exposed */
+		return;
+	}
+	if (vrrp->state == VRRP_STATE_MAST)
+		vrrp->stats.release_master++;
+
+	if (cause != VRRP_CAUSE_SYNC) {
+		if (state == VRRP_STATE_FAULT)
+			cause = VRRP_CAUSE_FAULT;
+		else if (vrrp->state == VRRP_STATE_FAULT)
+			cause = VRRP_CAUSE_RECOVER;
+	}
+
+	t = &vrrp->history[vrrp->history_count++ % VRRP_HISTORY_SIZE];
+	t->time = timer_now();
+	t->from = vrrp->state;
+	t->to = state;
+	t->cause = cause;
+
+	/* Failover starts here, see vrrp_state_become_master() */
+	if (state == VRRP_STATE_MAST) {
+		vrrp->trace.detect = t->time;
+		vrrp->trace.cause = cause;
+	}
 }
 
 void
@@ -646,7 +797,7 @@ vrrp_state_goto_master(vrrp_rt * vrrp)
 	 */
 	vrrp_send_adv(vrrp, vrrp->effective_priority);
 
-	vrrp->state = VRRP_STATE_MAST;
+	vrrp_set_state(vrrp, VRRP_STATE_MAST);
 	log_message(LOG_INFO, "VRRP_Instance(%s) Transition to MASTER STATE",
 	       vrrp->iname);
 }
@@ -697,13 +848,13 @@ vrrp_state_leave_master(vrrp_rt * vrrp)
 	case VRRP_STATE_BACK:
 		log_message(LOG_INFO, "VRRP_Instance(%s) Entering BACKUP STATE", vrrp->iname);
 		vrrp_restore_interface(vrrp, 0);
-		vrrp->state = vrrp->wantstate;
+		vrrp_set_state(vrrp, vrrp->wantstate);
 		notify_instance_exec(vrrp, VRRP_STATE_BACK);
 		break;
 	case VRRP_STATE_GOTO_FAULT:
 		log_message(LOG_INFO, "VRRP_Instance(%s) Entering FAULT STATE", vrrp->iname);
 		vrrp_restore_interface(vrrp, 0);
-		vrrp->state = VRRP_STATE_FAULT;
+		vrrp_set_state(vrrp, VRRP_STATE_FAULT);
 		notify_instance_exec(vrrp, VRRP_STATE_FAULT);
 		break;
 	}
@@ -742,6 +893,7 @@ vrrp_state_backup(vrrp_rt * vrrp, char *buf, int buflen)
 		    3 * vrrp->adver_int + VRRP_TIMER_SKEW(vrrp);
 	} else if (hd->priority == 0) {
 		vrrp->ms_down_timer = VRRP_TIMER_SKEW(vrrp);
+		vrrp->cause = VRRP_CAUSE_PRIO_ZERO;
 	} else if (vrrp->nopreempt || hd->priority >= vrrp->effective_priority ||
 		   timer_cmp(vrrp->preempt_time, timer_now()) > 0) {
 		vrrp->ms_down_timer =
@@ -751,6 +903,7 @@ vrrp_state_backup(vrrp_rt * vrrp, char *buf, int buflen)
 		       "VRRP_Instance(%s) forcing a new MASTER election",
 		       vrrp->iname);
 		vrrp->wantstate = VRRP_STATE_GOTO_MASTER;
+		vrrp->cause = VRRP_CAUSE_LOWER_PRIO;
 		vrrp_send_adv(vrrp, vrrp->effective_priority);
 	}
 }
@@ -785,7 +938,7 @@ vrrp_state_master_rx(vrrp_rt * vrrp, char *buf, int buflen)
 	/* return on link failure */
 	if (vrrp->wantstate == VRRP_STATE_GOTO_FAULT) {
 		vrrp->ms_down_timer = 3 * vrrp->adver_int + VRRP_TIMER_SKEW(vrrp);
-		vrrp->state = VRRP_STATE_FAULT;
+		vrrp_set_state(vrrp, VRRP_STATE_FAULT);
 		notify_instance_exec(vrrp, VRRP_STATE_FAULT);
 		return 1;
 	}
@@ -845,7 +998,8 @@ vrrp_state_master_rx(vrrp_rt * vrrp, char *buf, int buflen)
 		vrrp->ms_down_timer =
 		    3 * vrrp->adver_int + VRRP_TIMER_SKEW(vrrp);
 		vrrp->wantstate = VRRP_STATE_BACK;
-		vrrp->state = VRRP_STATE_BACK;
+		vrrp->cause = VRRP_CAUSE_HIGHER_PRIO;
+		vrrp_set_state(vrrp, VRRP_STATE_BACK);
 		return 1;
 	}
 
@@ -907,13 +1061,13 @@ chk_min_cfg(vrrp_rt * vrrp)
 
 /* open a VRRP sending socket */
 int
-open_vrrp_send_socket(const int proto, const int idx)
+open_vrrp_send_socket(const int proto, interface * ifp)
 {
-	interface *ifp;
 	int fd = -1;
 
-	/* Retreive interface */
-	ifp = if_get_by_ifindex(idx);
+	/* Interface removed, wait for it to come back */
+	if (!ifp || !IF_INDEX(ifp))
+		return -1;
 
 	/* Create and init socket descriptor */
 	fd = socket(AF_INET, SOCK_RAW, proto);
@@ -934,13 +1088,13 @@ open_vrrp_send_socket(const int proto, const int idx)
 
 /* open a VRRP socket and join the multicast group. */
 int
-open_vrrp_socket(const int proto, const int idx)
+open_vrrp_socket(const int proto, interface * ifp)
 {
-	interface *ifp;
 	int fd = -1;
 
-	/* Retreive interface */
-	ifp = if_get_by_ifindex(idx);
+	/* Interface removed, wait for it to come back */
+	if (!ifp || !IF_INDEX(ifp))
+		return -1;
 
 	/* open the socket */
 	fd = socket(AF_INET, SOCK_RAW, proto);
@@ -952,7 +1106,7 @@ open_vrrp_socket(const int proto, const int idx)
 	}
 
 	/* Join the VRRP MCAST group */
-	if_join_vrrp_group(fd, ifp, proto);
+	fd = if_join_vrrp_group(fd, ifp, proto);
 
 	/* Bind inbound stream */
 	if_setsockopt_bindtodevice(fd, ifp);
@@ -977,8 +1131,9 @@ new_vrrp_socket(vrrp_rt * vrrp)
 	close_vrrp_socket(vrrp);
 	remove_vrrp_fd_bucket(vrrp);
 	proto = (vrrp->auth_type == VRRP_AUTH_AH) ? IPPROTO_IPSEC_AH : IPPROTO_VRRP;
-	vrrp->fd_in = open_vrrp_socket(proto, IF_INDEX(vrrp->ifp));
-	vrrp->fd_out = open_vrrp_send_socket(proto, IF_INDEX(vrrp->ifp));
+	vrrp->fd_in = open_vrrp_socket(proto, vrrp->ifp);
+	vrrp->fd_out = (vrrp->fd_in < 0) ? -1 :
+		       open_vrrp_send_socket(proto, vrrp->ifp);
 	alloc_vrrp_fd_bucket(vrrp);
 
 	/* Sync the other desc */
@@ -1026,7 +1181,7 @@ shutdown_vrrp_instances(void)
 static int
 vrrp_complete_instance(vrrp_rt * vrrp)
 {
-	vrrp->state = VRRP_STATE_INIT;
+	vrrp_set_state(vrrp, VRRP_STATE_INIT);
 	if (!vrrp->adver_int)
 		vrrp->adver_int = VRRP_ADVER_DFL * TIMER_HZ;
 	if (!vrrp->effective_priority)
@@ -1040,7 +1195,7 @@ vrrp_complete_init(void)
 {
 	list l;
 	element e;
-	vrrp_rt *vrrp;
+	vrrp_rt *vrrp, *owner;
 	vrrp_sgroup *sgroup;
 
 	/* Complete VRRP instance initialization */
@@ -1049,6 +1204,11 @@ vrrp_complete_init(void)
 		vrrp = ELEMENT_DATA(e);
 		if (!vrrp_complete_instance(vrrp))
 			return 0;
+		if ((owner = alloc_vrrp_ifvrid_bucket(vrrp)))
+			log_message(LOG_INFO, "VRRP_Instance(%s) virtual router id %d"
+					      " on %s already used by VRRP_Instance(%s)",
+			       vrrp->iname, vrrp->vrid, IF_NAME(vrrp->ifp),
+			       owner->iname);
 	}
 
 	/* Build synchronization group index */
@@ -1065,20 +1225,7 @@ vrrp_complete_init(void)
 static vrrp_rt *
 vrrp_exist(vrrp_rt * old_vrrp)
 {
-	element e;
-	list l = vrrp_data->vrrp;
-	vrrp_rt *vrrp;
-
-	if (LIST_ISEMPTY(l))
-		return NULL;
-
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-		if (!strcmp(vrrp->iname, old_vrrp->iname))
-			return vrrp;
-	}
-
-	return NULL;
+	return vrrp_index_lookup_name(old_vrrp->iname);
 }
 
 /* Clear VIP|EVIP not present into the new data */
@@ -1105,23 +1252,51 @@ reset_vrrp_state(vrrp_rt * old_vrrp)
 {
 	/* Keep VRRP state, ipsec AH seq_number */
 	vrrp_rt *vrrp = vrrp_exist(old_vrrp);
-	vrrp->state = old_vrrp->state;
 	vrrp->init_state = old_vrrp->state;
 	vrrp->wantstate = old_vrrp->state;
 	vrrp->effective_priority = old_vrrp->effective_priority;
 	memcpy(vrrp->ipsecah_counter, old_vrrp->ipsecah_counter, sizeof(seq_counter));
+	vrrp->cause = VRRP_CAUSE_RELOAD;
+
+	/*
+	 * Instance still speaking on the same socket : keep it running
+	 * with its timers rather than going through state init again.
+	 */
+	if (vrrp_index_lookup_ifvrid(IF_INDEX(old_vrrp->ifp),
+				     old_vrrp->vrid) == vrrp &&
+	    vrrp->auth_type == old_vrrp->auth_type &&
+	    (vrrp->base_priority != VRRP_PRIO_OWNER ||
+	     old_vrrp->state == VRRP_STATE_MAST)) {
+		vrrp_set_state(vrrp, old_vrrp->state);
+		vrrp->wantstate = old_vrrp->wantstate;
+		vrrp->sands = old_vrrp->sands;
+		vrrp->preempt_time = old_vrrp->preempt_time;
+		vrrp->reloaded = 1;
+		if (vrrp->sync && old_vrrp->sync)
+			vrrp->sync->state = old_vrrp->sync->state;
+	}
+
+	/* Counters & history survive the reload, carrying state is no transition */
+	vrrp->stats = old_vrrp->stats;
+	memcpy(vrrp->history, old_vrrp->history, sizeof(vrrp->history));
+	vrrp->history_count = old_vrrp->history_count;
+	vrrp->trace = old_vrrp->trace;
 
 #ifdef _HAVE_IPVS_SYNCD_
-	if (old_vrrp->lvs_syncd_if)
-		ipvs_syncd_cmd(IPVS_STOPDAEMON, NULL,
-			       (old_vrrp->state == VRRP_STATE_MAST) ? IPVS_MASTER:
-								      IPVS_BACKUP,
-			       old_vrrp->vrid);
-	if (vrrp->lvs_syncd_if)
-		ipvs_syncd_cmd(IPVS_STARTDAEMON, NULL,
-			       (vrrp->state == VRRP_STATE_MAST) ? IPVS_MASTER:
-								  IPVS_BACKUP,
-			       vrrp->vrid);
+	/* syncd keeps running if the instance kept its state & interface */
+	if (!vrrp->reloaded || !old_vrrp->lvs_syncd_if || !vrrp->lvs_syncd_if ||
+	    strcmp(old_vrrp->lvs_syncd_if, vrrp->lvs_syncd_if)) {
+		if (old_vrrp->lvs_syncd_if)
+			ipvs_syncd_cmd(IPVS_STOPDAEMON, NULL,
+				       (old_vrrp->state == VRRP_STATE_MAST) ? IPVS_MASTER:
+									      IPVS_BACKUP,
+				       old_vrrp->vrid);
+		if (vrrp->lvs_syncd_if)
+			ipvs_syncd_cmd(IPVS_STARTDAEMON, NULL,
+				       (old_vrrp->state == VRRP_STATE_MAST) ? IPVS_MASTER:
+									      IPVS_BACKUP,
+				       vrrp->vrid);
+	}
 #endif
 
 	/* Remember if we had vips up and add new ones if needed */
@@ -20,6 +20,9 @@
  * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
  */
 
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/mman.h>
 #include "vrrp_daemon.h"
 #include "vrrp_scheduler.h"
 #include "vrrp_if.h"
@@ -31,6 +34,9 @@
 #include "vrrp_data.h"
 #include "vrrp.h"
 #include "global_data.h"
+#include "track_shm.h"
+#include "ipc.h"
+#include "watchdog.h"
 #include "pidfile.h"
 #include "daemon.h"
 #include "logger.h"
@@ -60,8 +66,12 @@ stop_vrrp(void)
 
 	if (!(debug & 8))
 		shutdown_vrrp_instances();
+	if (debug & 32)
+		vrrp_dispatcher_dump_stats();
 	free_interface_queue();
 	gratuitous_arp_close();
+	track_shm_close();
+	ipc_close();
 
 	/* Stop daemon */
 	pidfile_rm(vrrp_pidfile);
@@ -88,6 +98,85 @@ stop_vrrp(void)
 	exit(0);
 }
 
+/* Touch stack pages so that advert path never faults on them */
+static void
+vrrp_prefault_stack(void)
+{
+	char stack[VRRP_PREFAULT_STACK];
+
+	memset(stack, 0, sizeof (stack));
+	/* Keep the stores, the buffer is never read */
+	__asm__ __volatile__("" : : "r"(stack) : "memory");
+}
+
+/*
+ * Realtime VRRP control plane. Adverts are sent and received from
+ * this process main loop, so scheduling latency and page faults
+ * directly delay them. Slow work (notify & track scripts) already
+ * runs in forked children which fall back to SCHED_OTHER.
+ */
+static void
+vrrp_set_realtime(void)
+{
+	static cpu_set_t startup_mask;
+	static int startup_saved;
+	struct sched_param param;
+	cpu_set_t mask;
+	element e;
+	int *cpu;
+
+	/* CPUs we were started on, restored if the affinity is dropped */
+	if (!startup_saved)
+		startup_saved = !sched_getaffinity(0, sizeof (startup_mask),
+						   &startup_mask);
+
+	if (!LIST_ISEMPTY(data->vrrp_cpu_affinity)) {
+		CPU_ZERO(&mask);
+		for (e = LIST_HEAD(data->vrrp_cpu_affinity); e; ELEMENT_NEXT(e)) {
+			cpu = ELEMENT_DATA(e);
+			if (*cpu >= 0 && *cpu < CPU_SETSIZE)
+				CPU_SET(*cpu, &mask);
+		}
+		if (sched_setaffinity(0, sizeof (mask), &mask) < 0)
+			log_message(LOG_INFO, "VRRP: cannot set CPU affinity (%s)",
+			       strerror(errno));
+	} else if (startup_saved)
+		sched_setaffinity(0, sizeof (startup_mask), &startup_mask);
+
+	if (data->vrrp_no_swap || data->vrrp_rt_priority) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+			log_message(LOG_INFO, "VRRP: cannot lock memory (%s)",
+			       strerror(errno));
+		vrrp_prefault_stack();
+	} else
+		munlockall();
+
+	memset(&param, 0, sizeof (param));
+	if (!data->vrrp_rt_priority) {
+		/* Realtime mode may have been dropped on reload */
+		if (sched_getscheduler(0) == SCHED_FIFO)
+			sched_setscheduler(0, SCHED_OTHER, &param);
+		return;
+	}
+
+	param.sched_priority = data->vrrp_rt_priority;
+#ifdef SCHED_RESET_ON_FORK
+	/* Scripts and notifiers must not inherit realtime priority */
+	if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) == 0) {
+		log_message(LOG_INFO, "VRRP: using SCHED_FIFO priority %d",
+		       data->vrrp_rt_priority);
+		return;
+	}
+#endif
+	if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+		log_message(LOG_INFO, "VRRP: cannot set SCHED_FIFO priority %d (%s)",
+		       data->vrrp_rt_priority, strerror(errno));
+	else
+		log_message(LOG_INFO, "VRRP: using SCHED_FIFO priority %d,"
+				      " forked scripts inherit it",
+		       data->vrrp_rt_priority);
+}
+
 /* Daemon init sequence */
 static void
 start_vrrp(void)
@@ -110,13 +199,9 @@ start_vrrp(void)
 		stop_vrrp();
 		return;
 	}
-
-	if (reload) {
-		clear_diff_saddresses();
-		clear_diff_sroutes();
-		clear_diff_vrrp();
-		clear_diff_script();
-	}
+	kernel_netlink_set_rcvbuf(data->netlink_rcvbuf);
+	if (data->track_shm_file)
+		track_shm_open(data->track_shm_file);
 
 	/* Complete VRRP initialization */
 	if (!vrrp_complete_init()) {
@@ -140,9 +225,19 @@ start_vrrp(void)
 	/* Initialize linkbeat */
 	init_interface_linkbeat();
 
+	/* Realtime control plane if configured */
+	vrrp_set_realtime();
+
+	/* LVS service states from the healthcheck child */
+	ipc_open(IPC_VRRP, vrrp_ipc_handler, vrrp_ipc_resync);
+	vrrp_ipc_resync();
+
 	/* Init & start the VRRP packet dispatcher */
 	thread_add_event(master, vrrp_dispatcher_init, NULL,
 			 VRRP_DISPATCHER);
+
+	/* Heartbeat to the parent */
+	wdog_start();
 }
 
 /* Reload handler */
@@ -152,6 +247,7 @@ sighup_vrrp(void *v, int sig)
 {
 	log_message(LOG_INFO, "Reloading VRRP child process(%d) on signal",
 		    getpid());
+	wdog_hold();
 	thread_add_event(master, reload_vrrp_thread, NULL, 0);
 }
 
@@ -160,10 +256,27 @@ void
 sigend_vrrp(void *v, int sig)
 {
 	log_message(LOG_INFO, "Terminating VRRP child process on signal");
+	wdog_hold();
 	if (master)
 		thread_add_terminate_event(master);
 }
 
+/* Stats dump handler */
+static int
+print_vrrp_stats(thread * thread_obj)
+{
+	vrrp_print_stats();
+	return 0;
+}
+
+void
+sigusr2_vrrp(void *v, int sig)
+{
+	log_message(LOG_INFO, "Printing VRRP stats for process(%d) on signal",
+		    getpid());
+	thread_add_event(master, print_vrrp_stats, NULL, 0);
+}
+
 /* VRRP Child signal handling */
 void
 vrrp_signal_init(void)
@@ -172,48 +285,80 @@ vrrp_signal_init(void)
 	signal_set(SIGHUP, sighup_vrrp, NULL);
 	signal_set(SIGINT, sigend_vrrp, NULL);
 	signal_set(SIGTERM, sigend_vrrp, NULL);
+	signal_set(SIGUSR2, sigusr2_vrrp, NULL);
 	signal_ignore(SIGPIPE);
 }
 
-/* Reload thread */
+/*
+ * Reload thread. The new configuration is built next to the running
+ * one and only the differences are applied. Interfaces, netlink
+ * channels and VRRP sockets are kept, so instances present in both
+ * configurations go on sending and receiving adverts.
+ */
 int
 reload_vrrp_thread(thread * thread_obj)
 {
+	conf_data *old_data = data;
+
 	/* set the reloading flag */
 	SET_RELOAD;
 
-	/* Close sockpool */
-	free_vrrp_sockpool(vrrp_data);
-
-	/* Signal handling */
-	signal_reset();
-	signal_handler_destroy();
-
-	/* Destroy master thread */
-	thread_destroy_master(master);
-	master = thread_make_master();
-	free_global_data(data);
-	free_interface_queue();
-	free_vrrp_buffer();
-	gratuitous_arp_close();
-
-	/* Save previous conf data */
+	/* Parse the new conf next to the running one */
 	old_vrrp_data = vrrp_data;
-	vrrp_data = NULL;
+	data = alloc_global_data();
+	vrrp_data = alloc_vrrp_data();
+	init_data(conf_file, vrrp_init_keywords);
+	if (!vrrp_data || !vrrp_complete_init()) {
+		log_message(LOG_INFO, "VRRP: invalid configuration, keeping"
+				      " running one");
+		if (vrrp_data) {
+			free_vrrp_sockpool(vrrp_data);
+			free_vrrp_data(vrrp_data);
+		}
+		free_global_data(data);
+		data = old_data;
+		vrrp_data = old_vrrp_data;
+		old_vrrp_data = NULL;
+		UNSET_RELOAD;
+		return 0;
+	}
+	kernel_netlink_set_rcvbuf(data->netlink_rcvbuf);
+	if (data->track_shm_file)
+		track_shm_open(data->track_shm_file);
+	else
+		track_shm_close();
+	if (data->linkbeat_use_polling != old_data->linkbeat_use_polling)
+		log_message(LOG_INFO, "VRRP: linkbeat_use_polling change needs"
+				      " a restart to be applied");
+
+	/* Stop threads working on the old conf */
+	vrrp_dispatcher_cancel();
+
+	/* Apply differences */
+	clear_diff_saddresses();
+	clear_diff_sroutes();
+	clear_diff_vrrp();
+	clear_diff_script();
+	netlink_iplist_ipv4(vrrp_data->static_addresses, IPADDRESS_ADD);
+	netlink_rtlist_ipv4(vrrp_data->static_routes, IPROUTE_ADD);
 
-#ifdef _WITH_LVS_
-	/* Clean ipvs related */
-	ipvs_stop();
-#endif
+	log_message(LOG_INFO, "Configuration is using : %lu Bytes", mem_allocated);
+	if (debug & 4) {
+		dump_global_data(data);
+		dump_vrrp_data(vrrp_data);
+	}
 
-	/* Reload the conf */
-	mem_allocated = 0;
-	vrrp_signal_init();
-	signal_set(SIGCHLD, thread_child_handler, master);
-	start_vrrp();
+	/* Restart the dispatcher, keeping sockets in use */
+	if_reset_tracking();
+	vrrp_dispatcher_reload(old_vrrp_data);
+	vrrp_set_realtime();
+	vrrp_ipc_resync();
 
-	/* free backup data */
+	/* free backup data, closing sockets no longer used */
+	free_vrrp_sockpool(old_vrrp_data);
 	free_vrrp_data(old_vrrp_data);
+	free_global_data(old_data);
+	old_vrrp_data = NULL;
 	UNSET_RELOAD;
 
 	return 0;
@@ -250,6 +395,7 @@ start_vrrp_child(void)
 	int ret;
 
 	/* Initialize child process */
+	wdog_prefork(WDOG_CHILD_VRRP);
 	pid = fork();
 
 	if (pid < 0) {
@@ -261,9 +407,10 @@ start_vrrp_child(void)
 		log_message(LOG_INFO, "Starting VRRP child process, pid=%d"
 			       , pid);
 
-		/* Start respawning thread */
+		/* Start respawning and heartbeat threads */
 		thread_add_child(master, vrrp_respawn_thread, NULL,
 				 pid, RESPAWN_TIMER);
+		wdog_parent(WDOG_CHILD_VRRP, pid);
 		return 0;
 	}
 
@@ -282,6 +429,7 @@ start_vrrp_child(void)
 	signal_handler_destroy();
 	thread_destroy_master(master);
 	master = thread_make_master();
+	wdog_child(WDOG_CHILD_VRRP);
 
 	/* change to / dir */
 	ret = chdir("/");
@@ -20,14 +20,18 @@
  * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
  */
 
+#include <unistd.h>
 #include "vrrp_data.h"
 #include "vrrp_index.h"
 #include "vrrp_sync.h"
 #include "vrrp_if.h"
+#include "vrrp_netlink.h"
 #include "vrrp.h"
+#include "track_shm.h"
 #include "memory.h"
 #include "utils.h"
 #include "logger.h"
+#include "signals.h"
 
 /* global vars */
 vrrp_conf_data *vrrp_data = NULL;
@@ -103,6 +107,8 @@ free_vscript(void *data)
 
 	FREE(vscript->sname);
 	FREE_PTR(vscript->script);
+	FREE_PTR(vscript->shm_slot);
+	free_list(vscript->tracking_vrrp);
 	FREE(vscript);
 }
 static void
@@ -112,7 +118,10 @@ dump_vscript(void *data)
 	char *str;
 
 	log_message(LOG_INFO, " VRRP Script = %s", vscript->sname);
-	log_message(LOG_INFO, "   Command = %s", vscript->script);
+	if (vscript->shm_slot)
+		log_message(LOG_INFO, "   Feed slot = %s", vscript->shm_slot);
+	else
+		log_message(LOG_INFO, "   Command = %s", vscript->script);
 	log_message(LOG_INFO, "   Interval = %d sec", vscript->interval / TIMER_HZ);
 	log_message(LOG_INFO, "   Weight = %d", vscript->weight);
 	log_message(LOG_INFO, "   Rise = %d", vscript->rise);
@@ -183,6 +192,11 @@ free_vrrp(void *data)
 			FREE(ELEMENT_DATA(e));
 	free_list(vrrp->track_script);
 
+	if (!LIST_ISEMPTY(vrrp->track_svc))
+		for (e = LIST_HEAD(vrrp->track_svc); e; ELEMENT_NEXT(e))
+			FREE(ELEMENT_DATA(e));
+	free_list(vrrp->track_svc);
+
 	free_list(vrrp->vip);
 	free_list(vrrp->evip);
 	free_list(vrrp->vroutes);
@@ -234,6 +248,11 @@ dump_vrrp(void *data)
 		       LIST_SIZE(vrrp->track_script));
 		dump_list(vrrp->track_script);
 	}
+	if (!LIST_ISEMPTY(vrrp->track_svc)) {
+		log_message(LOG_INFO, "   Tracked LVS services = %d",
+		       LIST_SIZE(vrrp->track_svc));
+		dump_list(vrrp->track_svc);
+	}
 	if (!LIST_ISEMPTY(vrrp->vip)) {
 		log_message(LOG_INFO, "   Virtual IP = %d", LIST_SIZE(vrrp->vip));
 		dump_list(vrrp->vip);
@@ -263,6 +282,115 @@ dump_vrrp(void *data)
 		       vrrp->script);
 	if (vrrp->smtp_alert)
 		log_message(LOG_INFO, "   Using smtp notification");
+	log_message(LOG_INFO, "   Adverts sent = %lu, received = %lu, errors = %lu",
+	       vrrp->stats.adv_sent, vrrp->stats.adv_rcvd,
+	       vrrp->stats.packet_ko + vrrp->stats.packet_drop);
+	log_message(LOG_INFO, "   Became MASTER = %lu, BACKUP = %lu, FAULT = %lu",
+	       vrrp->stats.become_master, vrrp->stats.become_backup,
+	       vrrp->stats.become_fault);
+}
+
+/* Instances counters & transition history, dumped on SIGUSR2 */
+static void
+vrrp_print_instance_stats(FILE * fp, vrrp_rt * vrrp)
+{
+	vrrp_stats *st = &vrrp->stats;
+	vrrp_transition *t;
+	TIMEVAL now = timer_now();
+	unsigned int i, first;
+
+	fprintf(fp, "VRRP Instance: %s\n", vrrp->iname);
+	fprintf(fp, "  State: %s\n", vrrp_state_name(vrrp->state));
+	fprintf(fp, "  Advertisements:\n");
+	fprintf(fp, "    Sent: %lu\n", st->adv_sent);
+	fprintf(fp, "    Received: %lu\n", st->adv_rcvd);
+	fprintf(fp, "  Priority Zero:\n");
+	fprintf(fp, "    Sent: %lu\n", st->pri_zero_sent);
+	fprintf(fp, "    Received: %lu\n", st->pri_zero_rcvd);
+	fprintf(fp, "  Packet Errors:\n");
+	fprintf(fp, "    Invalid: %lu\n", st->packet_ko);
+	fprintf(fp, "    Dropped: %lu\n", st->packet_drop);
+	fprintf(fp, "    Null read: %lu\n", st->packet_null);
+	fprintf(fp, "    TTL: %lu\n", st->ttl_err);
+	fprintf(fp, "    Version: %lu\n", st->version_err);
+	fprintf(fp, "    Length: %lu\n", st->length_err);
+	fprintf(fp, "    Checksum: %lu\n", st->checksum_err);
+	fprintf(fp, "    Auth type: %lu\n", st->auth_type_err);
+	fprintf(fp, "    Auth: %lu\n", st->auth_err);
+	fprintf(fp, "    VRID: %lu\n", st->vrid_err);
+	fprintf(fp, "    Address list: %lu\n", st->addr_list_err);
+	fprintf(fp, "    Advert interval: %lu\n", st->interval_err);
+	fprintf(fp, "  Became master: %lu\n", st->become_master);
+	fprintf(fp, "  Released master: %lu\n", st->release_master);
+	fprintf(fp, "  Became backup: %lu\n", st->become_backup);
+	fprintf(fp, "  Became fault: %lu\n", st->become_fault);
+
+	if (!TIMER_ISNULL(vrrp->trace.detect)) {
+		vrrp_trace *tr = &vrrp->trace;
+
+		fprintf(fp, "  Last failover (%s):\n", vrrp_cause_name(tr->cause));
+		fprintf(fp, "    Detection: %ldus\n",
+			vrrp_trace_delta(tr->last_adv, tr->detect));
+		fprintf(fp, "    Addresses: +%ldus\n",
+			vrrp_trace_delta(tr->detect, tr->addr));
+		fprintf(fp, "    First GARP: +%ldus\n",
+			vrrp_trace_delta(tr->detect, tr->garp));
+		fprintf(fp, "    Scripts: +%ldus\n",
+			vrrp_trace_delta(tr->detect, tr->notify));
+		fprintf(fp, "    Syncd: +%ldus\n",
+			vrrp_trace_delta(tr->detect, tr->syncd));
+	}
+
+	if (!vrrp->history_count)
+		return;
+	fprintf(fp, "  Transitions (last %d):\n", VRRP_HISTORY_SIZE);
+	first = (vrrp->history_count > VRRP_HISTORY_SIZE) ?
+		vrrp->history_count - VRRP_HISTORY_SIZE : 0;
+	for (i = first; i < vrrp->history_count; i++) {
+		t = &vrrp->history[i % VRRP_HISTORY_SIZE];
+		fprintf(fp, "    %lu.%06lus ago: %s -> %s (%s)\n",
+			(unsigned long) timer_sub(now, t->time).tv_sec,
+			(unsigned long) timer_sub(now, t->time).tv_usec,
+			vrrp_state_name(t->from), vrrp_state_name(t->to),
+			vrrp_cause_name(t->cause));
+	}
+}
+
+/*
+ * The counters are written by a forked copy of this process, so the
+ * dispatcher only pays for the fork, never for the file I/O.
+ */
+void
+vrrp_print_stats(void)
+{
+	FILE *fp;
+	element e;
+	list l = vrrp_data->vrrp;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0) {
+		log_message(LOG_INFO, "Can't fork VRRP stats writer (%m)");
+		return;
+	}
+	if (pid)
+		return;
+
+	/* Reaped by the dispatcher SIGCHLD handler */
+	signal_handler_destroy();
+	fp = fopen_report(VRRP_STATS_FILE);
+	if (!fp) {
+		log_message(LOG_INFO, "Can't open %s (%m)", VRRP_STATS_FILE);
+		_exit(1);
+	}
+
+	fprintf(fp, "Netlink reflector:\n");
+	fprintf(fp, "  Overruns: %lu\n", netlink_stats.overrun);
+	fprintf(fp, "  Resyncs: %lu\n", netlink_stats.resync);
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e))
+		vrrp_print_instance_stats(fp, ELEMENT_DATA(e));
+	fclose(fp);
+	_exit(0);
 }
 
 void
@@ -302,6 +430,7 @@ alloc_vrrp(char *iname)
 	memcpy(new->iname, iname, size);
 
 	list_add(vrrp_data->vrrp, new);
+	alloc_vrrp_name_bucket(new);
 }
 
 void
@@ -324,6 +453,26 @@ alloc_vrrp_track_script(vector strvec)
 	alloc_track_script(vrrp->track_script, strvec);
 }
 
+void
+alloc_vrrp_track_vs(vector strvec)
+{
+	vrrp_rt *vrrp = LIST_TAIL_DATA(vrrp_data->vrrp);
+
+	if (LIST_ISEMPTY(vrrp->track_svc))
+		vrrp->track_svc = alloc_list(NULL, dump_track_svc);
+	alloc_track_vs(vrrp->track_svc, strvec);
+}
+
+void
+alloc_vrrp_track_rs(vector strvec)
+{
+	vrrp_rt *vrrp = LIST_TAIL_DATA(vrrp_data->vrrp);
+
+	if (LIST_ISEMPTY(vrrp->track_svc))
+		vrrp->track_svc = alloc_list(NULL, dump_track_svc);
+	alloc_track_rs(vrrp->track_svc, strvec);
+}
+
 void
 alloc_vrrp_vip(vector strvec)
 {
@@ -372,6 +521,8 @@ alloc_vrrp_script(char *sname)
 	new->inuse = 0;
 	new->rise = 1;
 	new->fall = 1;
+	new->shm_index = -1;
+	new->shm_gen = TRACK_SHM_NOGEN;
 	list_add(vrrp_data->vrrp_script, new);
 }
 
@@ -397,8 +548,11 @@ alloc_vrrp_data(void)
 	new->vrrp = alloc_list(free_vrrp, dump_vrrp);
 	new->vrrp_index = alloc_mlist(NULL, NULL, 255+1);
 	new->vrrp_index_fd = alloc_mlist(NULL, NULL, 1024+1);
+	new->vrrp_index_name = alloc_mlist(NULL, NULL, VRRP_NAME_HASH_SIZE);
+	new->vrrp_index_ifvrid = alloc_mlist(NULL, NULL, VRRP_IFVRID_HASH_SIZE);
 	new->vrrp_sync_group = alloc_list(free_vgroup, dump_vgroup);
 	new->vrrp_script = alloc_list(free_vscript, dump_vscript);
+	new->vrrp_svc = alloc_list(free_vsvc, dump_vsvc);
 	new->vrrp_socket_pool = alloc_list(free_sock, dump_sock);
 
 	return new;
@@ -411,9 +565,12 @@ free_vrrp_data(vrrp_conf_data * vrrp_data_obj)
 	free_list(vrrp_data_obj->static_routes);
 	free_mlist(vrrp_data_obj->vrrp_index, 255+1);
 	free_mlist(vrrp_data_obj->vrrp_index_fd, 1024+1);
+	free_mlist(vrrp_data_obj->vrrp_index_name, VRRP_NAME_HASH_SIZE);
+	free_mlist(vrrp_data_obj->vrrp_index_ifvrid, VRRP_IFVRID_HASH_SIZE);
 	free_list(vrrp_data_obj->vrrp);
 	free_list(vrrp_data_obj->vrrp_sync_group);
 	free_list(vrrp_data_obj->vrrp_script);
+	free_list(vrrp_data_obj->vrrp_svc);
 //	free_list(vrrp_data_obj->vrrp_socket_pool);
 	FREE(vrrp_data_obj);
 }
@@ -57,9 +57,24 @@ typedef __uint8_t u8;
 #include "logger.h"
 
 /* Global vars */
-static list if_queue;
+static list if_index_hash;	/* interfaces by ifindex */
+static list if_name_hash;	/* interfaces by name, owns them */
 static struct ifreq ifr;
 
+/* Hash table helpers */
+#define IF_INDEX_BUCKET(I)	(&if_index_hash[(I) % IF_HASH_SIZE])
+#define IF_NAME_BUCKET(N)	(&if_name_hash[if_name_hash_key(N)])
+
+static unsigned int
+if_name_hash_key(const char *ifname)
+{
+	unsigned int key = 0;
+
+	while (*ifname)
+		key = key * 31 + (unsigned char) *ifname++;
+	return key % IF_HASH_SIZE;
+}
+
 /* Helper functions */
 /* Return interface from interface index */
 interface *
@@ -68,10 +83,10 @@ if_get_by_ifindex(const int ifindex)
 	interface *ifp;
 	element e;
 
-	if (LIST_ISEMPTY(if_queue))
+	if (!if_index_hash)
 		return NULL;
 
-	for (e = LIST_HEAD(if_queue); e; ELEMENT_NEXT(e)) {
+	for (e = LIST_HEAD(IF_INDEX_BUCKET(ifindex)); e; ELEMENT_NEXT(e)) {
 		ifp = ELEMENT_DATA(e);
 		if (ifp->ifindex == ifindex)
 			return ifp;
@@ -79,26 +94,49 @@ if_get_by_ifindex(const int ifindex)
 	return NULL;
 }
 
+/* Return interface from interface name without side effect */
 interface *
-if_get_by_ifname(const char *ifname)
+if_lookup_by_ifname(const char *ifname)
 {
 	interface *ifp;
 	element e;
 
-	if (LIST_ISEMPTY(if_queue)) {
-		log_message(LOG_ERR, "Interface queue is empty");
+	if (!if_name_hash)
 		return NULL;
-	}
 
-	for (e = LIST_HEAD(if_queue); e; ELEMENT_NEXT(e)) {
+	for (e = LIST_HEAD(IF_NAME_BUCKET(ifname)); e; ELEMENT_NEXT(e)) {
 		ifp = ELEMENT_DATA(e);
 		if (!strcmp(ifp->ifname, ifname))
 			return ifp;
 	}
-	log_message(LOG_ERR, "No such interface, %s", ifname);
 	return NULL;
 }
 
+/*
+ * Configuration lookup. Returned interface is pinned: configuration
+ * keeps pointers on it, so it survives RTM_DELLINK and is re-indexed
+ * if an interface with the same name shows up again.
+ */
+interface *
+if_get_by_ifname(const char *ifname)
+{
+	interface *ifp;
+
+	if (!if_name_hash) {
+		log_message(LOG_ERR, "Interface queue is empty");
+		return NULL;
+	}
+
+	ifp = if_lookup_by_ifname(ifname);
+	if (!ifp) {
+		log_message(LOG_ERR, "No such interface, %s", ifname);
+		return NULL;
+	}
+
+	ifp->pinned = 1;
+	return ifp;
+}
+
 /* MII Transceiver Registers poller functions */
 static int
 if_mii_read(const int fd, const int phy_id, int location)
@@ -257,7 +295,10 @@ if_ioctl_flags(interface * ifp)
 static void
 free_if(void *data)
 {
-	FREE(data);
+	interface *ifp = data;
+
+	free_list(ifp->tracking_vrrp);
+	FREE(ifp);
 }
 
 void
@@ -300,7 +341,9 @@ dump_if(void *if_data_obj)
 	}
 
 	/* MII channel supported ? */
-	if (IF_MII_SUPPORTED(ifp))
+	if (IF_NETLINK_SUPPORTED(ifp))
+		log_message(LOG_INFO, " NIC carrier reported by netlink");
+	else if (IF_MII_SUPPORTED(ifp))
 		log_message(LOG_INFO, " NIC support MII regs");
 	else if (IF_ETHTOOL_SUPPORTED(ifp))
 		log_message(LOG_INFO, " NIC support EHTTOOL GLINK interface");
@@ -311,19 +354,67 @@ dump_if(void *if_data_obj)
 static void
 init_if_queue(void)
 {
-	if_queue = alloc_list(free_if, dump_if);
+	if_index_hash = alloc_mlist(NULL, NULL, IF_HASH_SIZE);
+	if_name_hash = alloc_mlist(free_if, dump_if, IF_HASH_SIZE);
 }
 
 void
 if_add_queue(interface * ifp)
 {
-	list_add(if_queue, ifp);
+	list_add(IF_NAME_BUCKET(ifp->ifname), ifp);
+	if (ifp->ifindex)
+		list_add(IF_INDEX_BUCKET(ifp->ifindex), ifp);
+}
+
+/* Re-index an interface on ifindex and/or name change */
+void
+if_rehash_queue(interface * ifp, const int ifindex, const char *ifname)
+{
+	if (ifp->ifindex != ifindex) {
+		if (ifp->ifindex)
+			list_del(IF_INDEX_BUCKET(ifp->ifindex), ifp);
+		ifp->ifindex = ifindex;
+		if (ifindex)
+			list_add(IF_INDEX_BUCKET(ifindex), ifp);
+	}
+
+	if (strcmp(ifp->ifname, ifname)) {
+		list_del(IF_NAME_BUCKET(ifp->ifname), ifp);
+		memset(ifp->ifname, 0, sizeof (ifp->ifname));
+		strncpy(ifp->ifname, ifname, IF_NAMESIZ);
+		list_add(IF_NAME_BUCKET(ifp->ifname), ifp);
+	}
+}
+
+/*
+ * Kernel removed an interface. Pinned interfaces are kept, marked
+ * down and unindexed so the ifindex can be reused, 1 is returned.
+ * Others are released and 0 is returned.
+ */
+int
+if_del_queue(interface * ifp)
+{
+	if (ifp->pinned) {
+		if_rehash_queue(ifp, 0, ifp->ifname);
+		ifp->flags = 0;
+		ifp->linkbeat = 0;
+		return 1;
+	}
+
+	if (ifp->lb_thread)
+		thread_cancel(ifp->lb_thread);
+	if (ifp->ifindex)
+		list_del(IF_INDEX_BUCKET(ifp->ifindex), ifp);
+	list_del(IF_NAME_BUCKET(ifp->ifname), ifp);
+	free_if(ifp);
+	return 0;
 }
 
 static int
 if_linkbeat_refresh_thread(thread * thread_obj)
 {
 	interface *ifp = THREAD_ARG(thread_obj);
+	int was_up = IF_ISUP(ifp);
 
 	if (IF_MII_SUPPORTED(ifp))
 		ifp->linkbeat = (if_mii_probe(ifp->ifname)) ? 1 : 0;
@@ -338,36 +429,103 @@ if_linkbeat_refresh_thread(thread * thread_obj)
 	 */
 	if_ioctl_flags(ifp);
 
+	/* Push link state change to tracking instances */
+	vrrp_track_if_update(ifp, was_up);
+
 	/* Register next polling thread */
-	thread_add_timer(master, if_linkbeat_refresh_thread, ifp, POLLING_DELAY);
+	ifp->lb_thread = thread_add_timer(master, if_linkbeat_refresh_thread,
+					  ifp, POLLING_DELAY);
 	return 0;
 }
 
-static void
-init_if_linkbeat(void)
+/*
+ * Netlink resync: interfaces not reported by the link dump of
+ * generation gen are gone, release or mark them down.
+ */
+void
+if_resync_purge(unsigned int gen)
 {
 	interface *ifp;
-	element e;
+	element e, next;
+	int i, was_up;
+
+	for (i = 0; i < IF_HASH_SIZE; i++) {
+		for (e = LIST_HEAD(&if_name_hash[i]); e; e = next) {
+			next = e->next;
+			ifp = ELEMENT_DATA(e);
+			if (!ifp->ifindex || ifp->nl_gen == gen)
+				continue;
+
+			log_message(LOG_INFO, "Netlink: interface %s vanished",
+				    IF_NAME(ifp));
+			was_up = IF_ISUP(ifp);
+			if (if_del_queue(ifp))
+				vrrp_track_if_update(ifp, was_up);
+		}
+	}
+}
+
+/* Select interface linkbeat source, returns 1 if polling is needed */
+static int
+init_if_linkbeat_type(interface * ifp)
+{
 	int status;
 
-	for (e = LIST_HEAD(if_queue); e; ELEMENT_NEXT(e)) {
-		ifp = ELEMENT_DATA(e);
-		ifp->lb_type = LB_IOCTL;
-		status = if_mii_probe(ifp->ifname);
+	/*
+	 * If the driver reports carrier, link state is tracked from
+	 * IFF_LOWER_UP by the netlink reflector and no polling is
+	 * needed.
+	 */
+	if (ifp->operstate != OPER_UNKNOWN) {
+		ifp->lb_type = LB_NETLINK;
+		ifp->linkbeat = (ifp->flags & IFF_LOWER_UP) ? 1 : 0;
+		return 0;
+	}
+
+	ifp->lb_type = LB_IOCTL;
+	status = if_mii_probe(ifp->ifname);
+	if (status >= 0) {
+		ifp->lb_type = LB_MII;
+		ifp->linkbeat = (status) ? 1 : 0;
+	} else {
+		status = if_ethtool_probe(ifp->ifname);
 		if (status >= 0) {
-			ifp->lb_type = LB_MII;
+			ifp->lb_type = LB_ETHTOOL;
 			ifp->linkbeat = (status) ? 1 : 0;
-		} else {
-			status = if_ethtool_probe(ifp->ifname);
-			if (status >= 0) {
-				ifp->lb_type = LB_ETHTOOL;
-				ifp->linkbeat = (status) ? 1 : 0;
-			}
 		}
+	}
+
+	/* Register new monitor thread */
+	ifp->lb_thread = thread_add_timer(master, if_linkbeat_refresh_thread,
+					  ifp, POLLING_DELAY);
+	return 1;
+}
+
+static void
+init_if_linkbeat(void)
+{
+	interface *ifp;
+	element e;
+	int i, polled = 0;
 
-		/* Register new monitor thread */
-		thread_add_timer(master, if_linkbeat_refresh_thread, ifp, POLLING_DELAY);
+	for (i = 0; i < IF_HASH_SIZE; i++) {
+		for (e = LIST_HEAD(&if_name_hash[i]); e; ELEMENT_NEXT(e)) {
+			ifp = ELEMENT_DATA(e);
+			polled += init_if_linkbeat_type(ifp);
+		}
 	}
+
+	if (polled)
+		log_message(LOG_INFO, "Using MII-BMSR NIC polling thread for %d"
+				      " interface(s) not reporting carrier", polled);
+}
+
+/* Linkbeat setup for an interface created at runtime */
+void
+if_linkbeat_add(interface * ifp)
+{
+	if (data->linkbeat_use_polling)
+		init_if_linkbeat_type(ifp);
 }
 
 int
@@ -376,7 +534,8 @@ if_linkbeat(const interface * ifp)
 	if (!data->linkbeat_use_polling)
 		return 1;
 
-	if (IF_MII_SUPPORTED(ifp) || IF_ETHTOOL_SUPPORTED(ifp))
+	if (IF_NETLINK_SUPPORTED(ifp) || IF_MII_SUPPORTED(ifp) ||
+	    IF_ETHTOOL_SUPPORTED(ifp))
 		return IF_LINKBEAT(ifp);
 
 	return 1;
@@ -386,17 +545,35 @@ if_linkbeat(const interface * ifp)
 void
 free_interface_queue(void)
 {
-	if (!LIST_ISEMPTY(if_queue))
-		free_list(if_queue);
-	if_queue = NULL;
+	free_mlist(if_index_hash, IF_HASH_SIZE);
+	free_mlist(if_name_hash, IF_HASH_SIZE);
+	if_index_hash = NULL;
+	if_name_hash = NULL;
 	kernel_netlink_close();
 }
 
+/* Forget instances tracking interfaces, they are rebuilt on reload */
+void
+if_reset_tracking(void)
+{
+	interface *ifp;
+	element e;
+	int i;
+
+	for (i = 0; i < IF_HASH_SIZE; i++) {
+		for (e = LIST_HEAD(&if_name_hash[i]); e; ELEMENT_NEXT(e)) {
+			ifp = ELEMENT_DATA(e);
+			free_list(ifp->tracking_vrrp);
+			ifp->tracking_vrrp = NULL;
+		}
+	}
+}
+
 void
 init_interface_queue(void)
 {
 	init_if_queue();
-//	dump_list(if_queue);
+//	dump_mlist(if_name_hash, IF_HASH_SIZE);
 	netlink_interface_lookup();
 }
 
@@ -404,7 +581,8 @@ void
 init_interface_linkbeat(void)
 {
 	if (data->linkbeat_use_polling) {
-		log_message(LOG_INFO, "Using MII-BMSR NIC polling thread...");
+		log_message(LOG_INFO, "Using LinkWatch kernel netlink reflector"
+				      " for NIC carrier...");
 		init_if_linkbeat();
 	} else {
 		log_message(LOG_INFO, "Using LinkWatch kernel netlink reflector...");
@@ -449,9 +627,15 @@ if_leave_vrrp_group(int sd, interface *ifp)
 	int ret = 0;
 
 	/* If fd is -1 then we add a membership trouble */
-	if (sd < 0 || !ifp)
+	if (sd < 0)
 		return;
 
+	/* Interface gone, so is the membership */
+	if (!ifp || !IF_INDEX(ifp)) {
+		close(sd);
+		return;
+	}
+
 	/* Leaving the VRRP multicast group */
 	memset(&req_add, 0, sizeof (req_add));
 	req_add.imr_multiaddr.s_addr = htonl(INADDR_VRRP_GROUP);
@@ -462,7 +646,6 @@ if_leave_vrrp_group(int sd, interface *ifp)
 	if (ret < 0) {
 		log_message(LOG_INFO, "cant do IP_DROP_MEMBERSHIP errno=%s (%d)",
 		       strerror(errno), errno);
-		return;
 	}
 
 	/* Finally close the desc */
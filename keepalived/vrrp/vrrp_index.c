@@ -98,3 +98,66 @@ void set_vrrp_fd_bucket(int old_fd, vrrp_rt *vrrp)
 		}
 	}
 }
+
+/* Instance name hash table */
+static int
+vrrp_name_hash_key(const char *iname)
+{
+	unsigned int key = 0;
+
+	while (*iname)
+		key = key * 31 + (unsigned char) *iname++;
+	return key % VRRP_NAME_HASH_SIZE;
+}
+
+void
+alloc_vrrp_name_bucket(vrrp_rt *vrrp)
+{
+	list_add(&vrrp_data->vrrp_index_name[vrrp_name_hash_key(vrrp->iname)],
+		 vrrp);
+}
+
+vrrp_rt *
+vrrp_index_lookup_name(const char *iname)
+{
+	vrrp_rt *vrrp;
+	element e;
+	list l = &vrrp_data->vrrp_index_name[vrrp_name_hash_key(iname)];
+
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		vrrp = ELEMENT_DATA(e);
+		if (!strcmp(vrrp->iname, iname))
+			return vrrp;
+	}
+	return NULL;
+}
+
+/* (ifindex, vrid) hash table, a VRRP router on a LAN */
+#define VRRP_IFVRID_BUCKET(I,V)	(((I) * 256 + (V)) % VRRP_IFVRID_HASH_SIZE)
+
+vrrp_rt *
+vrrp_index_lookup_ifvrid(const int ifindex, const int vrid)
+{
+	vrrp_rt *vrrp;
+	element e;
+	list l = &vrrp_data->vrrp_index_ifvrid[VRRP_IFVRID_BUCKET(ifindex, vrid)];
+
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		vrrp = ELEMENT_DATA(e);
+		if (IF_INDEX(vrrp->ifp) == ifindex && vrrp->vrid == vrid)
+			return vrrp;
+	}
+	return NULL;
+}
+
+/* Returns the instance already owning this (ifindex, vrid) if any */
+vrrp_rt *
+alloc_vrrp_ifvrid_bucket(vrrp_rt *vrrp)
+{
+	int ifindex = IF_INDEX(vrrp->ifp);
+	vrrp_rt *owner = vrrp_index_lookup_ifvrid(ifindex, vrrp->vrid);
+
+	list_add(&vrrp_data->vrrp_index_ifvrid[VRRP_IFVRID_BUCKET(ifindex, vrrp->vrid)],
+		 vrrp);
+	return owner;
+}
@@ -45,7 +45,7 @@ netlink_address_ipv4(ip_address *ipaddr, int cmd)
 	req.n.nlmsg_flags = NLM_F_REQUEST;
 	req.n.nlmsg_type = cmd ? RTM_NEWADDR : RTM_DELADDR;
 	req.ifa.ifa_family = AF_INET;
-	req.ifa.ifa_index = ipaddr->ifindex;
+	req.ifa.ifa_index = IF_INDEX(ipaddr->ifp);
 	req.ifa.ifa_scope = ipaddr->scope;
 	req.ifa.ifa_prefixlen = ipaddr->mask;
 	addattr_l(&req.n, sizeof (req), IFA_LOCAL, &ipaddr->addr, sizeof (ipaddr->addr));
@@ -110,7 +110,7 @@ dump_ipaddress(void *if_data_obj)
 	       , inet_ntop2(ip_addr->addr)
 	       , ip_addr->mask
 	       , broadcast
-	       , IF_NAME(if_get_by_ifindex(ip_addr->ifindex))
+	       , IF_NAME(ip_addr->ifp)
 	       , netlink_scope_n2a(ip_addr->scope)
 	       , ip_addr->label ? " label " : ""
 	       , ip_addr->label ? ip_addr->label : "");
@@ -126,7 +126,6 @@ alloc_ipaddress(list ip_list, vector strvec, interface *ifp)
 	new = (ip_address *) MALLOC(sizeof(ip_address));
 	if (ifp) {
 		new->ifp = ifp;
-		new->ifindex = IF_INDEX(ifp);
 	} else {
 		new->ifp = if_get_by_ifname(DFLT_INT);
 		if (!new->ifp) {
@@ -136,7 +135,6 @@ alloc_ipaddress(list ip_list, vector strvec, interface *ifp)
 			FREE(new);
 			return;
 		}
-		new->ifindex = IF_INDEX(new->ifp);
 	}
 
 	/* FMT parse */
@@ -153,7 +151,6 @@ alloc_ipaddress(list ip_list, vector strvec, interface *ifp)
 				FREE(new);
 				return;
 			}
-			new->ifindex = IF_INDEX(new->ifp);
 		} else if (!strcmp(str, "scope")) {
 			new->scope = netlink_scope_a2n(VECTOR_SLOT(strvec, ++i));
 		} else if (!strcmp(str, "broadcast") || !strcmp(str, "brd")) {
@@ -172,14 +169,36 @@ alloc_ipaddress(list ip_list, vector strvec, interface *ifp)
 	list_add(ip_list, new);
 }
 
-/* Find an address in a list */
-int
-address_exist(list l, ip_address *ipaddress)
+/*
+ * Address lists are diffed on reload through a temporary hash index
+ * keyed on (address, mask, interface) and sized on the new list, so
+ * large VIP blocks are not compared with nested scans.
+ */
+#define IPADDR_BUCKET(A,S)	((ntohl((A)->addr) ^ (A)->mask ^ \
+				  ((unsigned long) (A)->ifp >> 4)) % (S))
+
+static list
+alloc_address_index(list l, int size)
 {
+	list index = alloc_mlist(NULL, NULL, size);
 	ip_address *ipaddr;
 	element e;
 
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		ipaddr = ELEMENT_DATA(e);
+		list_add(&index[IPADDR_BUCKET(ipaddr, size)], ipaddr);
+	}
+	return index;
+}
+
+/* Find an address in an index */
+static int
+address_exist(list index, int size, ip_address *ipaddress)
+{
+	ip_address *ipaddr;
+	element e;
+
+	for (e = LIST_HEAD(&index[IPADDR_BUCKET(ipaddress, size)]); e; ELEMENT_NEXT(e)) {
 		ipaddr = ELEMENT_DATA(e);
 		if (IP_ISEQ(ipaddr, ipaddress)) {
 			ipaddr->set = ipaddress->set;
@@ -196,6 +215,8 @@ clear_diff_address(list l, list n)
 {
 	ip_address *ipaddress;
 	element e;
+	list index;
+	int size;
 
 	/* No addresses in previous conf */
 	if (LIST_ISEMPTY(l))
@@ -208,16 +229,19 @@ clear_diff_address(list l, list n)
 		return;
 	}
 
+	size = LIST_SIZE(n);
+	index = alloc_address_index(n, size);
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
 		ipaddress = ELEMENT_DATA(e);
-		if (!address_exist(n, ipaddress) && ipaddress->set) {
+		if (!address_exist(index, size, ipaddress) && ipaddress->set) {
 			log_message(LOG_INFO, "ip address %s/%d dev %s, no longer exist"
 			       , inet_ntop2(ipaddress->addr)
 			       , ipaddress->mask
-			       , IF_NAME(if_get_by_ifindex(ipaddress->ifindex)));
+			       , IF_NAME(ipaddress->ifp));
 			netlink_address_ipv4(ipaddress, IPADDRESS_DEL);
 		}
 	}
+	free_mlist(index, size);
 }
 
 /* Clear static ip address */
@@ -73,7 +73,7 @@ netlink_route_ipv4(ip_route *iproute, int cmd)
 #define MULTIPATH_ADD_GW(x) \
 	memset(rtnh, 0, sizeof(*rtnh)); \
 	rtnh->rtnh_len = sizeof(*rtnh); \
-	if (iproute->index) rtnh->rtnh_ifindex = iproute->index; \
+	if (iproute->ifp) rtnh->rtnh_ifindex = IF_INDEX(iproute->ifp); \
 	rta->rta_len += rtnh->rtnh_len;	\
 	rta_addattr_l(rta, 1024, RTA_GATEWAY, x, 4); \
 	rtnh->rtnh_len += sizeof(struct rtattr) + 4; \
@@ -82,8 +82,8 @@ netlink_route_ipv4(ip_route *iproute, int cmd)
 		MULTIPATH_ADD_GW(&iproute->gw2);
 		addattr_l(&req.n, sizeof(req), RTA_MULTIPATH, RTA_DATA(rta), RTA_PAYLOAD(rta));
 	}
-	if ((iproute->index) && (!iproute->gw2))
-		addattr32(&req.n, sizeof(req), RTA_OIF, iproute->index);
+	if ((iproute->ifp) && (!iproute->gw2))
+		addattr32(&req.n, sizeof(req), RTA_OIF, IF_INDEX(iproute->ifp));
 	if (iproute->src)
 		addattr_l(&req.n, sizeof(req), RTA_PREFSRC, &iproute->src, 4);
 	if (iproute->metric)
@@ -149,9 +149,8 @@ dump_iproute(void *rt_data_obj)
 		snprintf(tmp, 30, " src %s", inet_ntop2(route->src));
 		strncat(log_msg, tmp, 30);
 	}
-	if (route->index) {
-		snprintf(tmp, 30, " dev %s",
-			 IF_NAME(if_get_by_ifindex(route->index)));
+	if (route->ifp) {
+		snprintf(tmp, 30, " dev %s", IF_NAME(route->ifp));
 		strncat(log_msg, tmp, 30);
 	}
 	if (route->table) {
@@ -208,7 +207,7 @@ alloc_route(list rt_list, vector strvec)
 				FREE(new);
 				return;
 			}
-			new->index = IF_INDEX(ifp);
+			new->ifp = ifp;
 		} else if (!strcmp(str, "table")) {
 			new->table = atoi(VECTOR_SLOT(strvec, ++i));
 		} else if (!strcmp(str, "metric")) {
@@ -228,14 +227,32 @@ alloc_route(list rt_list, vector strvec)
 	list_add(rt_list, new);
 }
 
-/* Try to find a route in a list */
-int
-route_exist(list l, ip_route *iproute)
+/* Routes are diffed through a temporary (dst, mask, oif) hash index */
+#define IPROUTE_BUCKET(R,S)	((ntohl((R)->dst) ^ (R)->dmask ^ \
+				  ((unsigned long) (R)->ifp >> 4)) % (S))
+
+static list
+alloc_route_index(list l, int size)
 {
+	list index = alloc_mlist(NULL, NULL, size);
 	ip_route *ipr;
 	element e;
 
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		ipr = ELEMENT_DATA(e);
+		list_add(&index[IPROUTE_BUCKET(ipr, size)], ipr);
+	}
+	return index;
+}
+
+/* Try to find a route in an index */
+static int
+route_exist(list index, int size, ip_route *iproute)
+{
+	ip_route *ipr;
+	element e;
+
+	for (e = LIST_HEAD(&index[IPROUTE_BUCKET(iproute, size)]); e; ELEMENT_NEXT(e)) {
 		ipr = ELEMENT_DATA(e); 
 		if (ROUTE_ISEQ(ipr, iproute)) {
 			ipr->set = iproute->set;
@@ -251,6 +268,8 @@ clear_diff_routes(list l, list n)
 {
 	ip_route *iproute;
 	element e;
+	list index;
+	int size;
 
 	/* No route in previous conf */
 	if (LIST_ISEMPTY(l))
@@ -263,14 +282,17 @@ clear_diff_routes(list l, list n)
 		return;
 	}
 
+	size = LIST_SIZE(n);
+	index = alloc_route_index(n, size);
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
 		iproute = ELEMENT_DATA(e);
-		if (!route_exist(n, iproute) && iproute->set) {
+		if (!route_exist(index, size, iproute) && iproute->set) {
 			log_message(LOG_INFO, "ip route %s/%d ... , no longer exist"
 			       , inet_ntop2(iproute->dst), iproute->dmask);
 			netlink_route_ipv4(iproute, IPROUTE_DEL);
 		}
 	}
+	free_mlist(index, size);
 }
 
 /* Diff conf handler */
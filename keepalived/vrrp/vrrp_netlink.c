@@ -38,6 +38,7 @@
 #include "check_api.h"
 #include "vrrp_netlink.h"
 #include "vrrp_if.h"
+#include "vrrp_track.h"
 #include "logger.h"
 #include "memory.h"
 #include "scheduler.h"
@@ -46,6 +47,13 @@
 /* Global vars */
 struct nl_handle nl_kernel;	/* Kernel reflection channel */
 struct nl_handle nl_cmd;	/* Command channel */
+nl_stats netlink_stats;		/* Reflector statistics */
+unsigned int netlink_resync_gen;	/* Current link resync generation */
+static int netlink_resync_pending;
+static TIMEVAL netlink_resync_last;
+static list netlink_resync_addr;	/* addresses collected by resync */
+
+static void netlink_overrun(void);
 
 /* Create a socket to netlink interface */
 int
@@ -237,16 +245,20 @@ netlink_scope_a2n(char *scope)
 	return -1;
 }
 
-/* Our netlink parser */
+/*
+ * Our netlink parser. At most batch datagrams are read when batch
+ * is not 0, so that an event storm cannot starve other threads.
+ */
 static int
-netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
-		   struct nl_handle *nl, struct nlmsghdr *n)
+netlink_parse_batch(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
+		    struct nl_handle *nl, struct nlmsghdr *n, int batch)
 {
 	int status;
 	int ret = 0;
 	int error;
+	int count = 0;
 
-	while (1) {
+	while (!batch || count++ < batch) {
 		char buf[4096];
 		struct iovec iov = { buf, sizeof buf };
 		struct sockaddr_nl snl;
@@ -262,6 +274,8 @@ netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 			if (errno == EWOULDBLOCK || errno == EAGAIN)
 				break;
 			log_message(LOG_INFO, "Netlink: Received message overrun");
+			if (errno == ENOBUFS && nl == &nl_kernel)
+				netlink_overrun();
 			continue;
 		}
 
@@ -343,6 +357,13 @@ netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 	return ret;
 }
 
+static int
+netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
+		   struct nl_handle *nl, struct nlmsghdr *n)
+{
+	return netlink_parse_batch(filter, nl, n, 0);
+}
+
 /* Out talk filter */
 static int
 netlink_talk_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
@@ -424,42 +445,34 @@ netlink_request(struct nl_handle *nl, int family, int type)
 	return 0;
 }
 
-/* Netlink interface link lookup filter */
-static int
-netlink_if_link_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
+/* Update interface carrier state from netlink link attributes */
+static void
+netlink_if_link_state(interface * ifp, struct ifinfomsg *ifi,
+		      struct rtattr *tb[])
 {
-	struct ifinfomsg *ifi;
-	struct rtattr *tb[IFLA_MAX + 1];
-	interface *ifp;
-	int i, len;
-	char *name;
-
-	ifi = NLMSG_DATA(h);
-
-	if (h->nlmsg_type != RTM_NEWLINK)
-		return 0;
-
-	len = h->nlmsg_len - NLMSG_LENGTH(sizeof (struct ifinfomsg));
-	if (len < 0)
-		return -1;
-
-	/* Interface name lookup */
-	memset(tb, 0, sizeof (tb));
-	parse_rtattr(tb, IFLA_MAX, IFLA_RTA(ifi), len);
-	if (tb[IFLA_IFNAME] == NULL)
-		return -1;
-	name = (char *) RTA_DATA(tb[IFLA_IFNAME]);
+	ifp->flags = ifi->ifi_flags;
+	ifp->nl_gen = netlink_resync_gen;
+	if (tb[IFLA_OPERSTATE])
+		ifp->operstate = *(u_char *) RTA_DATA(tb[IFLA_OPERSTATE]);
+	if (IF_NETLINK_SUPPORTED(ifp))
+		ifp->linkbeat = (ifp->flags & IFF_LOWER_UP) ? 1 : 0;
+}
 
-	/* Return if loopback */
-	if (ifi->ifi_type == ARPHRD_LOOPBACK)
-		return 0;
+/* Create and queue a new interface from netlink link attributes */
+static interface *
+netlink_if_link_add(struct ifinfomsg *ifi, struct rtattr *tb[])
+{
+	interface *ifp;
+	char *name = (char *) RTA_DATA(tb[IFLA_IFNAME]);
+	int i;
 
 	/* Fill the interface structure */
 	ifp = (interface *) MALLOC(sizeof (interface));
-	memcpy(ifp->ifname, name, strlen(name));
+	strncpy(ifp->ifname, name, IF_NAMESIZ);
 	ifp->ifindex = ifi->ifi_index;
-	ifp->flags = ifi->ifi_flags;
-	ifp->mtu = *(int *) RTA_DATA(tb[IFLA_MTU]);
+	netlink_if_link_state(ifp, ifi, tb);
+	if (tb[IFLA_MTU])
+		ifp->mtu = *(int *) RTA_DATA(tb[IFLA_MTU]);
 	ifp->hw_type = ifi->ifi_type;
 
 	if (tb[IFLA_ADDRESS]) {
@@ -484,9 +497,46 @@ netlink_if_link_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 
 	/* Queue this new interface */
 	if_add_queue(ifp);
+	return ifp;
+}
+
+/* Netlink interface link lookup filter */
+static int
+netlink_if_link_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+	struct ifinfomsg *ifi;
+	struct rtattr *tb[IFLA_MAX + 1];
+	int len;
+
+	ifi = NLMSG_DATA(h);
+
+	if (h->nlmsg_type != RTM_NEWLINK)
+		return 0;
+
+	len = h->nlmsg_len - NLMSG_LENGTH(sizeof (struct ifinfomsg));
+	if (len < 0)
+		return -1;
+
+	/* Interface name lookup */
+	memset(tb, 0, sizeof (tb));
+	parse_rtattr(tb, IFLA_MAX, IFLA_RTA(ifi), len);
+	if (tb[IFLA_IFNAME] == NULL)
+		return -1;
+
+	/* Return if loopback */
+	if (ifi->ifi_type == ARPHRD_LOOPBACK)
+		return 0;
+
+	netlink_if_link_add(ifi, tb);
 	return 0;
 }
 
+static void
+free_resync_addr(void *data)
+{
+	FREE(data);
+}
+
 /*
  * Netlink interface address lookup filter
  * We need to handle multiple primary address and
@@ -537,6 +587,14 @@ netlink_if_address_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	if (!ifp->address)
 		ifp->address = address;
 
+	/* Resync dump, checkers are reconciled once dump is complete */
+	if (netlink_resync_addr) {
+		uint32_t *addr = (uint32_t *) MALLOC(sizeof (uint32_t));
+		*addr = address;
+		list_add(netlink_resync_addr, addr);
+		return 0;
+	}
+
 #ifdef _WITH_LVS_
 	/* Refresh checkers state */
 	update_checker_activity(address,
@@ -546,9 +604,10 @@ netlink_if_address_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	return 0;
 }
 
-/* Interfaces lookup bootstrap function */
-int
-netlink_interface_lookup(void)
+/* Dump a kernel table through filter using a dedicated socket */
+static int
+netlink_dump(int family, int type,
+	     int (*filter) (struct sockaddr_nl *, struct nlmsghdr *))
 {
 	struct nl_handle nlh;
 	int status = 0;
@@ -563,45 +622,29 @@ netlink_interface_lookup(void)
 		log_message(LOG_INFO, "Netlink: Warning, couldn't set "
 		       "blocking flag to netlink socket...");
 
-	/* Interface lookup */
-	if (netlink_request(&nlh, AF_PACKET, RTM_GETLINK) < 0) {
+	if (netlink_request(&nlh, family, type) < 0) {
 		status = -1;
-		goto end_int;
+		goto end_dump;
 	}
-	status = netlink_parse_info(netlink_if_link_filter, &nlh, NULL);
+	status = netlink_parse_info(filter, &nlh, NULL);
 
-end_int:
+end_dump:
 	netlink_close(&nlh);
 	return status;
 }
 
+/* Interfaces lookup bootstrap function */
+int
+netlink_interface_lookup(void)
+{
+	return netlink_dump(AF_PACKET, RTM_GETLINK, netlink_if_link_filter);
+}
+
 /* Adresses lookup bootstrap function */
 static int
 netlink_address_lookup(void)
 {
-	struct nl_handle nlh;
-	int status = 0;
-	int ret, flags;
-
-	if (netlink_socket(&nlh, 0) < 0)
-		return -1;
-
-	/* Set blocking flag */
-	ret = netlink_set_block(&nlh, &flags);
-	if (ret < 0)
-		log_message(LOG_INFO, "Netlink: 2Warning, couldn't set "
-		       "blocking flag to netlink socket...");
-
-	/* Address lookup */
-	if (netlink_request(&nlh, AF_INET, RTM_GETADDR) < 0) {
-		status = -1;
-		goto end_addr;
-	}
-	status = netlink_parse_info(netlink_if_address_filter, &nlh, NULL);
-
-end_addr:
-	netlink_close(&nlh);
-	return status;
+	return netlink_dump(AF_INET, RTM_GETADDR, netlink_if_address_filter);
 }
 
 /* Netlink flag Link update */
@@ -611,7 +654,8 @@ netlink_reflect_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	struct ifinfomsg *ifi;
 	struct rtattr *tb[IFLA_MAX + 1];
 	interface *ifp;
-	int len;
+	char *name;
+	int len, was_up;
 
 	ifi = NLMSG_DATA(h);
 	if (!(h->nlmsg_type == RTM_NEWLINK || h->nlmsg_type == RTM_DELLINK))
@@ -631,13 +675,50 @@ netlink_reflect_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	if (ifi->ifi_type == ARPHRD_LOOPBACK)
 		return 0;
 
+	name = (char *) RTA_DATA(tb[IFLA_IFNAME]);
+
 	/* find the interface */
 	ifp = if_get_by_ifindex(ifi->ifi_index);
-	if (!ifp)
-		return -1;
 
-	/* Update flags */
-	ifp->flags = ifi->ifi_flags;
+	/* Interface removed */
+	if (h->nlmsg_type == RTM_DELLINK) {
+		if (!ifp)
+			return 0;
+		was_up = IF_ISUP(ifp);
+		if (if_del_queue(ifp)) {
+			log_message(LOG_INFO, "Netlink: interface %s removed",
+				    IF_NAME(ifp));
+			vrrp_track_if_update(ifp, was_up);
+		}
+		return 0;
+	}
+
+	if (!ifp) {
+		ifp = if_lookup_by_ifname(name);
+		if (ifp && !ifp->ifindex) {
+			/* A configured interface showed up again */
+			log_message(LOG_INFO, "Netlink: interface %s is back with"
+					      " index %d, reload to rebind"
+					      " its VRRP sockets",
+				    name, ifi->ifi_index);
+			if_rehash_queue(ifp, ifi->ifi_index, name);
+		} else {
+			/* New interface */
+			ifp = netlink_if_link_add(ifi, tb);
+			if_linkbeat_add(ifp);
+			return 0;
+		}
+	} else if (strcmp(IF_NAME(ifp), name)) {
+		/* Interface renamed */
+		if_rehash_queue(ifp, ifp->ifindex, name);
+	}
+
+	/* Update flags and carrier */
+	was_up = IF_ISUP(ifp);
+	netlink_if_link_state(ifp, ifi, tb);
+
+	/* Push link state change to tracking instances */
+	vrrp_track_if_update(ifp, was_up);
 
 	return 0;
 }
@@ -664,13 +745,65 @@ netlink_broadcast_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 	return 0;
 }
 
+/*
+ * Reflector lost events. Links are re-dumped and reconciled against
+ * the interface table, addresses are re-dumped and checkers activity
+ * reconciled against them.
+ */
+static int
+kernel_netlink_resync_thread(thread * thread_obj)
+{
+	netlink_resync_pending = 0;
+	netlink_resync_last = timer_now();
+	netlink_stats.resync++;
+	netlink_resync_gen++;
+
+	log_message(LOG_INFO, "Netlink: resyncing kernel state"
+			      " (overruns %lu, resyncs %lu)",
+		    netlink_stats.overrun, netlink_stats.resync);
+
+	if (netlink_dump(AF_PACKET, RTM_GETLINK, netlink_reflect_filter) == 0)
+		if_resync_purge(netlink_resync_gen);
+
+	netlink_resync_addr = alloc_list(free_resync_addr, NULL);
+	if (netlink_dump(AF_INET, RTM_GETADDR, netlink_if_address_filter) == 0) {
+#ifdef _WITH_LVS_
+		resync_checker_activity(netlink_resync_addr);
+#endif
+	}
+	free_list(netlink_resync_addr);
+	netlink_resync_addr = NULL;
+	return 0;
+}
+
+/* ENOBUFS on the reflector, schedule a rate limited resync */
+static void
+netlink_overrun(void)
+{
+	long elapsed, delay = 0;
+
+	netlink_stats.overrun++;
+	if (netlink_resync_pending)
+		return;
+
+	if (!TIMER_ISNULL(netlink_resync_last)) {
+		elapsed = timer_tol(timer_sub_now(netlink_resync_last));
+		if (elapsed < NETLINK_RESYNC_DELAY)
+			delay = NETLINK_RESYNC_DELAY - elapsed;
+	}
+
+	netlink_resync_pending = 1;
+	thread_add_timer(master, kernel_netlink_resync_thread, NULL, delay);
+}
+
 int
 kernel_netlink(thread * thread_obj)
 {
 	int status = 0;
 
 	if (thread_obj->type != THREAD_READ_TIMEOUT)
-		status = netlink_parse_info(netlink_broadcast_filter, &nl_kernel, NULL);
+		status = netlink_parse_batch(netlink_broadcast_filter, &nl_kernel,
+					     NULL, NETLINK_BATCH);
 	thread_add_read(master, kernel_netlink, NULL, nl_kernel.fd,
 			NETLINK_TIMER);
 	return 0;
@@ -681,6 +814,9 @@ kernel_netlink_init(void)
 {
 	unsigned long groups;
 
+	netlink_resync_pending = 0;
+	TIMER_RESET(netlink_resync_last);
+
 	/* Start with a netlink address lookup */
 	netlink_address_lookup();
 
@@ -707,6 +843,25 @@ kernel_netlink_init(void)
 		log_message(LOG_INFO, "Error while registering Kernel netlink cmd channel");
 }
 
+/* Reflector receive buffer, applied once configuration is parsed */
+void
+kernel_netlink_set_rcvbuf(int size)
+{
+	if (nl_kernel.fd <= 0 || size <= 0)
+		return;
+
+#ifdef SO_RCVBUFFORCE
+	/* Going over rmem_max needs CAP_NET_ADMIN */
+	if (setsockopt(nl_kernel.fd, SOL_SOCKET, SO_RCVBUFFORCE,
+		       &size, sizeof (size)) == 0)
+		return;
+#endif
+	if (setsockopt(nl_kernel.fd, SOL_SOCKET, SO_RCVBUF,
+		       &size, sizeof (size)) < 0)
+		log_message(LOG_INFO, "Netlink: Cannot set receive buffer"
+				      " to %d : (%s)", size, strerror(errno));
+}
+
 void
 kernel_netlink_close(void)
 {
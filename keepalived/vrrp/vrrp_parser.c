@@ -133,6 +133,16 @@ vrrp_track_scr_handler(vector strvec)
 	alloc_value_block(strvec, alloc_vrrp_track_script);
 }
 static void
+vrrp_track_vs_handler(vector strvec)
+{
+	alloc_value_block(strvec, alloc_vrrp_track_vs);
+}
+static void
+vrrp_track_rs_handler(vector strvec)
+{
+	alloc_value_block(strvec, alloc_vrrp_track_rs);
+}
+static void
 vrrp_dont_track_handler(vector strvec)
 {
 	vrrp_rt *vrrp = LIST_TAIL_DATA(vrrp_data->vrrp);
@@ -364,6 +374,12 @@ vrrp_vscript_script_handler(vector strvec)
 	vscript->script = set_value(strvec);
 }
 static void
+vrrp_vscript_shm_slot_handler(vector strvec)
+{
+	vrrp_script *vscript = LIST_TAIL_DATA(vrrp_data->vrrp_script);
+	vscript->shm_slot = set_value(strvec);
+}
+static void
 vrrp_vscript_interval_handler(vector strvec)
 {
 	vrrp_script *vscript = LIST_TAIL_DATA(vrrp_data->vrrp_script);
@@ -416,6 +432,8 @@ vrrp_init_keywords(void)
 	install_keyword("dont_track_primary", &vrrp_dont_track_handler);
 	install_keyword("track_interface", &vrrp_track_int_handler);
 	install_keyword("track_script", &vrrp_track_scr_handler);
+	install_keyword("track_vs", &vrrp_track_vs_handler);
+	install_keyword("track_rs", &vrrp_track_rs_handler);
 	install_keyword("mcast_src_ip", &vrrp_mcastip_handler);
 	install_keyword("virtual_router_id", &vrrp_vrid_handler);
 	install_keyword("priority", &vrrp_prio_handler);
@@ -442,6 +460,7 @@ vrrp_init_keywords(void)
 	install_sublevel_end();
 	install_keyword_root("vrrp_script", &vrrp_script_handler);
 	install_keyword("script", &vrrp_vscript_script_handler);
+	install_keyword("shm_slot", &vrrp_vscript_shm_slot_handler);
 	install_keyword("interval", &vrrp_vscript_interval_handler);
 	install_keyword("weight", &vrrp_vscript_weight_handler);
 	install_keyword("rise", &vrrp_vscript_rise_handler);
@@ -30,6 +30,7 @@
 #include "vrrp_data.h"
 #include "vrrp_index.h"
 #include "ipvswrapper.h"
+#include "track_shm.h"
 #include "memory.h"
 #include "notify.h"
 #include "list.h"
@@ -71,10 +72,10 @@ static void vrrp_goto_master(vrrp_rt *);
 static void vrrp_master(vrrp_rt *);
 static void vrrp_fault(vrrp_rt *);
 
-static int vrrp_update_priority(thread * thread_obj);
 static int vrrp_script_child_timeout_thread(thread * thread_obj);
 static int vrrp_script_child_thread(thread * thread_obj);
 static int vrrp_script_thread(thread * thread_obj);
+static int vrrp_gratuitous_arp_thread(thread * thread_obj);
 
 struct {
 	void (*read) (vrrp_rt *, char *, int);
@@ -192,6 +193,7 @@ vrrp_init_state(list l)
 		if (vrrp->sync) {
 			element e;
 			tracked_sc *sc;
+			tracked_svc *tsv;
 			tracked_if *tip;
 			int warning = 0;
 
@@ -217,15 +219,29 @@ vrrp_init_state(list l)
 				}
 			}
 
+			if (!LIST_ISEMPTY(vrrp->track_svc)) {
+				for (e = LIST_HEAD(vrrp->track_svc); e;
+				     ELEMENT_NEXT(e)) {
+					tsv = ELEMENT_DATA(e);
+					if (tsv->weight) {
+						tsv->weight = 0;
+						warning++;
+					}
+				}
+			}
+
 			if (warning > 0) {
 				log_message(LOG_INFO, "VRRP_Instance(%s) : ignoring "
 						 "track weights due to SYNC group",
 				       vrrp->iname);
 			}
-		} else {
-			/* Register new priority update thread */
-			thread_add_timer(master, vrrp_update_priority,
-					 vrrp, vrrp->adver_int);
+		}
+
+		/* State carried over a reload, instance keeps running */
+		if (vrrp->reloaded) {
+			vrrp->ms_down_timer = 3 * vrrp->adver_int
+			    + VRRP_TIMER_SKEW(vrrp);
+			continue;
 		}
 
 		if (vrrp->base_priority == VRRP_PRIO_OWNER ||
@@ -237,7 +253,7 @@ vrrp_init_state(list l)
 					       vrrp->lvs_syncd_if, IPVS_MASTER,
 					       vrrp->vrid);
 #endif
-			vrrp->state = VRRP_STATE_GOTO_MASTER;
+			vrrp_set_state(vrrp, VRRP_STATE_GOTO_MASTER);
 		} else {
 			vrrp->ms_down_timer = 3 * vrrp->adver_int
 			    + VRRP_TIMER_SKEW(vrrp);
@@ -253,7 +269,7 @@ vrrp_init_state(list l)
 
 			/* Set BACKUP state */
 			vrrp_restore_interface(vrrp, 0);
-			vrrp->state = VRRP_STATE_BACK;
+			vrrp_set_state(vrrp, VRRP_STATE_BACK);
 			vrrp_smtp_notifier(vrrp);
 			notify_instance_exec(vrrp, VRRP_STATE_BACK);
 
@@ -277,7 +293,8 @@ vrrp_init_sands(list l)
 
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
 		vrrp = ELEMENT_DATA(e);
-		vrrp_init_instance_sands(vrrp);
+		if (!vrrp->reloaded)
+			vrrp_init_instance_sands(vrrp);
 	}
 }
 
@@ -305,6 +322,22 @@ vrrp_init_script(list l)
 	}
 }
 
+/* if run after vrrp_init_script(), tracked scripts initial status are
+ * known and tracking state is computed once. Further changes are then
+ * pushed by the netlink reflector, linkbeat and script threads.
+ */
+static void
+vrrp_init_track_state(list l)
+{
+	vrrp_rt *vrrp;
+	element e;
+
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		vrrp = ELEMENT_DATA(e);
+		vrrp_init_track(vrrp);
+	}
+}
+
 /* Timer functions */
 static TIMEVAL
 vrrp_compute_timer(const int fd)
@@ -383,6 +416,9 @@ vrrp_register_workers(list l)
 	if (!LIST_ISEMPTY(vrrp_data->vrrp_script))
 		vrrp_init_script(vrrp_data->vrrp_script);
 
+	/* Init VRRP instances tracking state */
+	vrrp_init_track_state(vrrp_data->vrrp);
+
 	/* Register VRRP workers threads */
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
 		sock_obj = ELEMENT_DATA(e);
@@ -449,21 +485,49 @@ vrrp_create_sockpool(list l)
 	}
 }
 
+static void
+vrrp_open_sock(sock * sock_obj)
+{
+	interface *ifp = if_get_by_ifindex(sock_obj->ifindex);
+
+	sock_obj->fd_in = open_vrrp_socket(sock_obj->proto, ifp);
+	if (sock_obj->fd_in == -1)
+		sock_obj->fd_out = -1;
+	else
+		sock_obj->fd_out = open_vrrp_send_socket(sock_obj->proto, ifp);
+}
+
 static void
 vrrp_open_sockpool(list l)
 {
-	sock *sock_obj;
 	element e;
 
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		sock_obj = ELEMENT_DATA(e);
-		sock_obj->fd_in = open_vrrp_socket(sock_obj->proto, sock_obj->ifindex);
-		if (sock_obj->fd_in == -1)
-			sock_obj->fd_out = -1;
-		else
-			sock_obj->fd_out = open_vrrp_send_socket(sock_obj->proto,
-								 sock_obj->ifindex);
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e))
+		vrrp_open_sock(ELEMENT_DATA(e));
+}
+
+/*
+ * Take over an opened socket from the previous pool. Its fds are
+ * cleared in the old pool so that releasing it leaves them open.
+ */
+static int
+vrrp_reuse_sock(list old, sock * sock_obj)
+{
+	sock *old_sock;
+	element e;
+
+	for (e = LIST_HEAD(old); e; ELEMENT_NEXT(e)) {
+		old_sock = ELEMENT_DATA(e);
+		if (old_sock->ifindex == sock_obj->ifindex &&
+		    old_sock->proto == sock_obj->proto &&
+		    old_sock->fd_in != -1) {
+			sock_obj->fd_in = old_sock->fd_in;
+			sock_obj->fd_out = old_sock->fd_out;
+			old_sock->fd_in = old_sock->fd_out = -1;
+			return 1;
+		}
 	}
+	return 0;
 }
 
 static void
@@ -532,6 +596,84 @@ vrrp_dispatcher_init(thread * thread_obj)
 	return 1;
 }
 
+/* Drop every thread running on behalf of the current configuration */
+void
+vrrp_dispatcher_cancel(void)
+{
+	thread_cancel_func(master, vrrp_read_dispatcher_thread, NULL);
+	thread_cancel_func(master, vrrp_gratuitous_arp_thread, NULL);
+	thread_cancel_func(master, vrrp_script_thread, NULL);
+	thread_cancel_func(master, vrrp_script_child_thread, NULL);
+	thread_cancel_func(master, vrrp_script_child_timeout_thread, NULL);
+}
+
+/*
+ * Instances whose interface was removed have no socket. They are held
+ * in FAULT, vrrp_fault() opens their socket once the interface is back.
+ */
+static void
+vrrp_fault_removed_if(list l)
+{
+	vrrp_rt *vrrp;
+	element e;
+
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		vrrp = ELEMENT_DATA(e);
+		if (IF_INDEX(vrrp->ifp) || vrrp->state == VRRP_STATE_FAULT)
+			continue;
+
+		log_message(LOG_INFO, "VRRP_Instance(%s) interface %s removed,"
+				      " holding FAULT state until it is back",
+		       vrrp->iname, IF_NAME(vrrp->ifp));
+		vrrp->cause = VRRP_CAUSE_FAULT;
+		if (vrrp->state == VRRP_STATE_MAST) {
+			vrrp->wantstate = VRRP_STATE_GOTO_FAULT;
+		} else {
+			vrrp_set_state(vrrp, VRRP_STATE_FAULT);
+			notify_instance_exec(vrrp, VRRP_STATE_FAULT);
+		}
+		if (vrrp->sync)
+			vrrp_sync_fault(vrrp);
+	}
+}
+
+/*
+ * Restart the dispatcher on a reloaded configuration. Sockets already
+ * opened for the same interface & protocol are kept so that multicast
+ * membership is not dropped and no advert is missed while reloading.
+ */
+void
+vrrp_dispatcher_reload(vrrp_conf_data * old)
+{
+	list l = vrrp_data->vrrp_socket_pool;
+	sock *sock_obj;
+	element e;
+	int reused = 0, deferred = 0;
+
+	vrrp_create_sockpool(l);
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		sock_obj = ELEMENT_DATA(e);
+		if (!sock_obj->ifindex) {
+			/* Interface removed, nothing to bind to */
+			sock_obj->fd_in = sock_obj->fd_out = -1;
+			deferred++;
+		} else if (vrrp_reuse_sock(old->vrrp_socket_pool, sock_obj))
+			reused++;
+		else
+			vrrp_open_sock(sock_obj);
+	}
+	log_message(LOG_INFO, "VRRP sockpool: %d socket(s) kept, %d opened,"
+			      " %d deferred",
+	       reused, LIST_SIZE(l) - reused - deferred, deferred);
+
+	vrrp_set_fds(l);
+	vrrp_register_workers(l);
+	vrrp_fault_removed_if(vrrp_data->vrrp);
+
+	if (debug & 32)
+		dump_list(l);
+}
+
 void
 vrrp_dispatcher_release(vrrp_conf_data *conf_data_obj)
 {
@@ -627,14 +769,14 @@ vrrp_leave_fault(vrrp_rt * vrrp, char *buffer, int len)
 			if (vrrp_sync_leave_fault(vrrp)) {
 				log_message(LOG_INFO, "VRRP_Instance(%s) Entering BACKUP STATE",
 				       vrrp->iname);
-				vrrp->state = VRRP_STATE_BACK;
+				vrrp_set_state(vrrp, VRRP_STATE_BACK);
 				vrrp_smtp_notifier(vrrp);
 				notify_instance_exec(vrrp, VRRP_STATE_BACK);
 			}
 		} else {
 			log_message(LOG_INFO, "VRRP_Instance(%s) Entering BACKUP STATE",
 			       vrrp->iname);
-			vrrp->state = VRRP_STATE_BACK;
+			vrrp_set_state(vrrp, VRRP_STATE_BACK);
 			vrrp_smtp_notifier(vrrp);
 			notify_instance_exec(vrrp, VRRP_STATE_BACK);
 		}
@@ -650,7 +792,7 @@ vrrp_goto_master(vrrp_rt * vrrp)
 		       vrrp->iname);
 		if (vrrp->state != VRRP_STATE_FAULT)
 			notify_instance_exec(vrrp, VRRP_STATE_FAULT);
-		vrrp->state = VRRP_STATE_FAULT;
+		vrrp_set_state(vrrp, VRRP_STATE_FAULT);
 		vrrp->ms_down_timer = 3 * vrrp->adver_int + VRRP_TIMER_SKEW(vrrp);
 		notify_instance_exec(vrrp, VRRP_STATE_FAULT);
 	} else {
@@ -667,7 +809,7 @@ vrrp_goto_master(vrrp_rt * vrrp)
 }
 
 /* Delayed gratuitous ARP thread */
-int
+static int
 vrrp_gratuitous_arp_thread(thread * thread_obj)
 {
 	vrrp_rt *vrrp = THREAD_ARG(thread_obj);
@@ -678,45 +820,6 @@ vrrp_gratuitous_arp_thread(thread * thread_obj)
 	return 0;
 }
 
-/* Update VRRP effective priority based on multiple checkers.
- * This is a thread which is executed every adver_int.
- */
-static int
-vrrp_update_priority(thread * thread_obj)
-{
-	vrrp_rt *vrrp = THREAD_ARG(thread_obj);
-	int prio_offset, new_prio;
-
-	/* compute prio_offset right here */
-	prio_offset = 0;
-
-	/* Now we will sum the weights of all interfaces which are tracked. */
-	if (!vrrp->sync && !LIST_ISEMPTY(vrrp->track_ifp))
-		 prio_offset += vrrp_tracked_weight(vrrp->track_ifp);
-
-	/* Now we will sum the weights of all scripts which are tracked. */
-	if (!vrrp->sync && !LIST_ISEMPTY(vrrp->track_script))
-		prio_offset += vrrp_script_weight(vrrp->track_script);
-
-	if (vrrp->base_priority == VRRP_PRIO_OWNER) {
-		/* we will not run a PRIO_OWNER into a non-PRIO_OWNER */
-		vrrp->effective_priority = VRRP_PRIO_OWNER;
-	} else {
-		/* WARNING! we must compute new_prio on a signed int in order
-		   to detect overflows and avoid wrapping. */
-		new_prio = vrrp->base_priority + prio_offset;
-		if (new_prio < 1)
-			new_prio = 1;
-		else if (new_prio > 254)
-			new_prio = 254;
-		vrrp->effective_priority = new_prio;
-	}
-
-	/* Register next priority update thread */
-	thread_add_timer(master, vrrp_update_priority, vrrp, vrrp->adver_int);
-	return 0;
-}
-
 static void
 vrrp_master(vrrp_rt * vrrp)
 {
@@ -789,7 +892,7 @@ vrrp_fault(vrrp_rt * vrrp)
 	} else {
 		/* Otherwise, we transit to init state */
 		if (vrrp->init_state == VRRP_STATE_BACK) {
-			vrrp->state = VRRP_STATE_BACK;
+			vrrp_set_state(vrrp, VRRP_STATE_BACK);
 			notify_instance_exec(vrrp, VRRP_STATE_BACK);
 		} else {
 			vrrp_goto_master(vrrp);
@@ -809,6 +912,11 @@ vrrp_dispatcher_read_to(int fd)
 	vrid = vrrp_timer_vrid_timeout(fd);
 	vrrp = vrrp_index_lookup(vrid, fd);
 
+	/* Keep the advert that armed a short down timer as the cause */
+	if (vrrp->cause != VRRP_CAUSE_PRIO_ZERO &&
+	    vrrp->cause != VRRP_CAUSE_LOWER_PRIO)
+		vrrp->cause = VRRP_CAUSE_TIMEOUT;
+
 	/* Run the FSM handler */
 	prev_state = vrrp->state;
 	VRRP_FSM_READ_TO(vrrp);
@@ -829,6 +937,66 @@ vrrp_dispatcher_read_to(int fd)
 	return vrrp->fd_in;
 }
 
+/*
+ * Receive path statistics, collected in detailed log mode only. Time
+ * spent per advert is kept as a log2 histogram in usec.
+ */
+#define VRRP_RX_HIST	16
+static struct {
+	unsigned long read;
+	unsigned long unmatched;
+	unsigned long transition;
+	unsigned long hist[VRRP_RX_HIST];
+} vrrp_rx_stats;
+
+static void
+vrrp_rx_account(TIMEVAL start, vrrp_rt * vrrp, int prev_state)
+{
+	unsigned long usec = timer_tol(timer_sub(timer_now(), start));
+	int bucket = 0;
+
+	while (usec && bucket < VRRP_RX_HIST - 1) {
+		usec >>= 1;
+		bucket++;
+	}
+	vrrp_rx_stats.hist[bucket]++;
+	vrrp_rx_stats.read++;
+	if (!vrrp)
+		vrrp_rx_stats.unmatched++;
+	else if (vrrp->state != prev_state)
+		vrrp_rx_stats.transition++;
+}
+
+static unsigned long
+vrrp_rx_percentile(int pct)
+{
+	unsigned long seen = 0;
+	int i;
+
+	for (i = 0; i < VRRP_RX_HIST; i++) {
+		seen += vrrp_rx_stats.hist[i];
+		if (seen * 100 >= vrrp_rx_stats.read * pct)
+			break;
+	}
+	return (i) ? 1UL << i : 1;
+}
+
+void
+vrrp_dispatcher_dump_stats(void)
+{
+	if (!vrrp_rx_stats.read)
+		return;
+
+	log_message(LOG_INFO, "VRRP receive path: %lu adverts, %lu unmatched,"
+			      " %lu state transitions",
+	       vrrp_rx_stats.read, vrrp_rx_stats.unmatched,
+	       vrrp_rx_stats.transition);
+	log_message(LOG_INFO, "VRRP receive path latency: p50 < %luus,"
+			      " p90 < %luus, p99 < %luus",
+	       vrrp_rx_percentile(50), vrrp_rx_percentile(90),
+	       vrrp_rx_percentile(99));
+}
+
 /* Handle dispatcher read packet */
 static int
 vrrp_dispatcher_read(int fd)
@@ -838,6 +1006,11 @@ vrrp_dispatcher_read(int fd)
 	vrrp_pkt *hd;
 	int len = 0;
 	int prev_state = 0;
+	TIMEVAL start;
+
+	TIMER_RESET(start);
+	if (debug & 32)
+		start = timer_now();
 
 	/* Clean the read buffer */
 	memset(vrrp_buffer, 0, VRRP_PACKET_TEMP_LEN);
@@ -856,11 +1029,15 @@ vrrp_dispatcher_read(int fd)
 	vrrp = vrrp_index_lookup(hd->vrid, fd);
 
 	/* If no instance found => ignore the advert */
-	if (!vrrp)
+	if (!vrrp) {
+		if (debug & 32)
+			vrrp_rx_account(start, NULL, 0);
 		return fd;
+	}
 
 	/* Run the FSM handler */
 	prev_state = vrrp->state;
+	vrrp->cause = VRRP_CAUSE_ADVERT;
 	VRRP_FSM_READ(vrrp, vrrp_buffer, len);
 
 	/* handle instance synchronization */
@@ -877,6 +1054,8 @@ vrrp_dispatcher_read(int fd)
 	 */
 	vrrp_init_instance_sands(vrrp);
 
+	if (debug & 32)
+		vrrp_rx_account(start, vrrp, prev_state);
 	return fd;
 }
 
@@ -907,6 +1086,44 @@ vrrp_read_dispatcher_thread(thread * thread_obj)
 	return 0;
 }
 
+/*
+ * Script fed from the tracking feed: no fork, the slot is polled and
+ * only a generation change is applied. The feed is authoritative so
+ * rise & fall do not apply, a vanished slot counts as a failure.
+ */
+static void
+vrrp_script_shm(vrrp_script * vscript)
+{
+	track_shm_value val;
+	int was_up = SCRIPT_ISUP(vscript);
+
+	if (track_shm_read(vscript->shm_slot, &vscript->shm_index, &val) < 0) {
+		if (vscript->shm_index < 0 && was_up) {
+			log_message(LOG_INFO, "VRRP_Script(%s) feed slot %s missing",
+			       vscript->sname, vscript->shm_slot);
+			vscript->result = 0;
+			vscript->shm_gen = TRACK_SHM_NOGEN;
+			vrrp_track_script_update(vscript, was_up);
+		}
+		return;
+	}
+
+	if (val.generation == vscript->shm_gen)
+		return;
+	vscript->shm_gen = val.generation;
+
+	if (!val.status) {
+		if (!was_up)
+			log_message(LOG_INFO, "VRRP_Script(%s) succeeded", vscript->sname);
+		vscript->result = vscript->rise + vscript->fall - 1;
+	} else {
+		if (was_up)
+			log_message(LOG_INFO, "VRRP_Script(%s) failed", vscript->sname);
+		vscript->result = 0;
+	}
+	vrrp_track_script_update(vscript, was_up);
+}
+
 /* Script tracking threads */
 static int
 vrrp_script_thread(thread * thread_obj)
@@ -919,6 +1136,11 @@ vrrp_script_thread(thread * thread_obj)
 	thread_add_timer(thread_obj->master, vrrp_script_thread, vscript,
 			 vscript->interval);
 
+	if (vscript->shm_slot) {
+		vrrp_script_shm(vscript);
+		return 0;
+	}
+
 	/* Daemonization to not degrade our scheduling timer */
 	pid = fork();
 
@@ -959,6 +1181,7 @@ vrrp_script_child_thread(thread * thread_obj)
 {
 	int wait_status;
 	vrrp_script *vscript = THREAD_ARG(thread_obj);
+	int was_up = SCRIPT_ISUP(vscript);
 
 	if (thread_obj->type == THREAD_CHILD_TIMEOUT) {
 		pid_t pid;
@@ -973,6 +1196,7 @@ vrrp_script_child_thread(thread * thread_obj)
 				log_message(LOG_INFO, "VRRP_Script(%s) timed out", vscript->sname);
 			vscript->result = 0;
 		}
+		vrrp_track_script_update(vscript, was_up);
 		kill(pid, SIGTERM);
 		thread_add_child(thread_obj->master, vrrp_script_child_timeout_thread,
 				 vscript, pid, 2);
@@ -1003,6 +1227,7 @@ vrrp_script_child_thread(thread * thread_obj)
 				vscript->result = 0;
 			}
 		}
+		vrrp_track_script_update(vscript, was_up);
 	}
 
 	return 0;
@@ -24,6 +24,7 @@
 #include "vrrp_if.h"
 #include "vrrp_notify.h"
 #include "vrrp_data.h"
+#include "vrrp_index.h"
 #include "logger.h"
 #include "smtp.h"
 
@@ -46,38 +47,59 @@ vrrp_init_instance_sands(vrrp_rt * vrrp)
 		vrrp->sands = timer_add_long(time_now, vrrp->ms_down_timer);
 }
 
-/* Instance name lookup */
-vrrp_rt *
-vrrp_get_instance(char *iname)
+/* Sync group counter of members in a given state */
+static int *
+vrrp_sync_counter(vrrp_sgroup * vgroup, int state)
 {
-	vrrp_rt *vrrp;
-	list l = vrrp_data->vrrp;
-	element e;
-
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-		if (strcmp(vrrp->iname, iname) == 0)
-			return vrrp;
+	switch (state) {
+	case VRRP_STATE_BACK:
+		return &vgroup->num_backup;
+	case VRRP_STATE_MAST:
+		return &vgroup->num_master;
+	case VRRP_STATE_FAULT:
+		return &vgroup->num_fault;
 	}
 	return NULL;
 }
 
+/* Set instance state, keeping sync group per-state counters */
+void
+vrrp_set_state(vrrp_rt * vrrp, int state)
+{
+	vrrp_sgroup *vgroup = vrrp->sync;
+	int *counter;
+
+	vrrp_record_transition(vrrp, state);
+	if (vgroup && vrrp->state != state) {
+		if ((counter = vrrp_sync_counter(vgroup, vrrp->state)))
+			(*counter)--;
+		if ((counter = vrrp_sync_counter(vgroup, state)))
+			(*counter)++;
+	}
+	vrrp->state = state;
+}
+
 /* Set instances group pointer */
 void
 vrrp_sync_set_group(vrrp_sgroup *vgroup)
 {
 	vrrp_rt *vrrp;
 	char *str;
+	int *counter;
 	int i;
 
 	for (i = 0; i < VECTOR_SIZE(vgroup->iname); i++) {
 		str = VECTOR_SLOT(vgroup->iname, i);
-		vrrp = vrrp_get_instance(str);
+		vrrp = vrrp_index_lookup_name(str);
 		if (vrrp) {
 			if (LIST_ISEMPTY(vgroup->index_list))
 				vgroup->index_list = alloc_list(NULL, NULL);
 			list_add(vgroup->index_list, vrrp);
 			vrrp->sync = vgroup;
+			if ((counter = vrrp_sync_counter(vgroup, vrrp->state)))
+				(*counter)++;
+			if (!VRRP_ISUP(vrrp))
+				vgroup->num_member_fault++;
 		}
 	}
 }
@@ -86,18 +108,7 @@ vrrp_sync_set_group(vrrp_sgroup *vgroup)
 int
 vrrp_sync_group_up(vrrp_sgroup * vgroup)
 {
-	vrrp_rt *vrrp;
-	element e;
-	list l = vgroup->index_list;
-	int is_up = 0;
-
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		vrrp = ELEMENT_DATA(e);
-		if (VRRP_ISUP(vrrp))
-			is_up++;
-	}
-
-	if (is_up == LIST_SIZE(vgroup->index_list)) {
+	if (!vgroup->num_member_fault) {
 		log_message(LOG_INFO, "Kernel is reporting: Group(%s) UP"
 			       , GROUP_NAME(vgroup));
 		return 1;
@@ -143,20 +154,29 @@ vrrp_sync_master_election(vrrp_rt * vrrp)
 	list l = vgroup->index_list;
 	element e;
 
-	if (vrrp->wantstate != VRRP_STATE_GOTO_MASTER)
+	if (vrrp->wantstate != VRRP_STATE_GOTO_MASTER) {
+		/* Election is over for this group, allow a new one */
+		vgroup->election = 0;
 		return;
+	}
 	if (GROUP_STATE(vgroup) == VRRP_STATE_FAULT)
 		return;
 
+	/* Members already forced by a previous member of this election */
+	if (vgroup->election)
+		return;
+	vgroup->election = 1;
+
 	log_message(LOG_INFO, "VRRP_Group(%s) Transition to MASTER state",
 	       GROUP_NAME(vgroup));
 
 	/* Perform sync index */
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
 		isync = ELEMENT_DATA(e);
-		if (isync != vrrp) {
+		if (isync != vrrp && isync->wantstate != VRRP_STATE_GOTO_MASTER) {
 			/* Force a new protocol master election */
 			isync->wantstate = VRRP_STATE_GOTO_MASTER;
+			isync->cause = VRRP_CAUSE_SYNC;
 			log_message(LOG_INFO,
 			       "VRRP_Instance(%s) forcing a new MASTER election",
 			       isync->iname);
@@ -180,10 +200,13 @@ vrrp_sync_backup(vrrp_rt * vrrp)
 	       GROUP_NAME(vgroup));
 
 	/* Perform sync index */
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+	vgroup->election = 0;
+	for (e = LIST_HEAD(l); e && vgroup->num_backup < LIST_SIZE(l);
+	     ELEMENT_NEXT(e)) {
 		isync = ELEMENT_DATA(e);
 		if (isync != vrrp && isync->state != VRRP_STATE_BACK) {
 			isync->wantstate = VRRP_STATE_BACK;
+			isync->cause = VRRP_CAUSE_SYNC;
 			vrrp_state_leave_master(isync);
 			vrrp_init_instance_sands(isync);
 		}
@@ -208,12 +231,15 @@ vrrp_sync_master(vrrp_rt * vrrp)
 	       GROUP_NAME(vgroup));
 
 	/* Perform sync index */
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+	vgroup->election = 0;
+	for (e = LIST_HEAD(l); e && vgroup->num_master < LIST_SIZE(l);
+	     ELEMENT_NEXT(e)) {
 		isync = ELEMENT_DATA(e);
 
 		/* Send the higher priority advert on all synced instances */
 		if (isync != vrrp && isync->state != VRRP_STATE_MAST) {
 			isync->wantstate = VRRP_STATE_MAST;
+			isync->cause = VRRP_CAUSE_SYNC;
 			vrrp_state_goto_master(isync);
 			vrrp_init_instance_sands(isync);
 		}
@@ -238,7 +264,9 @@ vrrp_sync_fault(vrrp_rt * vrrp)
 	       GROUP_NAME(vgroup));
 
 	/* Perform sync index */
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+	vgroup->election = 0;
+	for (e = LIST_HEAD(l); e && vgroup->num_fault < LIST_SIZE(l);
+	     ELEMENT_NEXT(e)) {
 		isync = ELEMENT_DATA(e);
 
 		/*
@@ -248,10 +276,11 @@ vrrp_sync_fault(vrrp_rt * vrrp)
 		 * => Takeover will be less than 3secs !
 		 */
 		if (isync != vrrp && isync->state != VRRP_STATE_FAULT) {
+			isync->cause = VRRP_CAUSE_SYNC;
 			if (isync->state == VRRP_STATE_MAST)
 				isync->wantstate = VRRP_STATE_GOTO_FAULT;
 			if (isync->state == VRRP_STATE_BACK)
-				isync->state = VRRP_STATE_FAULT;
+				vrrp_set_state(isync, VRRP_STATE_FAULT);
 		}
 	}
 	vgroup->state = VRRP_STATE_FAULT;
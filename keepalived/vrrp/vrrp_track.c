@@ -24,8 +24,10 @@
 #include "vrrp_track.h"
 #include "vrrp_if.h"
 #include "vrrp_data.h"
+#include "vrrp.h"
 #include "logger.h"
 #include "memory.h"
+#include "utils.h"
 
 /* Track interface dump */
 void
@@ -128,22 +130,130 @@ alloc_track_script(list track_list, vector strvec)
 	list_add(track_list, tsc);
 }
 
-/* Test if all tracked interfaces are either UP or weight-tracked */
-int
-vrrp_tracked_up(list l)
+/* LVS services tracked through the healthcheck channel */
+void
+free_vsvc(void *data)
+{
+	vrrp_svc *svc = data;
+
+	free_list(svc->tracking_vrrp);
+	FREE(svc);
+}
+void
+dump_vsvc(void *data)
+{
+	vrrp_svc *svc = data;
+
+	log_message(LOG_INFO, " LVS service = %s%s%s, %s", svc->vs,
+	       (svc->rs[0]) ? " " : "", svc->rs, (svc->up) ? "UP" : "DOWN");
+}
+void
+dump_track_svc(void *track_data_obj)
+{
+	tracked_svc *tsv = track_data_obj;
+	log_message(LOG_INFO, "     %s%s%s weight %d", tsv->svc->vs,
+	       (tsv->svc->rs[0]) ? " " : "", tsv->svc->rs, tsv->weight);
+}
+
+static vrrp_svc *
+find_svc(list l, char *vs, char *rs)
 {
 	element e;
-	tracked_if *tip;
+	vrrp_svc *svc;
+
+	if (LIST_ISEMPTY(l))
+		return NULL;
 
 	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		tip = ELEMENT_DATA(e);
-		if (!tip->weight && !IF_ISUP(tip->ifp))
-			return 0;
+		svc = ELEMENT_DATA(e);
+		if (!strcmp(svc->vs, vs) && !strcmp(svc->rs, rs))
+			return svc;
 	}
+	return NULL;
+}
+
+/* Build a service key the way the healthcheck child does */
+static int
+svc_key(char *key, char *addr, char *port)
+{
+	uint32_t ip;
 
+	if (!strcmp(addr, "fwmark")) {
+		snprintf(key, IPC_KEY_LEN, "fwmark:%u", (unsigned) atoi(port));
+		return 1;
+	}
+	if (!strcmp(addr, "group")) {
+		snprintf(key, IPC_KEY_LEN, "group:%s", port);
+		return 1;
+	}
+	if (!inet_ston(addr, &ip))
+		return 0;
+	snprintf(key, IPC_KEY_LEN, "%s:%d", inet_ntop2(ip), atoi(port));
 	return 1;
 }
 
+static void
+alloc_track_svc(list track_list, vector strvec, int is_rs)
+{
+	vrrp_svc *svc, *old_svc;
+	tracked_svc *tsv;
+	char vs[IPC_KEY_LEN], rs[IPC_KEY_LEN];
+	int nargs = (is_rs) ? 4 : 2;
+	int weight = 0;
+
+	rs[0] = '\0';
+	if (VECTOR_SIZE(strvec) < nargs ||
+	    !svc_key(vs, VECTOR_SLOT(strvec, 0), VECTOR_SLOT(strvec, 1)) ||
+	    (is_rs && !svc_key(rs, VECTOR_SLOT(strvec, 2), VECTOR_SLOT(strvec, 3)))) {
+		log_message(LOG_INFO, "     %s: bad service, ignoring...",
+		       VECTOR_SLOT(strvec, 0));
+		return;
+	}
+
+	if (VECTOR_SIZE(strvec) >= nargs + 2 &&
+	    !strcmp(VECTOR_SLOT(strvec, nargs), "weight")) {
+		weight = atoi(VECTOR_SLOT(strvec, nargs + 1));
+		if (weight < -254 || weight > 254) {
+			log_message(LOG_INFO, "     %s: weight must be between "
+					 "[-254..254] inclusive. Ignoring...", vs);
+			weight = 0;
+		}
+	}
+
+	/* Services are shared between instances */
+	svc = find_svc(vrrp_data->vrrp_svc, vs, rs);
+	if (!svc) {
+		svc = (vrrp_svc *) MALLOC(sizeof (vrrp_svc));
+		memcpy(svc->vs, vs, IPC_KEY_LEN);
+		memcpy(svc->rs, rs, IPC_KEY_LEN);
+
+		/* Keep last known state over a reload, the healthcheck
+		 * child resync will correct it if needed.
+		 */
+		old_svc = (old_vrrp_data) ?
+			  find_svc(old_vrrp_data->vrrp_svc, vs, rs) : NULL;
+		svc->up = (old_svc) ? old_svc->up : 1;
+		list_add(vrrp_data->vrrp_svc, svc);
+	}
+
+	tsv         = (tracked_svc *) MALLOC(sizeof (tracked_svc));
+	tsv->svc    = svc;
+	tsv->weight = weight;
+	list_add(track_list, tsv);
+}
+
+void
+alloc_track_vs(list track_list, vector strvec)
+{
+	alloc_track_svc(track_list, strvec, 0);
+}
+
+void
+alloc_track_rs(list track_list, vector strvec)
+{
+	alloc_track_svc(track_list, strvec, 1);
+}
+
 /* Log tracked interface down */
 void
 vrrp_log_tracked_down(list l)
@@ -159,72 +269,199 @@ vrrp_log_tracked_down(list l)
 	}
 }
 
-/* Returns total weights of all tracked interfaces :
- * - a positive interface weight adds to the global weight when the
- *   interface is UP.
- * - a negative interface weight subtracts from the global weight when the
- *   interface is DOWN.
- *
+/* Tracking reverse index */
+void
+free_tracking_vrrp(void *data)
+{
+	FREE(data);
+}
+
+/* Returns the weight a tracked object gives to the instance priority :
+ * - a positive weight adds to the global weight when the object is UP.
+ * - a negative weight subtracts from the global weight when the object
+ *   is DOWN.
  */
-int
-vrrp_tracked_weight(list l)
+static int
+vrrp_track_weight(int weight, int up)
 {
-	element e;
-	tracked_if *tip;
-	int weight = 0;
+	if (up)
+		return (weight > 0) ? weight : 0;
+	return (weight < 0) ? weight : 0;
+}
 
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		tip = ELEMENT_DATA(e);
-		if (IF_ISUP(tip->ifp)) {
-			if (tip->weight > 0)
-				weight += tip->weight;
-		} else {
-			if (tip->weight < 0)
-				weight += tip->weight;
-		}
+/* Compute effective priority from the cached tracking weight */
+static void
+vrrp_update_priority(vrrp_rt * vrrp)
+{
+	int new_prio;
+
+	if (vrrp->base_priority == VRRP_PRIO_OWNER) {
+		/* we will not run a PRIO_OWNER into a non-PRIO_OWNER */
+		vrrp->effective_priority = VRRP_PRIO_OWNER;
+		return;
 	}
 
-	return weight;
+	/* WARNING! we must compute new_prio on a signed int in order
+	   to detect overflows and avoid wrapping. */
+	new_prio = vrrp->base_priority + vrrp->track_weight;
+	if (new_prio < 1)
+		new_prio = 1;
+	else if (new_prio > 254)
+		new_prio = 254;
+	vrrp->effective_priority = new_prio;
 }
 
-/* Test if all tracked scripts are either OK or weight-tracked */
-int
-vrrp_script_up(list l)
+/* Keep sync group count of members with a tracked object down */
+static void
+vrrp_track_sync_fault(vrrp_rt * vrrp, int was_up)
 {
-	element e;
-	tracked_sc *tsc;
+	if (vrrp->sync && VRRP_ISUP(vrrp) != was_up)
+		vrrp->sync->num_member_fault += (was_up) ? 1 : -1;
+}
 
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		tsc = ELEMENT_DATA(e);
-		if (!tsc->weight && tsc->scr->result < tsc->scr->rise)
-			return 0;
-	}
+/* Register an instance into a tracked object reverse index */
+static void
+vrrp_track_add(list *l, vrrp_rt * vrrp, int weight, int up)
+{
+	tracking_vrrp *tvp;
 
-	return 1;
+	if (!*l)
+		*l = alloc_list(free_tracking_vrrp, NULL);
+
+	tvp         = (tracking_vrrp *) MALLOC(sizeof (tracking_vrrp));
+	tvp->vrrp   = vrrp;
+	tvp->weight = weight;
+	list_add(*l, tvp);
+
+	/* Account current tracked object state */
+	vrrp->track_weight += vrrp_track_weight(weight, up);
+	if (!weight && !up)
+		vrrp->num_track_fault++;
 }
 
-/* Returns total weights of all tracked scripts :
- * - a positive weight adds to the global weight when the result is OK
- * - a negative weight subtracts from the global weight when the result is bad
- *
+/*
+ * Build the tracking reverse index for an instance and initialize
+ * its cached tracking state. Once done, tracked objects state changes
+ * are pushed to the instance via vrrp_track_*_update() so VRRP_ISUP()
+ * and effective priority never need to walk the tracking lists.
  */
-int
-vrrp_script_weight(list l)
+void
+vrrp_init_track(vrrp_rt * vrrp)
 {
-	element e;
+	tracked_if *tip;
 	tracked_sc *tsc;
-	int weight = 0;
+	tracked_svc *tsv;
+	element e;
+	int was_up = VRRP_ISUP(vrrp);
 
-	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
-		tsc = ELEMENT_DATA(e);
-		if (tsc->scr->result >= tsc->scr->rise) {
-			if (tsc->weight > 0)
-				weight += tsc->weight;
-		} else if (tsc->scr->result < tsc->scr->rise) {
-			if (tsc->weight < 0)
-				weight += tsc->weight;
+	vrrp->num_track_fault = 0;
+	vrrp->track_weight = 0;
+
+	if (!vrrp->dont_track_primary)
+		vrrp_track_add(&vrrp->ifp->tracking_vrrp, vrrp, 0,
+			       IF_ISUP(vrrp->ifp));
+
+	if (!LIST_ISEMPTY(vrrp->track_ifp))
+		for (e = LIST_HEAD(vrrp->track_ifp); e; ELEMENT_NEXT(e)) {
+			tip = ELEMENT_DATA(e);
+			vrrp_track_add(&tip->ifp->tracking_vrrp, vrrp,
+				       tip->weight, IF_ISUP(tip->ifp));
+		}
+
+	if (!LIST_ISEMPTY(vrrp->track_script))
+		for (e = LIST_HEAD(vrrp->track_script); e; ELEMENT_NEXT(e)) {
+			tsc = ELEMENT_DATA(e);
+			vrrp_track_add(&tsc->scr->tracking_vrrp, vrrp,
+				       tsc->weight, SCRIPT_ISUP(tsc->scr));
 		}
+
+	if (!LIST_ISEMPTY(vrrp->track_svc))
+		for (e = LIST_HEAD(vrrp->track_svc); e; ELEMENT_NEXT(e)) {
+			tsv = ELEMENT_DATA(e);
+			vrrp_track_add(&tsv->svc->tracking_vrrp, vrrp,
+				       tsv->weight, tsv->svc->up);
+		}
+
+	vrrp_track_sync_fault(vrrp, was_up);
+	vrrp_update_priority(vrrp);
+}
+
+/* Push a tracked object state change to all instances tracking it */
+static void
+vrrp_track_update(list l, int up)
+{
+	tracking_vrrp *tvp;
+	vrrp_rt *vrrp;
+	element e;
+	int was_up;
+
+	if (LIST_ISEMPTY(l))
+		return;
+
+	for (e = LIST_HEAD(l); e; ELEMENT_NEXT(e)) {
+		tvp = ELEMENT_DATA(e);
+		vrrp = tvp->vrrp;
+		was_up = VRRP_ISUP(vrrp);
+
+		vrrp->track_weight += vrrp_track_weight(tvp->weight, up) -
+				      vrrp_track_weight(tvp->weight, !up);
+		if (!tvp->weight)
+			vrrp->num_track_fault += (up) ? -1 : 1;
+
+		vrrp_track_sync_fault(vrrp, was_up);
+		vrrp_update_priority(vrrp);
 	}
+}
+
+void
+vrrp_track_if_update(interface * ifp, int was_up)
+{
+	int up = IF_ISUP(ifp);
+
+	if (up != was_up)
+		vrrp_track_update(ifp->tracking_vrrp, up);
+}
+
+void
+vrrp_track_script_update(vrrp_script * vscript, int was_up)
+{
+	int up = SCRIPT_ISUP(vscript);
+
+	if (up != was_up)
+		vrrp_track_update(vscript->tracking_vrrp, up);
+}
+
+/* Service state streamed by the healthcheck child */
+void
+vrrp_ipc_handler(ipc_msg * msg)
+{
+	vrrp_svc *svc;
+
+	if (msg->type != IPC_MSG_STATE)
+		return;
+
+	msg->vs[IPC_KEY_LEN - 1] = '\0';
+	msg->rs[IPC_KEY_LEN - 1] = '\0';
+	svc = find_svc(vrrp_data->vrrp_svc, msg->vs, msg->rs);
+	if (!svc || svc->up == !!msg->up)
+		return;
+
+	svc->up = !!msg->up;
+	log_message(LOG_INFO, "VRRP_Service(%s%s%s) is %s", svc->vs,
+	       (svc->rs[0]) ? " " : "", svc->rs, (svc->up) ? "UP" : "DOWN");
+	vrrp_track_update(svc->tracking_vrrp, svc->up);
+}
+
+/* Ask the healthcheck child for every service state */
+void
+vrrp_ipc_resync(void)
+{
+	ipc_msg msg;
+
+	if (LIST_ISEMPTY(vrrp_data->vrrp_svc))
+		return;
 
-	return weight;
+	memset(&msg, 0, sizeof (ipc_msg));
+	msg.type = IPC_MSG_RESYNC;
+	ipc_send(&msg);
 }
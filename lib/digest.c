@@ -0,0 +1,237 @@
+/*
+ * Soft:        Perform a GET query to a remote HTTP/HTTPS server.
+ *              Set a timer to compute global remote server response
+ *              time.
+ *
+ * Part:        HTTP body digests. MD5, SHA1, SHA256 through OpenSSL EVP,
+ *              CRC32C with the SSE4.2 instruction when the CPU has it.
+ *
+ * Authors:     Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "digest.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define CRC32C_SSE42
+#endif
+
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+#define EVP_MD_CTX_new		EVP_MD_CTX_create
+#define EVP_MD_CTX_free		EVP_MD_CTX_destroy
+#endif
+
+static char *digest_names[] = { "md5", "sha1", "sha256", "crc32c" };
+static int digest_lens[] = { MD5_DIGEST_LENGTH, SHA_DIGEST_LENGTH,
+			     SHA256_DIGEST_LENGTH, 4 };
+#define DIGEST_ALGOS	(sizeof (digest_names) / sizeof (digest_names[0]))
+
+/* CRC32C (Castagnoli), reflected polynomial */
+#define CRC32C_POLY	0x82f63b78
+
+static uint32_t crc32c_table[8][256];
+static uint32_t (*crc32c_update) (uint32_t, const unsigned char *, size_t);
+
+/* Portable slice by 8 */
+static uint32_t
+crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	for (; len >= 8; p += 8, len -= 8) {
+		crc ^= p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+		crc = crc32c_table[7][crc & 0xff] ^
+		      crc32c_table[6][(crc >> 8) & 0xff] ^
+		      crc32c_table[5][(crc >> 16) & 0xff] ^
+		      crc32c_table[4][crc >> 24] ^
+		      crc32c_table[3][p[4]] ^ crc32c_table[2][p[5]] ^
+		      crc32c_table[1][p[6]] ^ crc32c_table[0][p[7]];
+	}
+	while (len--)
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef CRC32C_SSE42
+__attribute__ ((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t c;
+
+	for (; len && ((uintptr_t) p & 7); len--)
+		crc = _mm_crc32_u8(crc, *p++);
+	for (c = crc; len >= 8; p += 8, len -= 8)
+		c = _mm_crc32_u64(c, *(const uint64_t *) p);
+	for (crc = c; len; len--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+#endif
+
+static void
+crc32c_setup(void)
+{
+	uint32_t c;
+	int i, k;
+
+#ifdef CRC32C_SSE42
+	if (__builtin_cpu_supports("sse4.2")) {
+		crc32c_update = crc32c_hw;
+		return;
+	}
+#endif
+	for (i = 0; i < 256; i++) {
+		for (c = i, k = 0; k < 8; k++)
+			c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+		crc32c_table[0][i] = c;
+	}
+	for (i = 0; i < 256; i++)
+		for (k = 1; k < 8; k++)
+			crc32c_table[k][i] = (crc32c_table[k - 1][i] >> 8) ^
+			    crc32c_table[0][crc32c_table[k - 1][i] & 0xff];
+	crc32c_update = crc32c_sw;
+}
+
+/* Algorithm from its configuration name, -1 if unknown */
+int
+digest_algo(char *name)
+{
+	int i;
+
+	for (i = 0; i < DIGEST_ALGOS; i++)
+		if (!strcasecmp(name, digest_names[i]))
+			return i;
+	return -1;
+}
+
+char *
+digest_name(int algo)
+{
+	return digest_names[algo];
+}
+
+int
+digest_len(int algo)
+{
+	return digest_lens[algo];
+}
+
+static const EVP_MD *
+digest_md(int algo)
+{
+	switch (algo) {
+	case DIGEST_SHA1:
+		return EVP_sha1();
+	case DIGEST_SHA256:
+		return EVP_sha256();
+	default:
+		return EVP_md5();
+	}
+}
+
+void
+digest_init(digest_ctx * ctx, int algo)
+{
+	ctx->algo = algo;
+	if (algo == DIGEST_CRC32C) {
+		if (!crc32c_update)
+			crc32c_setup();
+		ctx->crc = 0xffffffff;
+		return;
+	}
+
+	if (!ctx->md)
+		ctx->md = EVP_MD_CTX_new();
+	EVP_DigestInit_ex(ctx->md, digest_md(algo), NULL);
+}
+
+void
+digest_update(digest_ctx * ctx, const void *data, size_t len)
+{
+	if (ctx->algo == DIGEST_CRC32C)
+		ctx->crc = (*crc32c_update) (ctx->crc, data, len);
+	else
+		EVP_DigestUpdate(ctx->md, data, len);
+}
+
+/* Binary digest into out, DIGEST_MAX_LEN wide. Returns its length */
+int
+digest_final(digest_ctx * ctx, unsigned char *out)
+{
+	uint32_t crc;
+
+	if (ctx->algo == DIGEST_CRC32C) {
+		/* Big endian, prints as the usual %08x */
+		crc = ~ctx->crc;
+		out[0] = crc >> 24;
+		out[1] = crc >> 16;
+		out[2] = crc >> 8;
+		out[3] = crc;
+	} else
+		EVP_DigestFinal_ex(ctx->md, out, NULL);
+	return digest_lens[ctx->algo];
+}
+
+void
+digest_free(digest_ctx * ctx)
+{
+	if (ctx->md)
+		EVP_MD_CTX_free(ctx->md);
+	ctx->md = NULL;
+}
+
+static int
+hex_val(int c)
+{
+	if (isdigit(c))
+		return c - '0';
+	c = tolower(c);
+	return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+/* Hex string to binary. Returns the digest length, -1 if malformed */
+int
+digest_parse(int algo, char *hex, unsigned char *out)
+{
+	int len = digest_lens[algo];
+	int i, h, l;
+
+	if (strlen(hex) != 2 * len)
+		return -1;
+	for (i = 0; i < len; i++) {
+		h = hex_val((unsigned char) hex[2 * i]);
+		l = hex_val((unsigned char) hex[2 * i + 1]);
+		if (h < 0 || l < 0)
+			return -1;
+		out[i] = h << 4 | l;
+	}
+	return len;
+}
+
+/* Binary to hex, hex is 2 * len + 1 wide */
+void
+digest_hex(unsigned char *bin, int len, char *hex)
+{
+	static const char digits[] = "0123456789abcdef";
+	int i;
+
+	for (i = 0; i < len; i++) {
+		hex[2 * i] = digits[bin[i] >> 4];
+		hex[2 * i + 1] = digits[bin[i] & 0x0f];
+	}
+	hex[2 * len] = '\0';
+}
@@ -0,0 +1,58 @@
+/*
+ * Soft:        Perform a GET query to a remote HTTP/HTTPS server.
+ *              Set a timer to compute global remote server response
+ *              time.
+ *
+ * Part:        digest.c include file.
+ *
+ * Authors:     Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _DIGEST_H
+#define _DIGEST_H
+
+/* system includes */
+#include <stdint.h>
+#include <openssl/evp.h>
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+
+/* Body digest algorithms */
+#define DIGEST_MD5	0		/* default */
+#define DIGEST_SHA1	1
+#define DIGEST_SHA256	2
+#define DIGEST_CRC32C	3		/* SSE4.2 when available */
+
+#define DIGEST_MAX_LEN	SHA256_DIGEST_LENGTH
+
+/* md is allocated on first use and kept until digest_free() */
+typedef struct _digest_ctx {
+	int algo;
+	EVP_MD_CTX *md;
+	uint32_t crc;
+} digest_ctx;
+
+/* Prototypes */
+extern int digest_algo(char *name);
+extern char *digest_name(int algo);
+extern int digest_len(int algo);
+extern void digest_init(digest_ctx * ctx, int algo);
+extern void digest_update(digest_ctx * ctx, const void *data, size_t len);
+extern int digest_final(digest_ctx * ctx, unsigned char *out);
+extern void digest_free(digest_ctx * ctx);
+extern int digest_parse(int algo, char *hex, unsigned char *out);
+extern void digest_hex(unsigned char *bin, int len, char *hex);
+
+#endif
@@ -3,7 +3,7 @@
  *              Set a timer to compute global remote server response
  *              time.
  *
- * Part:        HTML stream parser utility functions.
+ * Part:        HTTP response stream parser.
  *
  * Authors:     Alexandre Cassen, <acassen@linux-vs.org>
  *
@@ -23,71 +23,235 @@
 #include <string.h>
 #include <stdlib.h>
 #include "html.h"
-#include "memory.h"
 
-/* Return the http header content length */
-int extract_content_length(char *buffer, int size)
+/* Parser states */
+#define HTTP_ST_STATUS		0	/* status line */
+#define HTTP_ST_HEADER		1	/* header lines */
+#define HTTP_ST_BODY		2	/* Content-Length body */
+#define HTTP_ST_CHUNK		3	/* chunk size line */
+#define HTTP_ST_CHUNK_DATA	4
+#define HTTP_ST_CHUNK_END	5	/* CRLF closing chunk data */
+#define HTTP_ST_TRAILER		6
+#define HTTP_ST_CLOSE		7	/* body up to connection close */
+#define HTTP_ST_END		8	/* complete, not reported yet */
+#define HTTP_ST_DONE		9
+#define HTTP_ST_ERROR		10
+
+void
+http_parser_init(http_parser * p, int head)
+{
+	p->state = HTTP_ST_STATUS;
+	p->status_code = 0;
+	p->keepalive = 0;
+	p->chunked = 0;
+	p->head = head;
+	p->headers = 0;
+	p->remain = -1;
+	p->data = NULL;
+	p->data_len = 0;
+	p->line_len = 0;
+}
+
+/*
+ * Gather the current line, CR/LF stripped. Returns 1 once it is
+ * complete, 0 if the input ran out first.
+ */
+static int
+http_parse_line(http_parser * p, char **cur, char *end)
+{
+	char c;
+
+	while (*cur < end) {
+		c = *(*cur)++;
+		if (c == '\n') {
+			if (p->line_len && p->line[p->line_len - 1] == '\r')
+				p->line_len--;
+			p->line[p->line_len] = '\0';
+			return 1;
+		}
+		if (p->line_len < HTTP_LINE_MAX - 1)
+			p->line[p->line_len++] = c;
+	}
+	return 0;
+}
+
+/* Case insensitive search of a token in a header value */
+static int
+http_token(char *val, char *token)
+{
+	int len = strlen(token);
+
+	for (; *val; val++)
+		if (!strncasecmp(val, token, len))
+			return 1;
+	return 0;
+}
+
+/*
+ * Status line. According to rfc2616.6.1 the status code is between
+ * HTTP-Version and Reason-Phrase, separated by a space.
+ */
+static int
+http_parse_status(http_parser * p)
 {
-	char *clen = strstr(buffer, CONTENT_LENGTH);
-	char *content_buffer = NULL;
-	char *buf_len;
-	int inc = 0;
-	int i;
+	char *s = p->line;
 
-	/* Allocate the room */
-	buf_len = (char *)MALLOC(40);
+	if (strncmp(s, "HTTP/1.", 7) || !s[7])
+		return -1;
+	p->keepalive = (s[7] != '0');
+	for (s += 8; *s == ' '; s++) ;
+	if (*s < '0' || *s > '9')
+		return -1;
+	p->status_code = strtol(s, NULL, 10);
+	p->chunked = 0;
+	p->remain = -1;
+	return 0;
+}
 
-	/* Pattern not found */
-	if (!clen)
+static int
+http_parse_header(http_parser * p)
+{
+	char *val = strchr(p->line, ':');
+
+	if (!val)
 		return 0;
+	*val++ = '\0';
 
-	/* Content-Length extraction */
-	while (*(clen++) != ':');
-	content_buffer = clen;
-	while (*(clen++) != '\r' && *clen != '\n')
-		inc++;
-	for (i = 0; i < inc; i++)
-		strncat(buf_len, content_buffer+i, 1);
-	i = atoi(buf_len);
-	FREE(buf_len);
-	return i;
+	if (!strcasecmp(p->line, "Content-Length")) {
+		p->remain = strtol(val, NULL, 10);
+		if (p->remain < 0)
+			return -1;
+	} else if (!strcasecmp(p->line, "Transfer-Encoding"))
+		p->chunked = http_token(val, "chunked");
+	else if (!strcasecmp(p->line, "Connection")) {
+		if (http_token(val, "close"))
+			p->keepalive = 0;
+		else if (http_token(val, "keep-alive"))
+			p->keepalive = 1;
+	}
+	return 0;
+}
+
+/* Headers are over, set up body framing. Returns 0 on interim response */
+static int
+http_parse_framing(http_parser * p)
+{
+	if (p->status_code >= 100 && p->status_code < 200) {
+		p->state = HTTP_ST_STATUS;
+		return 0;
+	}
+
+	p->headers = 1;
+	if (p->head || p->status_code == 204 || p->status_code == 304)
+		p->state = HTTP_ST_END;
+	else if (p->chunked)
+		p->state = HTTP_ST_CHUNK;
+	else if (p->remain >= 0)
+		p->state = (p->remain) ? HTTP_ST_BODY : HTTP_ST_END;
+	else {
+		p->state = HTTP_ST_CLOSE;
+		p->keepalive = 0;
+	}
+	return 1;
 }
 
 /*
- * Return the http header error code. According
- * to rfc2616.6.1 status code is between HTTP_Version
- * and Reason_Phrase, separated by space caracter.
+ * Run the parser over [*cur, end) up to the next event. *cur is left
+ * after the bytes consumed : on HTTP_PARSE_DONE, what follows belongs
+ * to the next response.
  */
-int extract_status_code(char *buffer, int size)
+int
+http_parse(http_parser * p, char **cur, char *end)
 {
-	char *buf_code;
-	char *begin;
-	char *end = buffer + size;
-	int inc = 0;
-
-	/* Allocate the room */
-	buf_code = (char *)MALLOC(10);
-
-	/* Status-Code extraction */
-	while (buffer < end && *buffer++ != ' ') ;
-	begin = buffer;
-	while (buffer < end && *buffer++ != ' ')
-		inc++;
-	strncat(buf_code, begin, inc);
-	inc = atoi(buf_code);
-	FREE(buf_code);
-	return inc;
+	char *e;
+	long n;
+
+	while (1) {
+		switch (p->state) {
+		case HTTP_ST_STATUS:
+			if (!http_parse_line(p, cur, end))
+				return HTTP_PARSE_MORE;
+			/* Stray empty lines ahead are tolerated */
+			if (p->line_len && http_parse_status(p) < 0)
+				goto error;
+			if (p->line_len)
+				p->state = HTTP_ST_HEADER;
+			p->line_len = 0;
+			break;
+		case HTTP_ST_HEADER:
+			if (!http_parse_line(p, cur, end))
+				return HTTP_PARSE_MORE;
+			n = p->line_len;
+			p->line_len = 0;
+			if (n) {
+				if (http_parse_header(p) < 0)
+					goto error;
+			} else if (http_parse_framing(p))
+				return HTTP_PARSE_HEADERS;
+			break;
+		case HTTP_ST_BODY:
+		case HTTP_ST_CHUNK_DATA:
+			if (*cur == end)
+				return HTTP_PARSE_MORE;
+			n = (p->remain < end - *cur) ? p->remain : end - *cur;
+			p->data = *cur;
+			p->data_len = n;
+			*cur += n;
+			p->remain -= n;
+			if (!p->remain)
+				p->state = (p->state == HTTP_ST_BODY) ?
+					   HTTP_ST_END : HTTP_ST_CHUNK_END;
+			return HTTP_PARSE_DATA;
+		case HTTP_ST_CHUNK_END:
+			if (!http_parse_line(p, cur, end))
+				return HTTP_PARSE_MORE;
+			if (p->line_len)
+				goto error;
+			p->state = HTTP_ST_CHUNK;
+			break;
+		case HTTP_ST_CHUNK:
+			if (!http_parse_line(p, cur, end))
+				return HTTP_PARSE_MORE;
+			p->remain = strtol(p->line, &e, 16);
+			if (e == p->line || p->remain < 0)
+				goto error;
+			p->line_len = 0;
+			p->state = (p->remain) ? HTTP_ST_CHUNK_DATA :
+						 HTTP_ST_TRAILER;
+			break;
+		case HTTP_ST_TRAILER:
+			if (!http_parse_line(p, cur, end))
+				return HTTP_PARSE_MORE;
+			if (!p->line_len)
+				p->state = HTTP_ST_END;
+			p->line_len = 0;
+			break;
+		case HTTP_ST_CLOSE:
+			if (*cur == end)
+				return HTTP_PARSE_MORE;
+			p->data = *cur;
+			p->data_len = end - *cur;
+			*cur = end;
+			return HTTP_PARSE_DATA;
+		case HTTP_ST_END:
+			p->state = HTTP_ST_DONE;
+			return HTTP_PARSE_DONE;
+		case HTTP_ST_DONE:
+			return HTTP_PARSE_DONE;
+		default:
+			return HTTP_PARSE_ERROR;
+		}
+	}
+
+      error:
+	p->state = HTTP_ST_ERROR;
+	return HTTP_PARSE_ERROR;
 }
 
-/* simple function returning a pointer to the html buffer begin */
-char *extract_html(char *buffer, int size_buffer)
+/* Connection closed, tell if this completes the response */
+int
+http_parse_eof(http_parser * p)
 {
-	char *end = buffer + size_buffer;
-	char *cur;
-
-	for (cur = buffer; cur + 3 < end; cur++)
-		if (*cur == '\r' && *(cur+1) == '\n'
-		    && *(cur+2) == '\r' && *(cur+3) == '\n')
-			return cur + 4;
-	return NULL;
+	return p->state == HTTP_ST_CLOSE || p->state == HTTP_ST_END ||
+	       p->state == HTTP_ST_DONE;
 }
@@ -23,12 +23,37 @@
 #ifndef _HTML_H
 #define _HTML_H
 
-/* HTTP header tag */
-#define CONTENT_LENGTH	"Content-Length:"
+/* Longest status, header or chunk line kept, the rest is ignored */
+#define HTTP_LINE_MAX		128
+
+/* http_parse() events */
+#define HTTP_PARSE_ERROR	-1	/* malformed response */
+#define HTTP_PARSE_MORE		0	/* all the input was consumed */
+#define HTTP_PARSE_HEADERS	1	/* status line and headers complete */
+#define HTTP_PARSE_DATA		2	/* body segment in data/data_len */
+#define HTTP_PARSE_DONE		3	/* response complete */
+
+/*
+ * Streaming HTTP/1.x response parser. Input may be split anywhere,
+ * nothing is allocated and no input byte is looked at twice.
+ */
+typedef struct _http_parser {
+	int state;
+	int status_code;
+	int keepalive;		/* server keeps the connection open */
+	int chunked;
+	int head;		/* response to a HEAD request, no body */
+	int headers;		/* final status line and headers parsed */
+	long remain;		/* body or chunk bytes left, -1 unknown */
+	char *data;		/* body segment of HTTP_PARSE_DATA */
+	int data_len;
+	int line_len;
+	char line[HTTP_LINE_MAX];
+} http_parser;
 
 /* Prototypes */
-extern int extract_content_length(char *buffer, int size);
-extern int extract_status_code(char *buffer, int size);
-extern char *extract_html(char *buffer, int size_buffer);
+extern void http_parser_init(http_parser * p, int head);
+extern int http_parse(http_parser * p, char **cur, char *end);
+extern int http_parse_eof(http_parser * p);
 
 #endif
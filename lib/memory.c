@@ -27,6 +27,7 @@
 
 /* Global var */
 unsigned long mem_allocated;	/* Total memory used in Bytes */
+unsigned long mem_allocs;	/* Number of allocations, never reset */
 
 void *
 xalloc(unsigned long size)
@@ -34,6 +35,7 @@ xalloc(unsigned long size)
 	void *mem;
 	if ((mem = malloc(size)))
 		mem_allocated += size;
+	mem_allocs++;
 	return mem;
 }
 
@@ -45,6 +47,7 @@ zalloc(unsigned long size)
 		memset(mem, 0, size);
 		mem_allocated += size;
 	}
+	mem_allocs++;
 	return mem;
 }
 
@@ -33,6 +33,7 @@
 
 /* extern types */
 extern unsigned long mem_allocated;
+extern unsigned long mem_allocs;
 extern void *xalloc(unsigned long size);
 extern void *zalloc(unsigned long size);
 extern void xfree(void *p);
@@ -443,6 +443,41 @@ thread_cancel_event(thread_master * m, void *arg)
 	}
 }
 
+/* Delete all threads running func, optionally restricted to argument arg. */
+static void
+thread_cancel_list(thread_master * m, thread_list * list, fd_set * fds,
+		   int (*func) (thread *), void *arg)
+{
+	thread *thread_obj;
+
+	thread_obj = list->head;
+	while (thread_obj) {
+		struct _thread *t;
+
+		t = thread_obj;
+		thread_obj = t->next;
+
+		if (t->func == func && (!arg || t->arg == arg)) {
+			if (fds)
+				FD_CLR(t->u.fd, fds);
+			thread_list_delete(list, t);
+			t->type = THREAD_UNUSED;
+			thread_add_unuse(m, t);
+		}
+	}
+}
+
+void
+thread_cancel_func(thread_master * m, int (*func) (thread *), void *arg)
+{
+	thread_cancel_list(m, &m->read, &m->readfd, func, arg);
+	thread_cancel_list(m, &m->write, &m->writefd, func, arg);
+	thread_cancel_list(m, &m->timer, NULL, func, arg);
+	thread_cancel_list(m, &m->child, NULL, func, arg);
+	thread_cancel_list(m, &m->event, NULL, func, arg);
+	thread_cancel_list(m, &m->ready, NULL, func, arg);
+}
+
 /* Update timer value */
 static void
 thread_update_timer(thread_list *list, TIMEVAL *timer_min)
@@ -119,6 +119,7 @@ extern thread *thread_add_event(thread_master * m, int (*func) (thread *)
 				, void *arg, int val);
 extern void thread_cancel(thread * thread_obj);
 extern void thread_cancel_event(thread_master * m, void *arg);
+extern void thread_cancel_func(thread_master * m, int (*func) (thread *), void *arg);
 extern thread *thread_fetch(thread_master * m, thread * fetch);
 extern void thread_child_handler(void * v, int sig);
 extern void thread_call(thread * thread_obj);
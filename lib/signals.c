@@ -42,6 +42,8 @@ void (*signal_SIGTERM_handler) (void *, int sig);
 void *signal_SIGTERM_v;
 void (*signal_SIGCHLD_handler) (void *, int sig);
 void *signal_SIGCHLD_v;
+void (*signal_SIGUSR2_handler) (void *, int sig);
+void *signal_SIGUSR2_v;
 
 static int signal_pipe[2] = { -1, -1 };
 
@@ -105,6 +107,10 @@ signal_set(int signo, void (*func) (void *, int), void *v)
 		signal_SIGCHLD_handler = func;
 		signal_SIGCHLD_v = v;
 		break;
+	case SIGUSR2:
+		signal_SIGUSR2_handler = func;
+		signal_SIGUSR2_v = v;
+		break;
 	}
 
 	if (ret < 0)
@@ -134,6 +140,7 @@ signal_handler_init(void)
 	signal_SIGINT_handler = NULL;
 	signal_SIGTERM_handler = NULL;
 	signal_SIGCHLD_handler = NULL;
+	signal_SIGUSR2_handler = NULL;
 }
 
 void
@@ -150,12 +157,14 @@ signal_wait_handlers(void)
 	sigaction(SIGINT, &sig, NULL);
 	sigaction(SIGTERM, &sig, NULL);
 	sigaction(SIGCHLD, &sig, NULL);
+	sigaction(SIGUSR2, &sig, NULL);
 
 	/* reset */
 	signal_SIGHUP_v = NULL;
 	signal_SIGINT_v = NULL;
 	signal_SIGTERM_v = NULL;
 	signal_SIGCHLD_v = NULL;
+	signal_SIGUSR2_v = NULL;
 }
 
 void signal_reset(void)
@@ -165,6 +174,7 @@ void signal_reset(void)
 	signal_SIGINT_handler = NULL;
 	signal_SIGTERM_handler = NULL;
 	signal_SIGCHLD_handler = NULL;
+	signal_SIGUSR2_handler = NULL;
 }
 
 void
@@ -207,6 +217,10 @@ signal_run_callback(void)
 			if (signal_SIGCHLD_handler)
 				signal_SIGCHLD_handler(signal_SIGCHLD_v, SIGCHLD);
 			break;
+		case SIGUSR2:
+			if (signal_SIGUSR2_handler)
+				signal_SIGUSR2_handler(signal_SIGUSR2_v, SIGUSR2);
+			break;
 		default:
 			break;
 		}	
@@ -20,6 +20,8 @@
  * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
  */
 
+#include <fcntl.h>
+#include <unistd.h>
 #include "utils.h"
 
 /* global vars */
@@ -225,6 +227,26 @@ inet_cidrtomask(uint8_t cidr)
 	return ntohl(mask);
 }
 
+/*
+ * Create or truncate a root owned report file. A symlink planted in
+ * its place is not followed.
+ */
+FILE *
+fopen_report(char *path)
+{
+	FILE *fp;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC,
+		  0600);
+	if (fd < 0)
+		return NULL;
+	fp = fdopen(fd, "w");
+	if (!fp)
+		close(fd);
+	return fp;
+}
+
 /* Getting localhost official canonical name */
 char *
 get_local_name(void)
@@ -54,6 +54,7 @@ extern uint8_t inet_stor(char *addr);
 extern int inet_ston(const char *addr, uint32_t *dst);
 uint32_t inet_broadcast(uint32_t network, uint32_t netmask);
 uint32_t inet_cidrtomask(uint8_t cidr);
+extern FILE *fopen_report(char *path);
 extern char *get_local_name(void);
 
 #endif
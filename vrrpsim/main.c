@@ -0,0 +1,751 @@
+/*
+ * Soft:        Deterministic VRRP simulator. Runs the keepalived VRRP
+ *              state machine of N routers against an in-memory LAN
+ *              and a virtual clock.
+ *
+ * Part:        Coordinator. Forks the nodes, owns the virtual clock and
+ *              the LAN, injects faults and reports convergence.
+ *
+ * Authors:     Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+/* global includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <popt.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+/* local includes */
+#include "sim.h"
+
+#define SEC		1000000LL
+#define MAX_EVENTS	64
+#define MAX_PHASES	(MAX_EVENTS + 1)
+
+enum { EV_CRASH, EV_RESTART, EV_ISOLATE, EV_HEAL, EV_LOSS };
+static const char *ev_name[] = { "crash", "restart", "isolate", "heal", "loss" };
+
+typedef struct _sim_event {
+	long long time;
+	int type;
+	int arg;
+} sim_event;
+
+typedef struct _sim_node {
+	pid_t pid;
+	int ctl;
+	int alive;
+	int isolated;
+	int running;		/* not blocked in SIM_WAIT */
+	int woken;		/* got deliveries this step */
+	int gen;		/* restarts, stale packets are dropped */
+	long long deadline;	/* relative usec, SIM_NOWAIT if none */
+} sim_node;
+
+/* In-flight packet, ordered by (time, seq) */
+typedef struct _sim_pkt {
+	long long time;
+	unsigned long seq;
+	int node;
+	int gen;
+	int ifindex;
+	int proto;
+	int len;
+	char *data;
+} sim_pkt;
+
+typedef struct _sim_phase {
+	long long start;
+	const char *label;
+	int arg;
+	long long last_change;	/* -1 if no VIP moved */
+	long long dual_us;	/* VIP-usec with more than one owner */
+	long long none_us;	/* VIP-usec with no owner */
+	long long dual_max;	/* longest dual master window */
+	unsigned long moves;
+	int converged;
+} sim_phase;
+
+/* Configuration */
+static sim_conf conf = { 3, 16, 1, 0 };
+static int sim_time = 60;
+static int loss;		/* percent, changed by loss events */
+static int loss_start;
+static long long delay;		/* usec */
+static long long jitter;	/* usec */
+static unsigned long long seed = 1;
+static unsigned long long rng_state;
+static sim_event events[MAX_EVENTS];
+static int nr_events;
+
+/* State */
+static long long now;
+static sim_node nodes[SIM_MAX_NODES];
+static sim_pkt *heap;
+static int heap_len, heap_size;
+static unsigned long heap_seq;
+
+static unsigned char *held;	/* [node * instances + i] */
+static int *owners;		/* owner count per instance */
+static long long *dual_since;
+static int nr_dual, nr_none;
+
+static sim_phase phases[MAX_PHASES];
+static int nr_phases;
+static sim_phase *phase;
+
+static unsigned long adverts, delivered, lost, dropped;
+
+/*
+ * More adverts in one simulated second than every node advertising
+ * every instance is a storm: lower priority adverts are answered at
+ * once, so they can cascade without the clock moving. Stop there.
+ */
+static long long storm_second = -1;
+static unsigned long storm_adverts;
+static int storm;
+
+/* Deterministic PRNG, xorshift64* */
+static unsigned long long
+rng(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 2685821657736338717ULL;
+}
+
+/* Packet heap */
+static int
+pkt_before(sim_pkt * a, sim_pkt * b)
+{
+	if (a->time != b->time)
+		return a->time < b->time;
+	return a->seq < b->seq;
+}
+
+static void
+heap_push(sim_pkt * p)
+{
+	sim_pkt tmp;
+	int i, up;
+
+	if (heap_len == heap_size) {
+		heap_size = heap_size ? heap_size * 2 : 1024;
+		heap = realloc(heap, heap_size * sizeof (sim_pkt));
+		if (!heap) {
+			fprintf(stderr, "out of memory\n");
+			exit(2);
+		}
+	}
+	p->seq = heap_seq++;
+	i = heap_len++;
+	heap[i] = *p;
+	while (i && pkt_before(&heap[i], &heap[up = (i - 1) / 2])) {
+		tmp = heap[i];
+		heap[i] = heap[up];
+		heap[up] = tmp;
+		i = up;
+	}
+}
+
+static void
+heap_pop(sim_pkt * p)
+{
+	sim_pkt tmp;
+	int i = 0, c;
+
+	*p = heap[0];
+	heap[0] = heap[--heap_len];
+	while ((c = 2 * i + 1) < heap_len) {
+		if (c + 1 < heap_len && pkt_before(&heap[c + 1], &heap[c]))
+			c++;
+		if (!pkt_before(&heap[c], &heap[i]))
+			break;
+		tmp = heap[i];
+		heap[i] = heap[c];
+		heap[c] = tmp;
+		i = c;
+	}
+}
+
+/* Ownership accounting */
+static void
+owner_set(int n, int i, int set)
+{
+	unsigned char *h = &held[n * conf.instances + i];
+	int before = owners[i];
+
+	if (*h == set)
+		return;
+	*h = set;
+	owners[i] += set ? 1 : -1;
+
+	if (before == 0)
+		nr_none--;
+	if (owners[i] == 0)
+		nr_none++;
+	if (before < 2 && owners[i] >= 2) {
+		nr_dual++;
+		dual_since[i] = now;
+	}
+	if (before >= 2 && owners[i] < 2) {
+		nr_dual--;
+		if (now - dual_since[i] > phase->dual_max)
+			phase->dual_max = now - dual_since[i];
+	}
+	phase->last_change = now;
+	phase->moves++;
+}
+
+static void
+account(long long t)
+{
+	phase->dual_us += nr_dual * (t - now);
+	phase->none_us += nr_none * (t - now);
+	now = t;
+}
+
+static void
+phase_start(const char *label, int arg)
+{
+	if (phase)
+		phase->converged = !nr_dual && !nr_none;
+	phase = &phases[nr_phases++];
+	memset(phase, 0, sizeof (sim_phase));
+	phase->start = now;
+	phase->label = label;
+	phase->arg = arg;
+	phase->last_change = -1;
+}
+
+/* Nodes */
+static void
+node_send(int n, sim_msg * msg, void *data)
+{
+	char buf[SIM_MSG_MAX];
+
+	memcpy(buf, msg, sizeof (sim_msg));
+	if (msg->len)
+		memcpy(buf + sizeof (sim_msg), data, msg->len);
+	send(nodes[n].ctl, buf, sizeof (sim_msg) + msg->len, MSG_NOSIGNAL);
+}
+
+static void
+node_start(int n)
+{
+	int sv[2], i, size = 1 << 20;
+	pid_t pid;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+		perror("socketpair");
+		exit(2);
+	}
+	setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof (size));
+	setsockopt(sv[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof (size));
+
+	fflush(NULL);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(2);
+	}
+	if (!pid) {
+		close(sv[0]);
+		for (i = 0; i < conf.nodes; i++)
+			if (nodes[i].alive)
+				close(nodes[i].ctl);
+		sim_node_run(&conf, n, sv[1], SIM_EPOCH + now);
+	}
+
+	close(sv[1]);
+	nodes[n].pid = pid;
+	nodes[n].ctl = sv[0];
+	nodes[n].alive = 1;
+	nodes[n].running = 1;
+	nodes[n].woken = 0;
+	nodes[n].deadline = SIM_NOWAIT;
+}
+
+static void
+node_stop(int n, int sig)
+{
+	int i;
+
+	if (!nodes[n].alive)
+		return;
+	if (sig)
+		kill(nodes[n].pid, sig);
+	else {
+		sim_msg msg;
+
+		memset(&msg, 0, sizeof (msg));
+		msg.type = SIM_STOP;
+		node_send(n, &msg, NULL);
+	}
+	waitpid(nodes[n].pid, NULL, 0);
+	close(nodes[n].ctl);
+	nodes[n].alive = 0;
+	nodes[n].gen++;
+
+	/* A crashed router holds nothing, a stopped one keeps its VIPs */
+	for (i = 0; sig && i < conf.instances; i++)
+		owner_set(n, i, 0);
+}
+
+/* A node sent an advert: put a copy on the wire for each peer */
+static void
+node_pkt(int n, sim_msg * msg, char *data)
+{
+	sim_pkt p;
+	int i;
+
+	adverts++;
+	if (now / SEC != storm_second) {
+		storm_second = now / SEC;
+		storm_adverts = 0;
+	}
+	if (++storm_adverts > (unsigned long) conf.nodes * conf.instances)
+		storm = 1;
+
+	for (i = 0; i < conf.nodes; i++) {
+		if (i == n || !nodes[i].alive)
+			continue;
+		if (nodes[n].isolated || nodes[i].isolated) {
+			dropped++;
+			continue;
+		}
+		if (loss && (int) (rng() % 100) < loss) {
+			lost++;
+			continue;
+		}
+		p.time = now + delay;
+		if (jitter)
+			p.time += rng() % (jitter + 1);
+		p.node = i;
+		p.gen = nodes[i].gen;
+		p.ifindex = msg->ifindex;
+		p.proto = msg->proto;
+		p.len = msg->len;
+		p.data = malloc(msg->len);
+		memcpy(p.data, data, msg->len);
+		heap_push(&p);
+	}
+}
+
+static void
+node_addr(int n, sim_msg * msg)
+{
+	long i = (long) ntohl(msg->addr) - SIM_VIP_BASE - 1;
+
+	if (i < 0 || i >= conf.instances)
+		return;
+	owner_set(n, i, msg->type == SIM_ADDR_ADD);
+}
+
+/*
+ * Drain the nodes in index order until each one blocks. Every node is
+ * deterministic given its inputs, so handling their output in a fixed
+ * order makes the whole run reproducible.
+ */
+static void
+collect(void)
+{
+	char buf[SIM_MSG_MAX];
+	sim_msg *msg = (sim_msg *) buf;
+	int n, len;
+
+	for (n = 0; n < conf.nodes; n++) {
+		while (nodes[n].alive && nodes[n].running) {
+			len = recv(nodes[n].ctl, buf, sizeof (buf), 0);
+			if (len < (int) sizeof (sim_msg)) {
+				fprintf(stderr, "node%d exited unexpectedly\n", n);
+				node_stop(n, SIGKILL);
+				break;
+			}
+			switch (msg->type) {
+			case SIM_WAIT:
+				nodes[n].running = 0;
+				nodes[n].deadline = (msg->time == SIM_NOWAIT) ?
+						    SIM_NOWAIT : msg->time - SIM_EPOCH;
+				break;
+			case SIM_PKT:
+				node_pkt(n, msg, buf + sizeof (sim_msg));
+				break;
+			case SIM_ADDR_ADD:
+			case SIM_ADDR_DEL:
+				node_addr(n, msg);
+				break;
+			}
+		}
+	}
+}
+
+static long long
+next_time(int ev, long long end)
+{
+	long long t = end;
+	int n;
+
+	for (n = 0; n < conf.nodes; n++)
+		if (nodes[n].alive && nodes[n].deadline != SIM_NOWAIT &&
+		    nodes[n].deadline < t)
+			t = nodes[n].deadline;
+	if (heap_len && heap[0].time < t)
+		t = heap[0].time;
+	if (ev < nr_events && events[ev].time < t)
+		t = events[ev].time;
+	return (t < now) ? now : t;
+}
+
+static void
+apply_event(sim_event * e)
+{
+	int n = e->arg;
+
+	phase_start(ev_name[e->type], e->arg);
+	switch (e->type) {
+	case EV_CRASH:
+		node_stop(n, SIGKILL);
+		break;
+	case EV_RESTART:
+		if (!nodes[n].alive)
+			node_start(n);
+		break;
+	case EV_ISOLATE:
+		nodes[n].isolated = 1;
+		break;
+	case EV_HEAL:
+		nodes[n].isolated = 0;
+		break;
+	case EV_LOSS:
+		loss = e->arg;
+		break;
+	}
+}
+
+static void
+deliver(void)
+{
+	sim_msg msg;
+	sim_pkt p;
+	int n;
+
+	while (heap_len && heap[0].time <= now) {
+		heap_pop(&p);
+		n = p.node;
+		if (nodes[n].alive && nodes[n].gen == p.gen && !nodes[n].isolated) {
+			memset(&msg, 0, sizeof (msg));
+			msg.type = SIM_DELIVER;
+			msg.ifindex = p.ifindex;
+			msg.proto = p.proto;
+			msg.len = p.len;
+			node_send(n, &msg, p.data);
+			nodes[n].woken = 1;
+			delivered++;
+		} else
+			dropped++;
+		free(p.data);
+	}
+}
+
+static void
+wake(void)
+{
+	sim_msg msg;
+	int n;
+
+	memset(&msg, 0, sizeof (msg));
+	msg.type = SIM_RUN;
+	msg.time = SIM_EPOCH + now;
+	for (n = 0; n < conf.nodes; n++) {
+		if (!nodes[n].alive || nodes[n].running)
+			continue;
+		if (nodes[n].woken ||
+		    (nodes[n].deadline != SIM_NOWAIT && nodes[n].deadline <= now)) {
+			nodes[n].woken = 0;
+			nodes[n].running = 1;
+			node_send(n, &msg, NULL);
+		}
+	}
+}
+
+static void
+simulate(void)
+{
+	long long end = sim_time * SEC;
+	int n, ev = 0;
+
+	phase_start("start", -1);
+	for (n = 0; n < conf.nodes; n++)
+		node_start(n);
+
+	for (;;) {
+		collect();
+		if (storm)
+			break;
+		account(next_time(ev, end));
+		if (now >= end)
+			break;
+		while (ev < nr_events && events[ev].time <= now)
+			apply_event(&events[ev++]);
+		deliver();
+		wake();
+	}
+
+	/* Close the dual master windows still open */
+	for (n = 0; n < conf.instances; n++)
+		if (owners[n] >= 2 && now - dual_since[n] > phase->dual_max)
+			phase->dual_max = now - dual_since[n];
+	phase->converged = !storm && !nr_dual && !nr_none;
+
+	for (n = 0; n < conf.nodes; n++)
+		node_stop(n, 0);
+}
+
+/* Report */
+static void
+report(void)
+{
+	struct rusage ru;
+	double cpu;
+	sim_phase *p;
+	int i, single = 0, preferred = 0;
+
+	getrusage(RUSAGE_CHILDREN, &ru);
+	cpu = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e6 +
+	      ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+
+	printf("nodes %d, instances %d, advert %ds, loss %d%%, delay %lldms"
+	       " +%lldms, seed %llu, %ds simulated\n",
+	       conf.nodes, conf.instances, conf.advert_int, loss_start,
+	       delay / 1000, jitter / 1000, seed, sim_time);
+	printf("adverts: %lu sent, %lu delivered, %lu lost, %lu dropped\n",
+	       adverts, delivered, lost, dropped);
+	printf("node CPU: %.3fs, %.1fus per advert sent\n", cpu / 1e6,
+	       adverts ? cpu / adverts : 0.0);
+	if (storm)
+		printf("advert storm: more than %d adverts in second %lld,"
+		       " stopped at %.6fs\n", conf.nodes * conf.instances,
+		       storm_second, now / 1e6);
+	printf("\n");
+
+	printf("%-10s %-12s %-14s %-8s %-12s %-12s %s\n", "time", "event",
+	       "convergence", "moves", "dual VIP-s", "none VIP-s",
+	       "max dual");
+	for (i = 0; i < nr_phases; i++) {
+		char ev[32], cv[32];
+
+		p = &phases[i];
+		if (p->arg >= 0)
+			snprintf(ev, sizeof (ev), "%s:%d", p->label, p->arg);
+		else
+			snprintf(ev, sizeof (ev), "%s", p->label);
+		if (!p->converged)
+			snprintf(cv, sizeof (cv), "no");
+		else if (p->last_change < 0)
+			snprintf(cv, sizeof (cv), "0.000s");
+		else
+			snprintf(cv, sizeof (cv), "%.3fs",
+				 (p->last_change - p->start) / 1e6);
+		printf("%-10.3f %-12s %-14s %-8lu %-12.3f %-12.3f %.3fs\n",
+		       p->start / 1e6, ev, cv, p->moves, p->dual_us / 1e6,
+		       p->none_us / 1e6, p->dual_max / 1e6);
+	}
+
+	/* The preferred master of instance i is node i % nodes */
+	for (i = 0; i < conf.instances; i++) {
+		if (owners[i] != 1)
+			continue;
+		single++;
+		if (held[(i % conf.nodes) * conf.instances + i])
+			preferred++;
+	}
+	printf("\nVIPs with a single master: %d/%d, on their preferred node: %d\n",
+	       single, conf.instances, preferred);
+}
+
+/* Command line */
+static void
+usage(const char *prog)
+{
+	fprintf(stderr,
+		"\nUsage:\n"
+		"  %s [options]\n\n", prog);
+	fprintf(stderr,
+		"Options:\n"
+		"Either long or short options are allowed.\n"
+		"  %s --nodes        -n    Number of routers. (default=3)\n"
+		"  %s --instances    -i    VRRP instances per router. (default=16)\n"
+		"  %s --time         -t    Simulated seconds. (default=60)\n"
+		"  %s --advert       -a    Advert interval in seconds. (default=1)\n"
+		"  %s --loss         -l    Advert loss in percent.\n"
+		"  %s --delay        -d    Advert delay in ms.\n"
+		"  %s --jitter       -j    Extra random advert delay in ms.\n"
+		"  %s --seed         -s    PRNG seed. (default=1)\n"
+		"  %s --event        -e    T:crash|restart|isolate|heal:NODE or T:loss:PERCENT,\n"
+		"                          T in seconds. May be repeated.\n"
+		"  %s --verbose      -v    Log the nodes to stderr.\n"
+		"  %s --help         -h    Display this short inlined help screen.\n",
+		prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog);
+}
+
+static int
+parse_event(char *str)
+{
+	char action[16];
+	double t;
+	int arg, i, n;
+
+	if (nr_events == MAX_EVENTS ||
+	    sscanf(str, "%lf:%15[a-z]:%d", &t, action, &arg) != 3 || t < 0)
+		return -1;
+
+	for (i = 0; i <= EV_LOSS; i++)
+		if (!strcmp(action, ev_name[i]))
+			break;
+	if (i > EV_LOSS)
+		return -1;
+	if (i == EV_LOSS ? (arg < 0 || arg > 100) : (arg < 0 || arg >= conf.nodes))
+		return -1;
+
+	/* Keep events sorted, in command line order for a same time */
+	for (n = nr_events++; n && events[n - 1].time > (long long) (t * SEC); n--)
+		events[n] = events[n - 1];
+	events[n].time = (long long) (t * SEC);
+	events[n].type = i;
+	events[n].arg = arg;
+	return 0;
+}
+
+static void
+parse_cmdline(int argc, char **argv)
+{
+	poptContext context;
+	char *option_arg = NULL;
+	char *ev[MAX_EVENTS];
+	int c, i, nr_ev = 0;
+
+	struct poptOption options_table[] = {
+		{"nodes", 'n', POPT_ARG_STRING, &option_arg, 'n'},
+		{"instances", 'i', POPT_ARG_STRING, &option_arg, 'i'},
+		{"time", 't', POPT_ARG_STRING, &option_arg, 't'},
+		{"advert", 'a', POPT_ARG_STRING, &option_arg, 'a'},
+		{"loss", 'l', POPT_ARG_STRING, &option_arg, 'l'},
+		{"delay", 'd', POPT_ARG_STRING, &option_arg, 'd'},
+		{"jitter", 'j', POPT_ARG_STRING, &option_arg, 'j'},
+		{"seed", 's', POPT_ARG_STRING, &option_arg, 's'},
+		{"event", 'e', POPT_ARG_STRING, &option_arg, 'e'},
+		{"verbose", 'v', POPT_ARG_NONE, NULL, 'v'},
+		{"help", 'h', POPT_ARG_NONE, NULL, 'h'},
+		{NULL, 0, 0, NULL, 0}
+	};
+
+	context =
+	    poptGetContext(PROG, argc, (const char **) argv, options_table, 0);
+	while ((c = poptGetNextOpt(context)) >= 0) {
+		switch (c) {
+		case 'n':
+			conf.nodes = atoi(option_arg);
+			break;
+		case 'i':
+			conf.instances = atoi(option_arg);
+			break;
+		case 't':
+			sim_time = atoi(option_arg);
+			break;
+		case 'a':
+			conf.advert_int = atoi(option_arg);
+			break;
+		case 'l':
+			loss = atoi(option_arg);
+			break;
+		case 'd':
+			delay = atoll(option_arg) * 1000;
+			break;
+		case 'j':
+			jitter = atoll(option_arg) * 1000;
+			break;
+		case 's':
+			seed = strtoull(option_arg, NULL, 0);
+			break;
+		case 'e':
+			if (nr_ev < MAX_EVENTS)
+				ev[nr_ev++] = option_arg;
+			break;
+		case 'v':
+			conf.verbose = 1;
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+		}
+	}
+
+	if (c < -1 || poptGetArg(context)) {
+		usage(argv[0]);
+		exit(2);
+	}
+
+	if (conf.nodes < 1 || conf.nodes > SIM_MAX_NODES ||
+	    conf.instances < 1 || conf.instances > SIM_MAX_INSTANCES ||
+	    conf.advert_int < 1 || conf.advert_int > 255 || sim_time < 1 ||
+	    loss < 0 || loss > 100 || delay < 0 || jitter < 0 || !seed) {
+		fprintf(stderr, "invalid option value\n");
+		exit(2);
+	}
+
+	/* Events need the node count */
+	for (i = 0; i < nr_ev; i++) {
+		if (parse_event(ev[i]) < 0) {
+			fprintf(stderr, "invalid event %s\n", ev[i]);
+			exit(2);
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	int i;
+
+	parse_cmdline(argc, argv);
+	rng_state = seed;
+	loss_start = loss;
+	signal(SIGPIPE, SIG_IGN);
+
+	held = calloc(conf.nodes * conf.instances, 1);
+	owners = calloc(conf.instances, sizeof (int));
+	dual_since = calloc(conf.instances, sizeof (long long));
+	if (!held || !owners || !dual_since) {
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+	nr_none = conf.instances;
+	for (i = 0; i < conf.nodes; i++)
+		nodes[i].deadline = SIM_NOWAIT;
+
+	simulate();
+	report();
+
+	exit(phase->converged ? 0 : 1);
+}
@@ -0,0 +1,436 @@
+/*
+ * Soft:        Deterministic VRRP simulator. Runs the keepalived VRRP
+ *              state machine of N routers against an in-memory LAN
+ *              and a virtual clock.
+ *
+ * Part:        Simulated router. The VRRP objects are linked unchanged;
+ *              socket(), sendmsg(), read(), close(), select() and
+ *              gettimeofday() are defined here so that their raw sockets
+ *              and their clock are served by the coordinator.
+ *
+ * Authors:     Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+/* global includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+/* local includes */
+#include "vrrp.h"
+#include "vrrp_data.h"
+#include "vrrp_index.h"
+#include "vrrp_scheduler.h"
+#include "scheduler.h"
+#include "signals.h"
+#include "parser.h"
+#include "sim.h"
+
+/* Received packets waiting on a simulated socket */
+typedef struct _sim_pkt {
+	struct _sim_pkt *next;
+	int len;
+	char data[0];
+} sim_pkt;
+
+typedef struct _sim_sock {
+	int used;
+	int proto;
+	int ifindex;
+	int joined;
+	sim_pkt *head;
+	sim_pkt *tail;
+} sim_sock;
+
+/* Node state, sim_active is 0 in the coordinator */
+static int sim_active;
+static int sim_id;
+static int sim_ctl = -1;
+static int sim_debug;
+static long long sim_now;
+static sim_sock sim_socks[FD_SETSIZE];
+static int sim_fd_max = -1;
+
+int
+sim_verbose(void)
+{
+	return sim_debug;
+}
+
+int
+sim_node_id(void)
+{
+	return sim_id;
+}
+
+static sim_sock *
+sim_sock_get(int fd)
+{
+	if (!sim_active || fd < 0 || fd >= FD_SETSIZE || !sim_socks[fd].used)
+		return NULL;
+	return &sim_socks[fd];
+}
+
+static void
+sim_sock_flush(sim_sock * s)
+{
+	sim_pkt *p;
+
+	while ((p = s->head)) {
+		s->head = p->next;
+		free(p);
+	}
+	s->tail = NULL;
+}
+
+void
+sim_sock_bind(int fd, int ifindex)
+{
+	sim_sock *s = sim_sock_get(fd);
+
+	if (s)
+		s->ifindex = ifindex;
+}
+
+void
+sim_sock_join(int fd)
+{
+	sim_sock *s = sim_sock_get(fd);
+
+	if (s)
+		s->joined = 1;
+}
+
+/* Control channel */
+void
+sim_send(sim_msg * msg, void *data)
+{
+	char buf[SIM_MSG_MAX];
+
+	if (!sim_active)
+		return;
+	if (msg->len > SIM_PKT_MAX)
+		msg->len = SIM_PKT_MAX;
+	memcpy(buf, msg, sizeof (sim_msg));
+	if (msg->len)
+		memcpy(buf + sizeof (sim_msg), data, msg->len);
+	if (send(sim_ctl, buf, sizeof (sim_msg) + msg->len, 0) < 0)
+		_exit(1);
+}
+
+static void
+sim_deliver(sim_msg * msg, char *data)
+{
+	sim_sock *s;
+	sim_pkt *p;
+	int fd;
+
+	for (fd = 0; fd <= sim_fd_max; fd++) {
+		s = &sim_socks[fd];
+		if (!s->used || !s->joined || s->ifindex != msg->ifindex ||
+		    s->proto != msg->proto)
+			continue;
+		p = (sim_pkt *) malloc(sizeof (sim_pkt) + msg->len);
+		p->next = NULL;
+		p->len = msg->len;
+		memcpy(p->data, data, msg->len);
+		if (s->tail)
+			s->tail->next = p;
+		else
+			s->head = p;
+		s->tail = p;
+	}
+}
+
+/* Sleep until the coordinator moves the clock, queueing deliveries */
+static void
+sim_wait(long long deadline)
+{
+	char buf[SIM_MSG_MAX];
+	sim_msg *msg = (sim_msg *) buf;
+	sim_msg req;
+	int len;
+
+	memset(&req, 0, sizeof (req));
+	req.type = SIM_WAIT;
+	req.time = deadline;
+	sim_send(&req, NULL);
+
+	for (;;) {
+		len = recv(sim_ctl, buf, sizeof (buf), 0);
+		if (len < (int) sizeof (sim_msg) || msg->type == SIM_STOP)
+			_exit(0);
+		if (msg->type == SIM_DELIVER)
+			sim_deliver(msg, buf + sizeof (sim_msg));
+		else if (msg->type == SIM_RUN) {
+			sim_now = msg->time;
+			return;
+		}
+	}
+}
+
+/* libc entry points used by the VRRP objects */
+int
+socket(int domain, int type, int protocol)
+{
+	sim_sock *s;
+	int fd;
+
+	if (!sim_active || domain != AF_INET || type != SOCK_RAW)
+		return syscall(SYS_socket, domain, type, protocol);
+
+	fd = open("/dev/null", O_RDWR);
+	if (fd < 0 || fd >= FD_SETSIZE) {
+		if (fd >= 0)
+			syscall(SYS_close, fd);
+		errno = EMFILE;
+		return -1;
+	}
+	s = &sim_socks[fd];
+	memset(s, 0, sizeof (sim_sock));
+	s->used = 1;
+	s->proto = protocol;
+	if (fd > sim_fd_max)
+		sim_fd_max = fd;
+	return fd;
+}
+
+ssize_t
+sendmsg(int fd, const struct msghdr *msg, int flags)
+{
+	sim_sock *s = sim_sock_get(fd);
+	char data[SIM_PKT_MAX];
+	sim_msg out;
+	size_t len = 0;
+	size_t i, n;
+
+	if (!s)
+		return syscall(SYS_sendmsg, fd, msg, flags);
+
+	for (i = 0; i < msg->msg_iovlen && len < SIM_PKT_MAX; i++) {
+		n = msg->msg_iov[i].iov_len;
+		if (n > SIM_PKT_MAX - len)
+			n = SIM_PKT_MAX - len;
+		memcpy(data + len, msg->msg_iov[i].iov_base, n);
+		len += n;
+	}
+
+	memset(&out, 0, sizeof (out));
+	out.type = SIM_PKT;
+	out.ifindex = s->ifindex;
+	out.proto = s->proto;
+	out.len = len;
+	out.time = sim_now;
+	sim_send(&out, data);
+	return len;
+}
+
+ssize_t
+read(int fd, void *buf, size_t count)
+{
+	sim_sock *s = sim_sock_get(fd);
+	sim_pkt *p;
+	size_t len;
+
+	if (!s)
+		return syscall(SYS_read, fd, buf, count);
+
+	if (!(p = s->head)) {
+		errno = EAGAIN;
+		return -1;
+	}
+	s->head = p->next;
+	if (!s->head)
+		s->tail = NULL;
+	len = (p->len < count) ? p->len : count;
+	memcpy(buf, p->data, len);
+	free(p);
+	return len;
+}
+
+int
+close(int fd)
+{
+	sim_sock *s = sim_sock_get(fd);
+
+	if (s) {
+		sim_sock_flush(s);
+		memset(s, 0, sizeof (sim_sock));
+	}
+	return syscall(SYS_close, fd);
+}
+
+/* Mark simulated sockets with queued packets, clear the others */
+static int
+sim_select_ready(int nfds, fd_set * readfds, fd_set * sim_readfds)
+{
+	int fd, ready = 0;
+
+	FD_ZERO(sim_readfds);
+	if (!readfds)
+		return 0;
+	for (fd = 0; fd < nfds && fd <= sim_fd_max; fd++) {
+		if (!sim_socks[fd].used || !FD_ISSET(fd, readfds))
+			continue;
+		FD_CLR(fd, readfds);
+		if (sim_socks[fd].head) {
+			FD_SET(fd, sim_readfds);
+			ready++;
+		}
+	}
+	return ready;
+}
+
+int
+select(int nfds, fd_set * readfds, fd_set * writefds, fd_set * exceptfds,
+       struct timeval *timeout)
+{
+	struct timespec zero = { 0, 0 };
+	fd_set rfds, wfds, efds, sim_rfds;
+	long long deadline = SIM_NOWAIT;
+	int fd, ret, ready;
+
+	if (!sim_active) {
+		struct timespec ts, *tsp = NULL;
+
+		if (timeout) {
+			ts.tv_sec = timeout->tv_sec;
+			ts.tv_nsec = timeout->tv_usec * 1000;
+			tsp = &ts;
+		}
+		return pselect(nfds, readfds, writefds, exceptfds, tsp, NULL);
+	}
+
+	if (timeout)
+		deadline = sim_now + timeout->tv_sec * TIMER_HZ + timeout->tv_usec;
+
+	for (;;) {
+		if (readfds)
+			rfds = *readfds;
+		if (writefds)
+			wfds = *writefds;
+		if (exceptfds)
+			efds = *exceptfds;
+
+		ready = sim_select_ready(nfds, readfds ? &rfds : NULL, &sim_rfds);
+
+		/* Real descriptors (signal pipe) are only ever polled */
+		ret = pselect(nfds, readfds ? &rfds : NULL, writefds ? &wfds : NULL,
+			      exceptfds ? &efds : NULL, &zero, NULL);
+		if (ret < 0)
+			return ret;
+
+		if (ready + ret || (deadline != SIM_NOWAIT && sim_now >= deadline))
+			break;
+		sim_wait(deadline);
+	}
+
+	for (fd = 0; fd < nfds && fd <= sim_fd_max; fd++) {
+		if (FD_ISSET(fd, &sim_rfds))
+			FD_SET(fd, &rfds);
+	}
+	if (readfds)
+		*readfds = rfds;
+	if (writefds)
+		*writefds = wfds;
+	if (exceptfds)
+		*exceptfds = efds;
+	return ready + ret;
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 31))
+int
+gettimeofday(struct timeval *tv, void *tz)
+#else
+int
+gettimeofday(struct timeval *tv, struct timezone *tz)
+#endif
+{
+	if (!sim_active)
+		return syscall(SYS_gettimeofday, tv, tz);
+
+	tv->tv_sec = sim_now / TIMER_HZ;
+	tv->tv_usec = sim_now % TIMER_HZ;
+	return 0;
+}
+
+/*
+ * Build the instances of this node. Instance i runs on segment i / 255
+ * with VRID i % 255 + 1 and one /32 VIP. Priorities are rotated so
+ * that node i % nodes is the preferred master of instance i.
+ */
+static void
+sim_node_config(sim_conf * conf, int id)
+{
+	char name[32], vip[32];
+	vector strvec;
+	vrrp_rt *vrrp;
+	uint32_t addr;
+	int i;
+
+	vrrp_data = alloc_vrrp_data();
+	alloc_vrrp_buffer();
+	sim_if_init(id, (conf->instances + 254) / 255);
+
+	for (i = 0; i < conf->instances; i++) {
+		snprintf(name, sizeof (name), "VI_%d", i);
+		alloc_vrrp(name);
+		vrrp = LIST_TAIL_DATA(vrrp_data->vrrp);
+		vrrp->ifp = if_get_by_ifindex(i / 255 + 1);
+		vrrp->vrid = i % 255 + 1;
+		alloc_vrrp_bucket(vrrp);
+		vrrp->base_priority = 254 - (id + conf->nodes - i % conf->nodes) %
+					    conf->nodes;
+		vrrp->effective_priority = vrrp->base_priority;
+		vrrp->adver_int = conf->advert_int * TIMER_HZ;
+
+		addr = SIM_VIP_BASE + i + 1;
+		snprintf(vip, sizeof (vip), "%u.%u.%u.%u/32", addr >> 24,
+			 (addr >> 16) & 0xff, (addr >> 8) & 0xff, addr & 0xff);
+		strvec = alloc_strvec(vip);
+		alloc_vrrp_vip(strvec);
+		free_strvec(strvec);
+	}
+}
+
+/* Child side of the fork, never returns */
+void
+sim_node_run(sim_conf * conf, int id, int ctl, long long now)
+{
+	sim_active = 1;
+	sim_id = id;
+	sim_ctl = ctl;
+	sim_debug = conf->verbose;
+	sim_now = now;
+
+	master = thread_make_master();
+	signal_handler_init();
+
+	sim_node_config(conf, id);
+	if (!vrrp_complete_init())
+		_exit(1);
+
+	thread_add_event(master, vrrp_dispatcher_init, NULL, VRRP_DISPATCHER);
+	launch_scheduler();
+	_exit(0);
+}
@@ -0,0 +1,94 @@
+/*
+ * Soft:        Deterministic VRRP simulator. Runs the keepalived VRRP
+ *              state machine of N routers against an in-memory LAN
+ *              and a virtual clock.
+ *
+ * Part:        Coordinator <-> node protocol.
+ *
+ * Authors:     Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+#ifndef _SIM_H
+#define _SIM_H
+
+/* global includes */
+#include <stdint.h>
+
+#define PROG    "vrrpsim"
+
+/*
+ * Each node runs the real VRRP objects in its own process. Sockets,
+ * netlink and the clock are provided by node.c and stubs.c, so the
+ * only channel out of a node is its control socket.
+ *
+ * A node runs until its scheduler would block in select(), then sends
+ * SIM_WAIT with its deadline and sleeps. The coordinator advances the
+ * virtual clock to the next deadline or packet arrival, sends the due
+ * packets as SIM_DELIVER and releases the node with SIM_RUN.
+ */
+enum {
+	SIM_WAIT,		/* node -> coord: blocked until time */
+	SIM_PKT,		/* node -> coord: packet sent on ifindex */
+	SIM_ADDR_ADD,		/* node -> coord: VIP added */
+	SIM_ADDR_DEL,		/* node -> coord: VIP removed */
+	SIM_DELIVER,		/* coord -> node: packet received on ifindex */
+	SIM_RUN,		/* coord -> node: clock is now time */
+	SIM_STOP		/* coord -> node: exit */
+};
+
+typedef struct _sim_msg {
+	int type;
+	int ifindex;
+	int proto;
+	int len;		/* payload length */
+	long long time;		/* virtual usec */
+	uint32_t addr;		/* network order */
+} sim_msg;
+
+#define SIM_PKT_MAX	1500
+#define SIM_MSG_MAX	(sizeof (sim_msg) + SIM_PKT_MAX)
+
+/* Virtual clock starts at a round epoch, far from 0 */
+#define SIM_EPOCH	(1000000000LL * 1000000LL)
+#define SIM_NOWAIT	(-1LL)
+
+/* Segments, 255 VRIDs each */
+#define SIM_MAX_IF	64
+#define SIM_MAX_INSTANCES (SIM_MAX_IF * 255)
+#define SIM_MAX_NODES	200
+
+/* VIP of instance i is SIM_VIP_BASE + i + 1 */
+#define SIM_VIP_BASE	0xac100000	/* 172.16.0.0 */
+
+/* Node configuration */
+typedef struct _sim_conf {
+	int nodes;
+	int instances;
+	int advert_int;		/* seconds */
+	int verbose;
+} sim_conf;
+
+/* node.c */
+extern void sim_node_run(sim_conf * conf, int id, int ctl, long long now);
+extern void sim_sock_bind(int fd, int ifindex);
+extern void sim_sock_join(int fd);
+extern void sim_send(sim_msg * msg, void *data);
+extern int sim_verbose(void);
+extern int sim_node_id(void);
+
+/* stubs.c */
+extern void sim_if_init(int node, int count);
+
+#endif
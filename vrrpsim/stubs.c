@@ -0,0 +1,281 @@
+/*
+ * Soft:        Deterministic VRRP simulator. Runs the keepalived VRRP
+ *              state machine of N routers against an in-memory LAN
+ *              and a virtual clock.
+ *
+ * Part:        Kernel facing keepalived functions, linked in place of
+ *              vrrp_if.o, vrrp_netlink.o, vrrp_arp.o and vrrp_notify.o.
+ *
+ * Authors:     Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2010 Alexandre Cassen, <acassen@freebox.fr>
+ */
+
+/* global includes */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <net/if.h>
+
+/* local includes */
+#include "vrrp.h"
+#include "vrrp_if.h"
+#include "vrrp_netlink.h"
+#include "vrrp_notify.h"
+#include "vrrp_arp.h"
+#include "ipvswrapper.h"
+#include "ipc.h"
+#include "smtp.h"
+#include "sim.h"
+
+/* Netlink globals referenced by the VRRP objects */
+struct nl_handle nl_cmd;
+nl_stats netlink_stats;
+
+/* Segments: simS has ifindex S+1 and address 10.S.0.(node+1) */
+static interface sim_if[SIM_MAX_IF];
+static int sim_if_count;
+
+void
+sim_if_init(int node, int count)
+{
+	interface *ifp;
+	int i;
+
+	memset(sim_if, 0, sizeof (sim_if));
+	for (i = 0; i < count; i++) {
+		ifp = &sim_if[i];
+		snprintf(ifp->ifname, sizeof (ifp->ifname), "sim%d", i);
+		ifp->ifindex = i + 1;
+		ifp->address = htonl(0x0a000000 | (i << 16) | (node + 1));
+		ifp->flags = IFF_UP | IFF_RUNNING;
+		ifp->mtu = 1500;
+		ifp->linkbeat = 1;
+		ifp->pinned = 1;
+	}
+	sim_if_count = count;
+}
+
+interface *
+if_get_by_ifindex(const int ifindex)
+{
+	if (ifindex < 1 || ifindex > sim_if_count)
+		return NULL;
+	return &sim_if[ifindex - 1];
+}
+
+interface *
+if_get_by_ifname(const char *ifname)
+{
+	int i;
+
+	if (sscanf(ifname, "sim%d", &i) != 1)
+		return NULL;
+	return if_get_by_ifindex(i + 1);
+}
+
+int
+if_linkbeat(const interface *ifp)
+{
+	return 1;
+}
+
+int
+if_join_vrrp_group(int sd, interface * ifp, int proto)
+{
+	if (sd < 0)
+		return -1;
+	sim_sock_join(sd);
+	return sd;
+}
+
+void
+if_leave_vrrp_group(int sd, interface * ifp)
+{
+	if (sd < 0)
+		return;
+	close(sd);
+}
+
+int
+if_setsockopt_bindtodevice(int sd, interface * ifp)
+{
+	if (sd < 0)
+		return -1;
+	sim_sock_bind(sd, IF_INDEX(ifp));
+	return sd;
+}
+
+int
+if_setsockopt_hdrincl(int sd)
+{
+	return sd;
+}
+
+int
+if_setsockopt_mcast_loop(int sd)
+{
+	return sd;
+}
+
+/* Netlink: VIP changes are reported to the coordinator */
+int
+addattr32(struct nlmsghdr *n, int maxlen, int type, uint32_t data_obj)
+{
+	return addattr_l(n, maxlen, type, &data_obj, 4);
+}
+
+int
+addattr_l(struct nlmsghdr *n, int maxlen, int type, void *data_obj, int alen)
+{
+	int len = RTA_LENGTH(alen);
+	struct rtattr *rta;
+
+	if (NLMSG_ALIGN(n->nlmsg_len) + len > maxlen)
+		return -1;
+
+	rta = (struct rtattr *) (((char *) n) + NLMSG_ALIGN(n->nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = len;
+	memcpy(RTA_DATA(rta), data_obj, alen);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + len;
+
+	return 0;
+}
+
+int
+rta_addattr_l(struct rtattr *rta, int maxlen, int type,
+	      const void *data, int alen)
+{
+	struct rtattr *subrta;
+	int len = RTA_LENGTH(alen);
+
+	if (RTA_ALIGN(rta->rta_len) + RTA_ALIGN(len) > maxlen)
+		return -1;
+
+	subrta = (struct rtattr *) (((char *) rta) + RTA_ALIGN(rta->rta_len));
+	subrta->rta_type = type;
+	subrta->rta_len = len;
+	memcpy(RTA_DATA(subrta), data, alen);
+	rta->rta_len = NLMSG_ALIGN(rta->rta_len) + RTA_ALIGN(len);
+
+	return 0;
+}
+
+char *
+netlink_scope_n2a(int scope)
+{
+	return (scope == 253) ? "link" : (scope == 254) ? "host" : "global";
+}
+
+int
+netlink_scope_a2n(char *scope)
+{
+	if (!strcmp(scope, "global"))
+		return 0;
+	if (!strcmp(scope, "host"))
+		return 254;
+	if (!strcmp(scope, "link"))
+		return 253;
+	return -1;
+}
+
+int
+netlink_talk(struct nl_handle *nl, struct nlmsghdr *n)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(n);
+	struct rtattr *rta;
+	sim_msg msg;
+	int len;
+
+	if (n->nlmsg_type != RTM_NEWADDR && n->nlmsg_type != RTM_DELADDR)
+		return 0;
+
+	memset(&msg, 0, sizeof (msg));
+	msg.type = (n->nlmsg_type == RTM_NEWADDR) ? SIM_ADDR_ADD : SIM_ADDR_DEL;
+	msg.ifindex = ifa->ifa_index;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof (struct ifaddrmsg));
+	for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFA_LOCAL) {
+			memcpy(&msg.addr, RTA_DATA(rta), sizeof (msg.addr));
+			sim_send(&msg, NULL);
+			break;
+		}
+	}
+	return 0;
+}
+
+int
+send_gratuitous_arp(ip_address * ipaddress)
+{
+	return 0;
+}
+
+/* Notifications, LVS sync daemon and IPC are not simulated */
+int
+notify_instance_exec(vrrp_rt * vrrp, int state)
+{
+	return 0;
+}
+
+int
+notify_group_exec(vrrp_sgroup * vgroup, int state)
+{
+	return 0;
+}
+
+int
+ipvs_syncd_cmd(int cmd, char *ifname, int state, int syncid)
+{
+	return 0;
+}
+
+void
+ipvs_syncd_master(char *ifname, int syncid)
+{
+}
+
+void
+ipvs_syncd_backup(char *ifname, int syncid)
+{
+}
+
+void
+ipc_send(ipc_msg *msg)
+{
+}
+
+void
+smtp_alert(real_server * rs, vrrp_rt * vrrp, vrrp_sgroup * vgroup,
+	   const char *subject, const char *body)
+{
+}
+
+/* Node logs go to stderr, prefixed with the node id, when verbose */
+void
+log_message(int priority, char *format, ...)
+{
+	va_list args;
+
+	if (!sim_verbose())
+		return;
+
+	va_start(args, format);
+	fprintf(stderr, "node%d: ", sim_node_id());
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}